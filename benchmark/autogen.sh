@@ -1,6 +1,6 @@
 cd ./IDLs
 ./MegrezC -c benchmark.mgz
 cd ../
-g++ bm_megrez.cc -o bm_megrez -I ./IDLs/ -I ../
+g++ -O2 -std=c++11 -pthread bm_megrez.cc -o bm_megrez -I ./ -I ../
 
-read -p " "
\ No newline at end of file
+read -p " "
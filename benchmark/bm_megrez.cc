@@ -14,75 +14,407 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ========================================================================*/
 
-#include "./IDLs/benchmark.mgz.h"
-#include <iostream>
-#include <chrono> 
+// Megrez benchmark suite, built as `MegrezBenchmark` by CMake (configure
+// with -DCMAKE_BUILD_TYPE=Release for meaningful numbers).
+// Usage: MegrezBenchmark [iterations] [threads]
+// Every case reports ns/op, serialized bytes/op and heap allocations/op.
+// Configured with -DMEGREZ_BUILDER_STATS=ON it also prints the builder
+// counters of a few workloads, per message.
+
+#include "IDLs/benchmark.mgz.h"
+#include "megrez/parallel.h"
+#include "megrez/pipeline.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace benchmark;
 using namespace std;
 using namespace megrez;
 using namespace chrono;
 
-void serialize() {
-	//MegrezBuilder mb;
-	//auto id = 123456;
-	//auto name = mb.CreateString("NAME");
-	//auto age = 100;
-	//auto gender = GENDER_TYPE_MALE;
-	//auto phone_num = 10000000000;
-
-	//auto temp = CreatePerson(mb, id, name, age, gender, phone_num);
-	//mb.Finish(temp);
-	//auto serialized = GetPerson(mb.GetBufferPointer());
-	megrez::MegrezBuilder mb(4096);
-	INFOBuilder builder(mb);
+// Every heap allocation of the process is counted, including the ones
+// std::vector does inside the builder.
+static atomic<uint64_t> g_allocations(0);
+
+void *operator new(size_t size) {
+	g_allocations.fetch_add(1, memory_order_relaxed);
+	if (void *p = malloc(size ? size : 1)) return p;
+	throw bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// Keeps the optimizer from dropping reads whose results are unused.
+static volatile uint64_t g_sink;
+
+struct Result {
+	double ns_per_op;
+	double bytes_per_op;
+	double allocs_per_op;
+};
+
+// `op()` returns the number of serialized bytes it produced (0 for reads).
+template<typename F>
+Result Run(int iterations, F op) {
+	uint64_t bytes = 0;
+	auto allocs_before = g_allocations.load();
+	auto start = steady_clock::now();
+	for (int i = 0; i < iterations; i++) bytes += op();
+	auto end = steady_clock::now();
+	auto allocs = g_allocations.load() - allocs_before;
+	Result r;
+	r.ns_per_op = duration_cast<duration<double, nano>>(end - start).count() / iterations;
+	r.bytes_per_op = static_cast<double>(bytes) / iterations;
+	r.allocs_per_op = static_cast<double>(allocs) / iterations;
+	return r;
+}
+
+static void Report(const char *name, const Result &r) {
+	printf("%-34s %12.1f %12.1f %12.2f\n",
+	       name, r.ns_per_op, r.bytes_per_op, r.allocs_per_op);
+}
+
+#ifdef MEGREZ_BUILDER_STATS
+static void ReportStats(const char *name, const BuilderStats &s, int messages) {
+	auto per = [messages](size_t n) { return static_cast<double>(n) / messages; };
+	auto vtables = s.vtables_written + s.vtables_deduplicated;
+	printf("%-34s %8.2f %10.1f %8.1f %8.2f %7.1f%% %8.1f %8zu\n",
+	       name, per(s.regrowths), per(s.bytes_copied), per(s.padding_bytes),
+	       per(vtables), vtables ? 100.0 * s.vtables_deduplicated / vtables : 0.0,
+	       per(s.strings_shared), s.peak_size);
+}
+
+// The counters of `messages` builds in one reused builder of
+// `initial_size`, so the first one pays for the growth.
+template<typename F>
+static void RunStats(const char *name, uofs_t initial_size, int messages, F build) {
+	MegrezBuilder mb(initial_size);
+	for (int i = 0; i < messages; i++) {
+		mb.Clear();
+		build(mb);
+	}
+	ReportStats(name, mb.GetStats(), messages);
+}
+#endif
+
+// ------------------------------- Schemas -------------------------------
 
-	uint8_t field1 = 1;
-	int8_t field2 = 1;
-	uint8_t field3 = 1;
-	int16_t field4 = 1;
-	uint16_t field5 = 1;
-	int32_t field6 = 1;
-	uint32_t field7 = 1;
-	int64_t field8 = 1;
-	uint64_t field9 = 1;
-	float field10 = 1.0;
-	double field11 = 1.0;
-
-	builder.add_field1(field1);
-
-	builder.add_field2(field2);
-	builder.add_field3(field3);
-	builder.add_field4(field4);
-	builder.add_field5(field5);
-	builder.add_field6(field6);
-	builder.add_field7(field7);
-	builder.add_field8(field8);
-	builder.add_field9(field9);
-	builder.add_field10(field10);
-	builder.add_field11(field11);
-	builder.add_field12("abcdefghijklmnopqrstuvwxyz");
+static Offset<INFO> BuildInfo(MegrezBuilder &mb) {
+	auto field12 = mb.CreateString("abcdefghijklmnopqrstuvwxyz");
+	INFOBuilder builder(mb);
+	builder.add_field1(1);
+	builder.add_field2(1);
+	builder.add_field3(1);
+	builder.add_field4(1);
+	builder.add_field5(1);
+	builder.add_field6(1);
+	builder.add_field7(1);
+	builder.add_field8(1);
+	builder.add_field9(1);
+	builder.add_field10(1.0f);
+	builder.add_field11(1.0);
+	builder.add_field12(field12);
 	builder.add_field13(ENUM_val2);
-	builder.Finish();
+	return builder.Finish();
+}
 
-	auto serialized = GetINFO(builder.mb_.GetBufferPointer());
+static uint64_t ReadInfo(const INFO *info) {
+	uint64_t acc = info->field1() + info->field2() + info->field3() +
+	               info->field4() + info->field5() + info->field6() +
+	               info->field7() + info->field8() + info->field9() +
+	               static_cast<uint64_t>(info->field10()) +
+	               static_cast<uint64_t>(info->field11()) +
+	               info->field12()->Length() + info->field13();
+	return acc;
 }
 
-int main() {
-	cout << "Megrez Benchmark" << endl;
-	auto start = system_clock::now();
-	for (int i=1; i<=10000; i++)
-		serialize();
+// Same reads through the generated view, the vtable is resolved once.
+static uint64_t ReadInfoView(const INFOView &info) {
+	uint64_t acc = info.field1() + info.field2() + info.field3() +
+	               info.field4() + info.field5() + info.field6() +
+	               info.field7() + info.field8() + info.field9() +
+	               static_cast<uint64_t>(info.field10()) +
+	               static_cast<uint64_t>(info.field11()) +
+	               info.field12()->Length() + info.field13();
+	return acc;
+}
+
+struct VectorPayload {
+	vector<uint64_t> ints;
+	vector<float> floats;
+	vector<VEC3> points;
+	explicit VectorPayload(size_t n) {
+		for (size_t i = 0; i < n; i++) {
+			ints.push_back(i);
+			floats.push_back(static_cast<float>(i));
+			points.push_back(VEC3(1.0f, 2.0f, static_cast<float>(i)));
+		}
+	}
+};
 
-	auto end = system_clock::now();
-	auto duration = duration_cast<nanoseconds>(end - start);
-	cout << "Serialization time: " 
-		 << double(duration.count()) * nanoseconds::period::num / nanoseconds::period::den 
-		 << "(nanoseconds).\n";
+static Offset<VECTORS> BuildVectors(MegrezBuilder &mb, const VectorPayload &p) {
+	auto ints = mb.CreateVector(p.ints);
+	auto floats = mb.CreateVector(p.floats);
+	auto points = mb.CreateVectorOfStructs(p.points);
+	return CreateVECTORS(mb, ints, floats, points);
+}
+
+// Element by element through `Get()`, see `ReadVectorsInPlace()`.
+static uint64_t ReadVectors(const VECTORS *v) {
+	uint64_t acc = 0;
+	auto ints = v->ints();
+	for (uofs_t i = 0; i < ints->Length(); i++) acc += ints->Get(i);
+	auto floats = v->floats();
+	for (uofs_t i = 0; i < floats->Length(); i++) acc += static_cast<uint64_t>(floats->Get(i));
+	auto points = v->points();
+	for (uofs_t i = 0; i < points->Length(); i++) acc += static_cast<uint64_t>(points->Get(i).z());
+	return acc;
+}
+
+static uint64_t ReadVectorsInPlace(const VECTORS *v) {
+	uint64_t acc = 0;
+	for (auto i : *v->ints()) acc += i;
+	auto floats = v->floats()->span();
+	float sum = 0;
+	for (size_t i = 0; i < floats.size(); i++) sum += floats[i];
+	acc += static_cast<uint64_t>(sum);
+	for (auto &p : v->points()->span()) acc += static_cast<uint64_t>(p.z());
+	return acc;
+}
+
+static Offset<STRINGS> BuildStrings(MegrezBuilder &mb, const vector<string> &names,
+                                    bool shared = false) {
+	vector<Offset<String>> offsets;
+	offsets.reserve(names.size());
+	for (auto it = names.begin(); it != names.end(); ++it)
+		offsets.push_back(shared ? mb.CreateSharedString(*it) : mb.CreateString(*it));
+	auto names_vec = mb.CreateVector(offsets);
+	return CreateSTRINGS(mb, "benchmark", names_vec);
+}
 
-	INFO info;
-	cout << info.field12()->c_str();
-	cin.get();
-	cin.get();
+// -------------------------------- Cases --------------------------------
+
+template<typename T>
+static vector<uint8_t> Snapshot(MegrezBuilder &mb, Offset<T> root) {
+	mb.Finish(root);
+	return vector<uint8_t>(mb.GetBufferPointer(), mb.GetBufferPointer() + mb.GetSize());
+}
+
+// Encodes with one builder per thread and reports the aggregate rate.
+static double ThreadedEncode(int iterations, int threads) {
+	vector<thread> workers;
+	auto start = steady_clock::now();
+	for (int t = 0; t < threads; t++) {
+		workers.push_back(thread([iterations]() {
+			MegrezBuilder mb(4096);
+			uint64_t acc = 0;
+			for (int i = 0; i < iterations; i++) {
+				mb.Clear();
+				mb.Finish(BuildInfo(mb));
+				acc += mb.GetSize();
+			}
+			g_sink = acc;
+		}));
+	}
+	for (auto it = workers.begin(); it != workers.end(); ++it) it->join();
+	auto seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+	return static_cast<double>(iterations) * threads / seconds;
+}
+
+// Builds on this thread and sends from a second one, the way a request
+// thread hands messages to an I/O thread. Only the producer is timed, the
+// bytes are what the consumer got.
+static Result PipelineEncode(int iterations) {
+	FramePipeline pipeline(64, 4096);
+	uint64_t bytes = 0;
+	thread consumer([&]() {
+		FrameBatch batch;
+		for (;;) {
+			auto closed = pipeline.closed();
+			if (!pipeline.NextBatch(&batch)) {
+				if (closed) break;
+				this_thread::yield();
+				continue;
+			}
+			bytes += batch.bytes();
+			batch.Complete();
+		}
+	});
+	auto r = Run(iterations, [&]() -> uint64_t {
+		auto mb = pipeline.Acquire();
+		pipeline.Submit(mb, BuildInfo(*mb));
+		return 0;
+	});
+	pipeline.Close();
+	consumer.join();
+	r.bytes_per_op = static_cast<double>(bytes) / iterations;
+	return r;
+}
+
+int main(int argc, char *argv[]) {
+	int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+	int threads = argc > 2 ? atoi(argv[2]) : static_cast<int>(thread::hardware_concurrency());
+	if (iterations <= 0) iterations = 1;
+	if (threads <= 0) threads = 1;
+
+	printf("Megrez Benchmark (%d iterations)\n\n", iterations);
+	printf("%-34s %12s %12s %12s\n", "case", "ns/op", "bytes/op", "allocs/op");
+
+	Report("encode INFO, fresh builder", Run(iterations, []() -> uint64_t {
+		MegrezBuilder mb(4096);
+		mb.Finish(BuildInfo(mb));
+		return mb.GetSize();
+	}));
+
+	MegrezBuilder reused(4096);
+	Report("encode INFO, reused builder", Run(iterations, [&]() -> uint64_t {
+		reused.Clear();
+		reused.Finish(BuildInfo(reused));
+		return reused.GetSize();
+	}));
+
+	reused.Clear();
+	auto info_buf = Snapshot(reused, BuildInfo(reused));
+	Report("decode INFO, all fields", Run(iterations, [&]() -> uint64_t {
+		g_sink = ReadInfo(GetRoot<INFO>(info_buf.data()));
+		return 0;
+	}));
+
+	// One view reset per object, the way a scan over a vector of infos
+	// sharing a vtable uses it.
+	INFOView view;
+	Report("decode INFO, all fields, view", Run(iterations, [&]() -> uint64_t {
+		view.Reset(GetRoot<INFO>(info_buf.data()));
+		g_sink = ReadInfoView(view);
+		return 0;
+	}));
+
+	Report("verify INFO", Run(iterations, [&]() -> uint64_t {
+		Verifier verifier(info_buf.data(), info_buf.size());
+		g_sink = verifier.VerifyBuffer<INFO>();
+		return 0;
+	}));
+
+	VectorPayload payload(1024);
+	int vector_iterations = iterations / 10 ? iterations / 10 : 1;
+	Report("encode VECTORS, 3x1024 elements", Run(vector_iterations, [&]() -> uint64_t {
+		reused.Clear();
+		reused.Finish(BuildVectors(reused, payload));
+		return reused.GetSize();
+	}));
+
+	Report("encode VECTORS, fresh builder", Run(vector_iterations, [&]() -> uint64_t {
+		MegrezBuilder mb;
+		mb.Finish(BuildVectors(mb, payload));
+		return mb.GetSize();
+	}));
+
+	Report("encode VECTORS, fresh reserved", Run(vector_iterations, [&]() -> uint64_t {
+		MegrezBuilder mb;
+		mb.Reserve(VectorSizeUpperBound<uint64_t>(payload.ints.size()) +
+		           VectorSizeUpperBound<float>(payload.floats.size()) +
+		           VectorSizeUpperBound<VEC3>(payload.points.size()) +
+		           CreateVECTORSSizeUpperBound({}, {}, {}) +
+		           RootSizeUpperBound());
+		mb.Finish(BuildVectors(mb, payload));
+		return mb.GetSize();
+	}));
+
+	Report("encode VECTORS, fresh segmented", Run(vector_iterations, [&]() -> uint64_t {
+		MegrezBuilder mb;
+		mb.SetSegmentSize(4096);
+		mb.Finish(BuildVectors(mb, payload));
+		return mb.GetSize();
+	}));
+
+	reused.Clear();
+	auto vectors_buf = Snapshot(reused, BuildVectors(reused, payload));
+	Report("decode VECTORS, Get()", Run(vector_iterations, [&]() -> uint64_t {
+		g_sink = ReadVectors(GetRoot<VECTORS>(vectors_buf.data()));
+		return 0;
+	}));
+	Report("decode VECTORS, in place", Run(vector_iterations, [&]() -> uint64_t {
+		g_sink = ReadVectorsInPlace(GetRoot<VECTORS>(vectors_buf.data()));
+		return 0;
+	}));
+
+	vector<string> names;
+	for (int i = 0; i < 256; i++) names.push_back("name_" + to_string(i));
+	Report("encode STRINGS, 256 strings", Run(vector_iterations, [&]() -> uint64_t {
+		reused.Clear();
+		reused.Finish(BuildStrings(reused, names));
+		return reused.GetSize();
+	}));
+
+	// Tag like values, 16 distinct ones repeated.
+	vector<string> tags;
+	for (int i = 0; i < 256; i++) tags.push_back("tag_value_" + to_string(i % 16));
+	Report("encode STRINGS, 256 of 16 values", Run(vector_iterations, [&]() -> uint64_t {
+		reused.Clear();
+		reused.Finish(BuildStrings(reused, tags));
+		return reused.GetSize();
+	}));
+	Report("encode STRINGS, 256 of 16, shared", Run(vector_iterations, [&]() -> uint64_t {
+		reused.Clear();
+		reused.Finish(BuildStrings(reused, tags, true));
+		return reused.GetSize();
+	}));
+
+	int parallel_iterations = iterations / 1000 ? iterations / 1000 : 1;
+	auto build_element = [](MegrezBuilder &mb, size_t) { return BuildInfo(mb); };
+	Report("encode [INFO] x4096, serial", Run(parallel_iterations, [&]() -> uint64_t {
+		reused.Clear();
+		reused.Finish(ParallelCreateVector<INFO>(reused, 4096, build_element, 1));
+		return reused.GetSize();
+	}));
+	Report("encode [INFO] x4096, parallel", Run(parallel_iterations, [&]() -> uint64_t {
+		reused.Clear();
+		reused.Finish(ParallelCreateVector<INFO>(reused, 4096, build_element, threads));
+		return reused.GetSize();
+	}));
+
+	Report("encode INFO, pipelined to a thread", PipelineEncode(iterations));
+
+	printf("\nencode INFO, %d threads: %.0f ops/s\n",
+	       threads, ThreadedEncode(iterations, threads));
+
+#ifdef MEGREZ_BUILDER_STATS
+	printf("\n%-34s %8s %10s %8s %8s %8s %8s %8s\n", "builder stats, per message",
+	       "regrows", "copied", "padding", "vtables", "dedup", "shared", "peak");
+	char name[64];
+	// Fresh builders of growing initial sizes, the smallest one that
+	// doesn't regrow is the one to pick.
+	for (uofs_t size = 256; size <= 65536; size *= 4) {
+		snprintf(name, sizeof(name), "VECTORS, initial size %u", size);
+		RunStats(name, size, 1, [&](MegrezBuilder &mb) {
+			mb.Finish(BuildVectors(mb, payload));
+		});
+	}
+	RunStats("INFO, reused builder", 1024, 1000, [](MegrezBuilder &mb) {
+		mb.Finish(BuildInfo(mb));
+	});
+	RunStats("STRINGS, reused builder", 1024, 100, [&](MegrezBuilder &mb) {
+		mb.Finish(BuildStrings(mb, names));
+	});
+	RunStats("STRINGS, 256 of 16, shared", 1024, 100, [&](MegrezBuilder &mb) {
+		mb.Finish(BuildStrings(mb, tags, true));
+	});
+	// Only the splicing builder, the workers' builders aren't counted.
+	RunStats("[INFO] x4096, serial", 1024, 1, [&](MegrezBuilder &mb) {
+		mb.Finish(ParallelCreateVector<INFO>(mb, 4096, build_element, 1));
+	});
+	RunStats("[INFO] x4096 in one builder", 1024, 1, [](MegrezBuilder &mb) {
+		mb.Finish(mb.CreateVector(4096, [&](size_t) { return BuildInfo(mb); }));
+	});
+#endif
 	return 0;
-}
\ No newline at end of file
+}
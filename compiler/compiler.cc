@@ -1,6 +1,10 @@
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include "megrez/reflection.h"
 #include "compiler/idl.h"
 
 const char *program_name = NULL;
@@ -13,11 +17,21 @@ struct Generator {
 	const char *ext_l;
 	const char *name;
 	const char *help;
+	const char *output;  // suffix of the file written, for -M
 };
 
 const Generator generators[] = {
-	{ megrez::GenerateCPP, "c", "cpp", "C++", "     Generate C++ header files;" }
+	{ megrez::GenerateCPP, "c", "cpp", "C++", "     Generate C++ header files;", ".mgz.h" },
+	{ megrez::GenerateBinarySchema, "s", "schema", "binary schema",
+	  "  Generate a binary schema (.mgzs) for megrez/reflection.h;", ".mgzs" },
+	{ megrez::GenerateBinaryFile, "b", "binary", "binary",
+	  "  Generate a binary buffer (.bin) from JSON data;", ".bin" },
+	{ megrez::GenerateTextFile, "t", "json", "text",
+	  "    Generate JSON (.json) from JSON data or from binary FILEs after --;", ".json" },
+	{ megrez::GenerateLayoutReport, "l", "layout", "layout report",
+	  "  Print the size, alignment and padding of each type;", nullptr }
 };
+const size_t num_generators = sizeof(generators) / sizeof(generators[0]);
 
 int get_max_len() {
 	int max_len, len;
@@ -37,9 +51,14 @@ void PrintHelp() {
 	}
 	std::cout << "\n"
 
-	   << "  -o [PATH]     Prefix PATH to all generated files\n\n"
+	   << "  -o [PATH]     Prefix PATH to all generated files\n"
+	   << "  -I [PATH]     Search for includes in PATH too\n"
+	   << "  -M            Write the dependencies of each FILE as a make rule (.d)\n"
+	   << "  -j [N]        Compile N FILEs at once, each has to include what it uses\n\n"
 
-	   << "FILEs may depend on declarations in earlier files.\n"
+	   << "FILEs may depend on declarations in earlier files or include them.\n"
+	   << "Generated files whose contents didn't change are left untouched.\n"
+	   << "FILEs after -- are buffers of the last main type, needs -t.\n"
 	   << "Output files are named using the base file name of the input,\n"
 	   << "and written to the current directory or the path given by -o.\n"
 	   << "example: MegrezC -c schema1.mgz\n";
@@ -61,17 +80,55 @@ std::string StripExtension(const std::string &filename) {
 	return i != std::string::npos ? filename.substr(0, i) : filename;
 }
 
+// Parses one FILE and runs the enabled generators on it, returns what went
+// wrong, if anything. Only touches `parser`, so files with a parser each
+// can be compiled in parallel.
+static std::string CompileFile(megrez::Parser &parser, const std::string &file,
+                               const bool *generator_enabled,
+                               const std::string &output_path, bool depfile) {
+	std::string contents;
+	if (!megrez::LoadFile(file.c_str(), true, &contents))
+		return "Unable to load file: " + file;
+	if (!parser.Parse(contents.c_str(), file.c_str()))
+		return parser.error_;
+
+	std::string filebase = StripExtension(file);
+	std::string targets;
+	for (size_t i = 0; i < num_generators; ++i) {
+		if (!generator_enabled[i]) continue;
+		if (!generators[i].generate(parser, output_path, filebase))
+			return std::string("Unable to generate ") + generators[i].name + " for " + filebase;
+		if (generators[i].output)
+			targets += (targets.empty() ? "" : " ") + output_path + filebase + generators[i].output;
+	}
+	if (depfile && !targets.empty()) {
+		std::string rule = targets + ": " + file;
+		for (auto it = parser.dependencies_.begin(); it != parser.dependencies_.end(); ++it)
+			rule += " " + *it;
+		auto name = output_path + filebase + ".d";
+		if (!megrez::SaveFileIfChanged(name.c_str(), rule + "\n", false))
+			return "Unable to write: " + name;
+	}
+	return "";
+}
+
 int main(int argc, const char *argv[]) {
 	program_name = argv[0];
 	megrez::Parser parser;
 	std::string output_path;
-	const size_t num_generators = sizeof(generators) / sizeof(generators[0]);
+	std::vector<std::string> include_paths;
+	bool depfile = false;
+	unsigned jobs = 1;
 	bool generator_enabled[num_generators] = { false };
 	bool any_generator = false;
 	std::vector<std::string> filenames;
+	std::vector<std::string> binary_files;
 	for (int i = 1; i < argc; i++) {
 		const char *arg = argv[i];
-		if (arg[0] == '-' && arg[1] != '-') {
+		if (!strcmp(arg, "--")) {
+			binary_files.assign(argv + i + 1, argv + argc);
+			break;
+		} else if (arg[0] == '-' && arg[1] != '-') {
 			if (filenames.size()) { Error("Invalid option location", arg, true); }
 			if (strlen(arg) != 2) { Error("Invalid commandline argument", arg, true); }
 			switch (arg[1]) {
@@ -79,6 +136,18 @@ int main(int argc, const char *argv[]) {
 					if (++i >= argc) { Error("Missing path following", arg, true); }
 					output_path = argv[i];
 					break;
+				case 'I':
+					if (++i >= argc) { Error("Missing path following", arg, true); }
+					include_paths.push_back(argv[i]);
+					break;
+				case 'M':
+					depfile = true;
+					break;
+				case 'j':
+					if (++i >= argc) { Error("Missing count following", arg, true); }
+					jobs = static_cast<unsigned>(atoi(argv[i]));
+					if (!jobs) jobs = std::max(1u, std::thread::hardware_concurrency());
+					break;
 				default:
 					for (size_t i = 0; i < num_generators; ++i) 
 						if(!strcmp(arg+1, generators[i].ext_s)) {
@@ -92,15 +161,12 @@ int main(int argc, const char *argv[]) {
 			}
 
 		} else if (arg[0] == '-' && arg[1] == '-') {
-			std::string arg_ = arg;
-			for (size_t i = 0; i < num_generators; ++i) 
-				if(arg_.substr(2, arg_.length()-2) == generators[i].ext_l) {
-					generator_enabled[i] = true;
-					any_generator = true;
-					
-				} else {
-					Error("Unknown commandline argument", arg, true);
-				}
+			if (filenames.size()) { Error("Invalid option location", arg, true); }
+			size_t i = 0;
+			while (i < num_generators && strcmp(arg + 2, generators[i].ext_l)) i++;
+			if (i == num_generators) { Error("Unknown commandline argument", arg, true); }
+			generator_enabled[i] = true;
+			any_generator = true;
 
 		} else { filenames.push_back(argv[i]); }
 	}
@@ -112,30 +178,74 @@ int main(int argc, const char *argv[]) {
 	}
 
 	// Now process the files:
-	for (auto file_it = filenames.begin();
-		 file_it != filenames.end();
+	parser.include_paths_ = include_paths;
+	megrez::Parser *last_parser = &parser;
+	std::vector<std::unique_ptr<megrez::Parser>> parsers;
+	if (jobs > 1) {
+		// A parser per file, the errors are reported in the order of the files.
+		parsers.resize(filenames.size());
+		std::vector<std::string> errors(filenames.size());
+		std::atomic<size_t> next(0);
+		auto work = [&]() {
+			for (size_t i; (i = next++) < filenames.size();) {
+				parsers[i].reset(new megrez::Parser());
+				parsers[i]->include_paths_ = include_paths;
+				errors[i] = CompileFile(*parsers[i], filenames[i], generator_enabled,
+				                        output_path, depfile);
+			}
+		};
+		std::vector<std::thread> workers;
+		for (unsigned t = 1; t < std::min<size_t>(jobs, filenames.size()); t++)
+			workers.emplace_back(work);
+		work();
+		for (auto it = workers.begin(); it != workers.end(); ++it) it->join();
+		for (auto it = errors.begin(); it != errors.end(); ++it)
+			if (!it->empty()) { Error(it->c_str()); }
+		last_parser = parsers.back().get();
+	} else {
+		for (auto file_it = filenames.begin();
+			 file_it != filenames.end();
+			 ++file_it) {
+				auto error = CompileFile(parser, *file_it, generator_enabled,
+				                         output_path, depfile);
+				if (!error.empty()) { Error(error.c_str()); }
+
+				for (auto it = parser.enums_.vec.begin(); it != parser.enums_.vec.end(); ++it)
+					{ (*it)->generated = true; }
+
+				for (auto it = parser.structs_.vec.begin(); it != parser.structs_.vec.end(); ++it)
+					{ (*it)->generated = true; }
+		}
+	}
+	auto &main_parser = *last_parser;
+
+	bool text_enabled = false;
+	for (size_t i = 0; i < num_generators; ++i)
+		if (generators[i].generate == megrez::GenerateTextFile)
+			text_enabled = generator_enabled[i];
+	for (auto file_it = binary_files.begin();
+		 file_it != binary_files.end();
 		 ++file_it) {
+			if (!text_enabled)
+				{ Error("Binary files can only be converted with -t", file_it->c_str()); }
+			if (!main_parser.main_struct_def)
+				{ Error("No main type set to read binary files with", file_it->c_str()); }
 			std::string contents;
 			if (!megrez::LoadFile(file_it->c_str(), true, &contents))
 				{ Error("Unable to load file", file_it->c_str()); }
-			if (!parser.Parse(contents.c_str()))
-				{ Error(parser.error_.c_str()); }
-
-			std::string filebase = StripExtension(*file_it);
-
-			for (size_t i = 0; i < num_generators; ++i) 
-				if (generator_enabled[i]) 
-					if (!generators[i].generate(parser, output_path, filebase)) {
-						Error((std::string("Unable to generate ") +
-							   generators[i].name + " for " +
-							   filebase).c_str());
-					}
-
-			for (auto it = parser.enums_.vec.begin(); it != parser.enums_.vec.end(); ++it)
-				{ (*it)->generated = true; }
-			
-			for (auto it = parser.structs_.vec.begin(); it != parser.structs_.vec.end(); ++it)
-				{ (*it)->generated = true; }
+			// Checked against the schema just parsed, through its binary form.
+			megrez::MegrezBuilder schema;
+			megrez::GenerateBinarySchema(main_parser, &schema);
+			megrez::SchemaTables tables(megrez::reflection::GetSchema(schema.GetBufferPointer()));
+			auto buf = reinterpret_cast<const uint8_t *>(contents.data());
+			megrez::Verifier verifier(buf, contents.size());
+			if (!megrez::VerifyAnyBuffer(verifier, tables, *tables.main(), buf))
+				{ Error("Not a valid buffer of the main type", file_it->c_str()); }
+			std::string text;
+			megrez::GenerateText(main_parser, buf, 2, &text);
+			auto name = output_path + StripExtension(*file_it) + ".json";
+			if (!megrez::SaveFileIfChanged(name.c_str(), text, false))
+				{ Error("Unable to write", name.c_str()); }
 	}
 
 	return 0;
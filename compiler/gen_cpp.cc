@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ========================================================================*/
 
+#include <cctype>
 #include "megrez/basic.h"
 #include "megrez/builder.h"
 #include "megrez/info.h"
@@ -42,6 +43,8 @@ static std::string GenTypePointer(const Type &type) {
 		case BASE_TYPE_STRING:
 			return "megrez::String";
 		case BASE_TYPE_VECTOR:
+			if (type.compact)
+				return "megrez::CompactVector<" + GenTypeBasic(type.VectorType()) + ">";
 			return "megrez::Vector<" + GenTypeWire(type.VectorType(), "") + ">";
 		case BASE_TYPE_STRUCT:
 			return type.struct_def->name;
@@ -65,6 +68,11 @@ static std::string GenTypeGet(
 		: beforeptr + GenTypePointer(type) + afterptr;
 }
 
+// The builder call that writes the strings of `field`.
+static std::string CreateString(const FieldDef &field) {
+	return field.shared ? "CreateSharedString" : "CreateString";
+}
+
 static void GenComment(
 	  const std::string &dc,
 	  std::string *code_ptr,
@@ -108,6 +116,558 @@ static void GenEnum(EnumDef &enum_def, std::string *code_ptr) {
 		code += "]; }\n\n";
 	}
 }
+// Generate the helpers of a union that only need its member types
+// declared: the type traits, a visitor dispatch and the declaration of
+// its verifier.
+static void GenUnion(const EnumDef &enum_def, std::string *code_ptr) {
+	std::string &code = *code_ptr;
+	auto &name = enum_def.name;
+	code += "template<typename T> struct " + name + "Traits {\n";
+	code += "\tstatic const uint8_t enum_value = " + name + "_NONE;\n};\n";
+	for (auto it = enum_def.vals.vec.begin() + 1;
+			 it != enum_def.vals.vec.end();
+			 ++it) {
+		auto &ev = **it;
+		code += "template<> struct " + name + "Traits<" + ev.struct_def->name;
+		code += "> {\n\tstatic const uint8_t enum_value = " + name + "_";
+		code += ev.name + ";\n};\n";
+	}
+	code += "\n";
+	code += "// Calls `visitor` with the object cast to its type, or without\n";
+	code += "// arguments for NONE and types this code doesn't know.\n";
+	code += "template<typename V>\n";
+	code += "auto Visit" + name + "(const void *obj, uint8_t type, V &&visitor)";
+	code += " -> decltype(visitor()) {\n";
+	code += "\tswitch (type) {\n";
+	for (auto it = enum_def.vals.vec.begin() + 1;
+			 it != enum_def.vals.vec.end();
+			 ++it) {
+		auto &ev = **it;
+		code += "\t\tcase " + name + "_" + ev.name + ": return visitor(";
+		code += "static_cast<const " + ev.struct_def->name + " *>(obj));\n";
+	}
+	code += "\t\tdefault: return visitor();\n\t}\n}\n\n";
+	code += "inline bool Verify" + name;
+	code += "(megrez::Verifier &verifier, const void *obj, uint8_t type);\n\n";
+}
+
+static void GenUnionVerify(const EnumDef &enum_def, std::string *code_ptr) {
+	std::string &code = *code_ptr;
+	auto &name = enum_def.name;
+	code += "inline bool Verify" + name;
+	code += "(megrez::Verifier &verifier, const void *obj, uint8_t type) {\n";
+	code += "\tswitch (type) {\n";
+	for (auto it = enum_def.vals.vec.begin() + 1;
+			 it != enum_def.vals.vec.end();
+			 ++it) {
+		auto &ev = **it;
+		code += "\t\tcase " + name + "_" + ev.name + ": return verifier.VerifyInfo(";
+		code += "static_cast<const " + ev.struct_def->name + " *>(obj));\n";
+	}
+	code += "\t\tdefault: return true;\n\t}\n}\n\n";
+}
+
+// Generate the `Verify()` member of an info, each field is checked to lie
+// inside the buffer and everything it points to is verified recursively.
+static void GenVerify(const StructDef &struct_def, std::string *code_ptr) {
+	std::string &code = *code_ptr;
+	code += "\tbool Verify(megrez::Verifier &verifier) const {\n";
+	code += "\t\treturn VerifyInfoStart(verifier) &&\n";
+	for (auto it = struct_def.fields.vec.begin();
+			 it != struct_def.fields.vec.end();
+			 ++it) {
+		auto &field = **it;
+		if (field.deprecated) continue;
+		auto &type = field.value.type;
+		auto offset = NumToString(field.value.offset);
+		code += "\t\t       ";
+		if (IsScalar(type.base_type)) {
+			code += "VerifyField<" + GenTypeBasic(type) + ">(verifier, " + offset + ")";
+		} else if (IsStruct(type)) {
+			code += "VerifyField<" + type.struct_def->name + ">(verifier, " + offset + ")";
+		} else {
+			code += "VerifyOffset(verifier, " + offset + ")";
+			auto call = "(" + field.name + "())";
+			switch (type.base_type) {
+				case BASE_TYPE_STRING:
+					code += " && verifier.VerifyString" + call;
+					break;
+				case BASE_TYPE_VECTOR:
+					code += " && verifier.VerifyVector" + call;
+					if (type.element == BASE_TYPE_STRING)
+						code += " && verifier.VerifyVectorOfStrings" + call;
+					else if (type.element == BASE_TYPE_STRUCT && !type.struct_def->fixed)
+						code += " && verifier.VerifyVectorOfInfos" + call;
+					if (field.nested)
+						code += " && verifier.VerifyNestedBuffer<" + field.nested->name + ">" + call;
+					break;
+				case BASE_TYPE_STRUCT:
+					code += " && verifier.VerifyInfo" + call;
+					break;
+				case BASE_TYPE_UNION:
+					code += " && Verify" + type.enum_def->name + "(verifier, ";
+					code += field.name + "(), " + field.name + "_type())";
+					break;
+				default:
+					break;
+			}
+		}
+		code += " &&\n";
+	}
+	code += "\t\t       verifier.EndInfo();\n\t}\n";
+}
+
+// Generate the in place setters of an info field: `mutate_` for scalars,
+// which fails on a field without storage, and `mutable_` for everything
+// reached through a pointer.
+static void GenMutator(const FieldDef &field, std::string *code_ptr) {
+	std::string &code = *code_ptr;
+	if (IsScalar(field.value.type.base_type)) {
+		code += "\tbool mutate_" + field.name + "(";
+		code += GenTypeBasic(field.value.type) + " " + field.name;
+		code += ") { return SetField<" + GenTypeBasic(field.value.type) + ">(";
+		code += NumToString(field.value.offset) + ", " + field.name + "); }\n";
+	} else if (field.value.type.base_type != BASE_TYPE_UNION) {
+		code += "\t" + GenTypePointer(field.value.type) + " *mutable_";
+		code += field.name + "() { return ";
+		code += IsStruct(field.value.type) ? "GetMutableStruct<" : "GetMutablePointer<";
+		code += GenTypePointer(field.value.type) + ">(";
+		code += NumToString(field.value.offset) + "); }\n";
+	}
+}
+
+// Generate the typed accessors of a union field, they return nullptr
+// unless the union holds that type.
+static void GenUnionAccessors(const FieldDef &field, std::string *code_ptr) {
+	std::string &code = *code_ptr;
+	auto &enum_def = *field.value.type.enum_def;
+	code += "\ttemplate<typename T> const T *" + field.name + "_as() const {\n";
+	code += "\t\treturn " + field.name + "_type() == " + enum_def.name;
+	code += "Traits<T>::enum_value ? static_cast<const T *>(" + field.name;
+	code += "()) : nullptr;\n\t}\n";
+	for (auto it = enum_def.vals.vec.begin() + 1;
+			 it != enum_def.vals.vec.end();
+			 ++it) {
+		auto &ev = **it;
+		code += "\tconst " + ev.struct_def->name + " *" + field.name + "_as_";
+		code += ev.name + "() const { return " + field.name + "_as<";
+		code += ev.struct_def->name + ">(); }\n";
+	}
+}
+
+// Generate the comparisons `CreateVectorOfSortedInfos` and `LookupByKey`
+// use for the `(key)` field of an info.
+static void GenKeyCompare(const StructDef &struct_def, std::string *code_ptr) {
+	std::string &code = *code_ptr;
+	for (auto it = struct_def.fields.vec.begin();
+			 it != struct_def.fields.vec.end();
+			 ++it) {
+		auto &field = **it;
+		if (!field.key) continue;
+		code += "\tbool KeyCompareLessThan(const " + struct_def.name;
+		code += " *o) const { return ";
+		if (IsString(field.value.type.base_type)) {
+			code += "megrez::CompareStrings(" + field.name + "(), o->";
+			code += field.name + "()) < 0; }\n";
+			code += "\tint KeyCompareWithValue(megrez::StringRef val) const { ";
+			code += "return megrez::CompareStrings(" + field.name + "(), val); }\n";
+		} else {
+			code += field.name + "() < o->" + field.name + "(); }\n";
+			code += "\tint KeyCompareWithValue(";
+			code += GenTypeBasic(field.value.type) + " val) const { ";
+			code += "return " + field.name + "() < val ? -1 : (";
+			code += field.name + "() > val ? 1 : 0); }\n";
+		}
+	}
+}
+
+// The `Field_` enumerator of a field: its vtable slot in an info, its
+// declaration index in a struct.
+static std::string FieldEnumValue(const StructDef &struct_def, const FieldDef &field) {
+	if (!struct_def.fixed)
+		return NumToString(field.value.offset / sizeof(vofs_t) - 2);
+	auto &fields = struct_def.fields.vec;
+	return NumToString(std::find(fields.begin(), fields.end(), &field) - fields.begin());
+}
+
+// Generate the compile time field list of a struct or info: a `Field_`
+// enum with `Get<Field_x>()` and a `VisitFields()` that hands every field
+// to a visitor, over `FieldTraits` specialized by `GenFieldTraits()` once
+// the type is complete. All of it inlines down to the plain accessors.
+static void GenFieldDecls(const StructDef &struct_def, std::string *code_ptr) {
+	std::string &code = *code_ptr;
+	std::string enumerators;
+	for (auto it = struct_def.fields.vec.begin();
+			 it != struct_def.fields.vec.end();
+			 ++it) {
+		auto &field = **it;
+		if (field.deprecated) continue;
+		enumerators += "\t\tField_" + field.name + " = ";
+		enumerators += FieldEnumValue(struct_def, field) + ",\n";
+	}
+	if (enumerators.length()) code += "\tenum {\n" + enumerators + "\t};\n";
+	code += "\ttemplate<int F> struct FieldTraits;\n";
+	code += "\ttemplate<int F> typename FieldTraits<F>::type Get() const ";
+	code += "{ return FieldTraits<F>::Get(this); }\n";
+	code += "\ttemplate<typename V> void VisitFields(V &&v) const;\n";
+}
+
+// Generate the `FieldTraits` specializations and `VisitFields()` of a
+// struct or info. A struct field also checks its offset against what the
+// C++ compiler laid out.
+static void GenFieldTraits(const StructDef &struct_def, std::string *code_ptr) {
+	std::string &code = *code_ptr;
+	auto &name = struct_def.name;
+	std::string visit;
+	for (auto it = struct_def.fields.vec.begin();
+			 it != struct_def.fields.vec.end();
+			 ++it) {
+		auto &field = **it;
+		auto &type = field.value.type;
+		if (field.deprecated) continue;
+		auto traits = name + "::FieldTraits<" + name + "::Field_" + field.name + ">";
+		code += "template<> struct " + traits + " {\n";
+		code += "\ttypedef " + (struct_def.fixed
+			? GenTypeGet(type, "", "const ", " &")
+			: GenTypeGet(type, "", "const ", " *")) + " type;\n";
+		code += "\tstatic constexpr const char *name() { return \"" + field.name + "\"; }\n";
+		if (struct_def.fixed) {
+			code += "\tstatic constexpr size_t offset() { return ";
+			code += NumToString(field.value.offset) + "; }\n";
+		} else {
+			code += "\tstatic constexpr megrez::vofs_t vtable_offset() { return ";
+			code += NumToString(field.value.offset) + "; }\n";
+			if (IsScalar(type.base_type)) {
+				code += "\tstatic constexpr type default_value() { return ";
+				code += field.value.constant + "; }\n";
+			}
+		}
+		code += "\tstatic type Get(const " + name + " *o) { return o->";
+		code += field.name + "(); }\n";
+		if (struct_def.fixed) {
+			code += "\tstatic_assert(offsetof(" + name + ", " + field.name + "_) == ";
+			code += NumToString(field.value.offset) + ", \"" + name + "." + field.name;
+			code += " is not where the schema puts it\");\n";
+		}
+		code += "};\n";
+		visit += "\tv(FieldTraits<Field_" + field.name + ">(), " + field.name + "());\n";
+	}
+	code += "template<typename V> inline void " + name + "::VisitFields(V &&";
+	code += visit.length() ? "v" : "";
+	code += ") const {\n" + visit + "}\n\n";
+}
+
+// Generate the cached vtable view of an info, its accessors take the
+// field index instead of the vtable offset.
+static void GenView(const StructDef &struct_def, std::string *code_ptr) {
+	std::string &code = *code_ptr;
+	auto base = "megrez::InfoView<" +
+		NumToString(struct_def.fields.vec.size()) + ">";
+	code += "struct " + struct_def.name + "View : public " + base + " {\n";
+	code += "\texplicit " + struct_def.name + "View(const " + struct_def.name;
+	code += " *info = nullptr) : " + base + "(info) {}\n";
+	for (auto it = struct_def.fields.vec.begin();
+			 it != struct_def.fields.vec.end();
+			 ++it) {
+		auto &field = **it;
+		if (field.deprecated) continue;
+		code += "\t" + GenTypeGet(field.value.type, " ", "const ", " *");
+		code += field.name + "() const { return ";
+		code += IsScalar(field.value.type.base_type)
+			? "GetField<"
+			: (IsStruct(field.value.type) ? "GetStruct<" : "GetPointer<");
+		code += GenTypeGet(field.value.type, "", "const ", " *") + ">(";
+		code += NumToString(field.value.offset / sizeof(vofs_t) - 2);
+		if (IsScalar(field.value.type.base_type))
+			code += ", " + field.value.constant;
+		code += "); }\n";
+	}
+	code += "};\n\n";
+}
+
+// The `InfoSizeUpperBound()` call for the info itself, its children
+// excluded.
+static std::string GenInfoSizeUpperBound(const StructDef &struct_def) {
+	size_t field_bytes = 0;
+	for (auto it = struct_def.fields.vec.begin();
+			 it != struct_def.fields.vec.end();
+			 ++it) {
+		auto &field = **it;
+		if (!field.deprecated)
+			field_bytes += InlineSize(field.value.type) +
+				InlineAlignment(field.value.type) - 1;
+	}
+	return "megrez::InfoSizeUpperBound(" +
+		NumToString(struct_def.fields.vec.size()) + ", " +
+		NumToString(field_bytes) + ")";
+}
+
+// Native (object API) type of a field, unions have none.
+static std::string GenTypeNative(const Type &type) {
+	switch (type.base_type) {
+		case BASE_TYPE_STRING:
+			return "megrez::NativeString";
+		case BASE_TYPE_VECTOR: {
+			auto element = type.VectorType();
+			return "megrez::NativeVector<" +
+				(IsStruct(element) ? element.struct_def->name : GenTypeNative(element)) +
+				">";
+		}
+		case BASE_TYPE_STRUCT:
+			return "megrez::NativePtr<" + type.struct_def->name +
+				(type.struct_def->fixed ? "" : "T") + ">";
+		case BASE_TYPE_UNION:
+			return "";
+		default:
+			return GenTypeBasic(type);
+	}
+}
+
+static bool IsInfo(const Type &type) {
+	return type.base_type == BASE_TYPE_STRUCT && !type.struct_def->fixed;
+}
+
+// Generate the declaration of the native type of an info, a mutable
+// mirror made of STL containers that can all live in one `NativeArena`.
+// Empty strings and vectors are packed as absent fields.
+static void GenNative(const StructDef &struct_def, std::string *code_ptr) {
+	if (struct_def.generated) return;
+	std::string &code = *code_ptr;
+	auto name = struct_def.name + "T";
+	code += "struct " + name + " {\n";
+	code += "\ttypedef " + struct_def.name + " InfoType;\n";
+	code += "\tmegrez::NativeArena *arena_;\n";
+	std::string init = "arena_(arena)";
+	for (auto it = struct_def.fields.vec.begin();
+			 it != struct_def.fields.vec.end();
+			 ++it) {
+		auto &field = **it;
+		if (field.deprecated) continue;
+		if (field.value.type.base_type == BASE_TYPE_UNION) {
+			// One slot per member type, `<field>_type` picks the one packed.
+			auto &enum_def = *field.value.type.enum_def;
+			for (auto ev = enum_def.vals.vec.begin() + 1;
+					 ev != enum_def.vals.vec.end();
+					 ++ev) {
+				code += "\tmegrez::NativePtr<" + (*ev)->struct_def->name + "T> ";
+				code += field.name + "_as_" + (*ev)->name + ";\n";
+			}
+			continue;
+		}
+		auto type = GenTypeNative(field.value.type);
+		code += "\t" + type + " " + field.name + ";\n";
+		if (IsScalar(field.value.type.base_type))
+			init += ", " + field.name + "(" + field.value.constant + ")";
+		else if (field.value.type.base_type != BASE_TYPE_STRUCT)
+			init += ", " + field.name + "(arena)";
+	}
+	code += "\texplicit " + name + "(megrez::NativeArena *arena = nullptr)\n";
+	code += "\t\t: " + init + " {}\n";
+	code += "\tsize_t SerializedSizeUpperBound() const;\n";
+	code += "};\n\n";
+}
+
+// Generate the out of line `UnPack()`, `UnPackTo()`, `Pack()` and
+// `SerializedSizeUpperBound()` of an info, once all native types exist.
+static void GenNativeBodies(const StructDef &struct_def, std::string *code_ptr) {
+	if (struct_def.generated) return;
+	std::string &code = *code_ptr;
+	auto &name = struct_def.name;
+	code += "inline megrez::NativePtr<" + name + "T> " + name;
+	code += "::UnPack(megrez::NativeArena *arena) const {\n";
+	code += "\tauto _o = megrez::MakeNative<" + name + "T>(arena, arena);\n";
+	code += "\tUnPackTo(_o.get());\n\treturn _o;\n}\n\n";
+
+	code += "inline void " + name + "::UnPackTo(" + name + "T *_o) const {\n";
+	for (auto it = struct_def.fields.vec.begin();
+			 it != struct_def.fields.vec.end();
+			 ++it) {
+		auto &field = **it;
+		auto &type = field.value.type;
+		auto &f = field.name;
+		if (field.deprecated) continue;
+		if (IsScalar(type.base_type)) {
+			code += "\t_o->" + f + " = " + f + "();\n";
+			continue;
+		}
+		if (type.base_type == BASE_TYPE_UNION) {
+			auto &enum_def = *type.enum_def;
+			for (auto ev = enum_def.vals.vec.begin() + 1;
+					 ev != enum_def.vals.vec.end();
+					 ++ev) {
+				auto member = f + "_as_" + (*ev)->name;
+				code += "\tif (auto _e = " + member + "()) _o->" + member;
+				code += " = _e->UnPack(_o->arena_);\n";
+				code += "\telse _o->" + member + ".reset();\n";
+			}
+			continue;
+		}
+		code += "\tif (auto _e = " + f + "()) {\n";
+		if (type.base_type == BASE_TYPE_STRING) {
+			code += "\t\t_o->" + f + ".assign(_e->c_str(), _e->Length());\n";
+		} else if (type.compact) {
+			code += "\t\t_o->" + f + ".resize(_e->Count());\n";
+			code += "\t\t_e->Decode(_o->" + f + ".data());\n";
+		} else if (type.base_type == BASE_TYPE_VECTOR) {
+			auto element = type.VectorType();
+			if (element.base_type == BASE_TYPE_STRING) {
+				code += "\t\t_o->" + f + ".clear();\n";
+				code += "\t\tfor (auto _s : *_e) _o->" + f + ".emplace_back(";
+				code += "_s->c_str(), _s->Length(), _o->arena_);\n";
+			} else if (IsInfo(element)) {
+				code += "\t\t_o->" + f + ".clear();\n";
+				code += "\t\tfor (auto _i : *_e) _o->" + f;
+				code += ".push_back(_i->UnPack(_o->arena_));\n";
+			} else {
+				code += "\t\t_o->" + f + ".assign(_e->begin(), _e->end());\n";
+			}
+		} else if (IsStruct(type)) {
+			code += "\t\t_o->" + f + " = megrez::MakeNative<";
+			code += type.struct_def->name + ">(_o->arena_, *_e);\n";
+		} else {
+			code += "\t\t_o->" + f + " = _e->UnPack(_o->arena_);\n";
+		}
+		code += "\t} else {\n";
+		code += "\t\t_o->" + f;
+		code += type.base_type == BASE_TYPE_STRUCT ? ".reset();\n" : ".clear();\n";
+		code += "\t}\n";
+	}
+	code += "}\n\n";
+
+	code += "inline megrez::Offset<" + name + "> " + name;
+	code += "::Pack(megrez::MegrezBuilder &_mb, const " + name + "T &_o) {\n";
+	for (auto it = struct_def.fields.vec.begin();
+			 it != struct_def.fields.vec.end();
+			 ++it) {
+		auto &field = **it;
+		auto &type = field.value.type;
+		auto &f = field.name;
+		if (field.deprecated || IsScalar(type.base_type) || IsStruct(type))
+			continue;
+		if (type.base_type == BASE_TYPE_UNION) {
+			auto &enum_def = *type.enum_def;
+			code += "\tauto _" + f + " = megrez::Offset<void>();\n";
+			code += "\tswitch (_o." + f + "_type) {\n";
+			for (auto ev = enum_def.vals.vec.begin() + 1;
+					 ev != enum_def.vals.vec.end();
+					 ++ev) {
+				auto member = "_o." + f + "_as_" + (*ev)->name;
+				code += "\t\tcase " + enum_def.name + "_" + (*ev)->name + ":\n";
+				code += "\t\t\tif (" + member + ") _" + f + " = ";
+				code += (*ev)->struct_def->name + "::Pack(_mb, *" + member;
+				code += ").Union();\n\t\t\tbreak;\n";
+			}
+			code += "\t\tdefault:\n\t\t\tbreak;\n\t}\n";
+			// No member to write, no type either.
+			code += "\tauto _" + f + "_type = _o." + f + "_type;\n";
+			code += "\tif (!_" + f + ".o) _" + f + "_type = " + enum_def.name + "_";
+			code += enum_def.vals.vec.front()->name + ";\n";
+			continue;
+		}
+		auto wire = GenTypeWire(type, "");
+		code += "\tauto _" + f + " = ";
+		if (type.base_type == BASE_TYPE_STRING) {
+			code += "_o." + f + ".empty() ? " + wire + "() : _mb." + CreateString(field) + "(";
+			code += "_o." + f + ".data(), _o." + f + ".size());\n";
+		} else if (type.compact) {
+			code += "_o." + f + ".empty() ? " + wire + "() : megrez::CreateCompactVector(";
+			code += "_mb, _o." + f + ".data(), _o." + f + ".size());\n";
+		} else if (type.base_type == BASE_TYPE_VECTOR) {
+			auto element = type.VectorType();
+			code += "_o." + f + ".empty() ? " + wire + "() : ";
+			if (element.base_type == BASE_TYPE_STRING) {
+				code += "_mb.CreateVector(_o." + f + ".size(), [&](size_t i) {\n";
+				code += "\t\treturn _mb." + CreateString(field) + "(_o." + f + "[i].data(), _o.";
+				code += f + "[i].size());\n\t});\n";
+			} else if (IsInfo(element)) {
+				// Null elements are left out. With a key, sorted for `LookupByKey()`.
+				auto &e = element.struct_def->name;
+				code += "[&]() {\n\t\tstd::vector<megrez::Offset<" + e + ">> _v;\n";
+				code += "\t\t_v.reserve(_o." + f + ".size());\n";
+				code += "\t\tfor (auto &_e : _o." + f + ") if (_e) _v.push_back(";
+				code += e + "::Pack(_mb, *_e));\n";
+				code += element.struct_def->has_key
+					? "\t\treturn _mb.CreateVectorOfSortedInfos(&_v);\n\t}();\n"
+					: "\t\treturn _mb.CreateVector(_v);\n\t}();\n";
+			} else if (IsStruct(element)) {
+				code += "_mb.CreateVectorOfStructs(_o." + f + ".data(), _o.";
+				code += f + ".size());\n";
+			} else if (field.nested) {
+				// Aligned, for reading its root in place.
+				code += "_mb.CreateNestedBuffer(_o." + f + ".data(), _o." + f + ".size());\n";
+			} else {
+				code += "_mb.CreateVector(_o." + f + ".data(), _o." + f + ".size());\n";
+			}
+		} else {
+			code += "_o." + f + " ? " + type.struct_def->name + "::Pack(_mb, *_o.";
+			code += f + ") : " + wire + "();\n";
+		}
+	}
+	code += "\treturn Create" + name + "(_mb";
+	for (auto it = struct_def.fields.vec.begin();
+			 it != struct_def.fields.vec.end();
+			 ++it) {
+		auto &field = **it;
+		auto &type = field.value.type;
+		if (field.deprecated) continue;
+		// The type of a union that is packed above.
+		if (type.base_type == BASE_TYPE_UTYPE && !(*(it + 1))->deprecated)
+			code += ", _" + field.name;
+		else if (IsScalar(type.base_type)) code += ", _o." + field.name;
+		else if (IsStruct(type)) code += ", _o." + field.name + ".get()";
+		else code += ", _" + field.name;
+	}
+	code += ");\n}\n\n";
+
+	code += "inline size_t " + name + "T::SerializedSizeUpperBound() const {\n";
+	code += "\tsize_t _size = " + GenInfoSizeUpperBound(struct_def) + ";\n";
+	for (auto it = struct_def.fields.vec.begin();
+			 it != struct_def.fields.vec.end();
+			 ++it) {
+		auto &field = **it;
+		auto &type = field.value.type;
+		auto &f = field.name;
+		if (field.deprecated || IsScalar(type.base_type) || IsStruct(type))
+			continue;
+		if (type.base_type == BASE_TYPE_UNION) {
+			auto &enum_def = *type.enum_def;
+			for (auto ev = enum_def.vals.vec.begin() + 1;
+					 ev != enum_def.vals.vec.end();
+					 ++ev) {
+				auto member = f + "_as_" + (*ev)->name;
+				code += "\tif (" + member + ") _size += " + member;
+				code += "->SerializedSizeUpperBound();\n";
+			}
+			continue;
+		}
+		if (type.base_type == BASE_TYPE_STRING) {
+			code += "\tif (!" + f + ".empty()) _size += ";
+			code += "megrez::StringSizeUpperBound(" + f + ".size());\n";
+		} else if (type.compact) {
+			code += "\tif (!" + f + ".empty()) _size += ";
+			code += "megrez::CompactVectorSizeUpperBound(" + f + ".size());\n";
+		} else if (type.base_type == BASE_TYPE_VECTOR) {
+			auto element = type.VectorType();
+			code += "\tif (!" + f + ".empty()) _size += megrez::VectorSizeUpperBound(";
+			code += f + ".size(), " + NumToString(InlineSize(element)) + ", ";
+			code += NumToString(InlineAlignment(element)) + ")";
+			// The padding that aligns a nested buffer.
+			code += field.nested ? " + sizeof(megrez::max_scalar_t) - 1;\n" : ";\n";
+			if (element.base_type == BASE_TYPE_STRING) {
+				code += "\tfor (auto &_e : " + f + ") _size += ";
+				code += "megrez::StringSizeUpperBound(_e.size());\n";
+			} else if (IsInfo(element)) {
+				code += "\tfor (auto &_e : " + f + ") if (_e) _size += ";
+				code += "_e->SerializedSizeUpperBound();\n";
+			}
+		} else {
+			code += "\tif (" + f + ") _size += " + f;
+			code += "->SerializedSizeUpperBound();\n";
+		}
+	}
+	code += "\treturn _size;\n}\n\n";
+}
+
 static void GenInfo(StructDef &struct_def, std::string *code_ptr) {
 	if (struct_def.generated) return;
 	std::string &code = *code_ptr;
@@ -132,9 +692,29 @@ static void GenInfo(StructDef &struct_def, std::string *code_ptr) {
 			if (IsScalar(field.value.type.base_type))
 				code += ", " + field.value.constant;
 			code += "); }\n";
+			GenMutator(field, code_ptr);
+			if (field.value.type.base_type == BASE_TYPE_UNION)
+				GenUnionAccessors(field, code_ptr);
+			if (field.nested) {
+				// Only decoded when asked for, forwarding the bytes costs nothing.
+				code += "\tconst " + field.nested->name + " *" + field.name;
+				code += "_nested_root() const {\n\t\tauto _v = " + field.name + "();\n";
+				code += "\t\treturn _v && _v->size() ? megrez::GetRoot<";
+				code += field.nested->name + ">(_v->data()) : nullptr;\n\t}\n";
+			}
 		}
 	}
+	if (struct_def.has_key) GenKeyCompare(struct_def, code_ptr);
+	code += "\tmegrez::NativePtr<" + struct_def.name + "T> UnPack(";
+	code += "megrez::NativeArena *arena = nullptr) const;\n";
+	code += "\tvoid UnPackTo(" + struct_def.name + "T *_o) const;\n";
+	code += "\tstatic megrez::Offset<" + struct_def.name + "> Pack(";
+	code += "megrez::MegrezBuilder &_mb, const " + struct_def.name + "T &_o);\n";
+	GenFieldDecls(struct_def, code_ptr);
+	GenVerify(struct_def, code_ptr);
 	code += "};\n\n";
+	GenFieldTraits(struct_def, code_ptr);
+	GenView(struct_def, code_ptr);
 	code += "struct " + struct_def.name;
 	code += "Builder {\n\tmegrez::MegrezBuilder &mb_;\n";
 	code += "\tmegrez::uofs_t start_;\n";
@@ -155,14 +735,17 @@ static void GenInfo(StructDef &struct_def, std::string *code_ptr) {
 			if (IsScalar(field.value.type.base_type))
 				code += ", " + field.value.constant;
 			code += "); }\n";
-			if (IsString(field.value.type.base_type)) {
-				code += "\tvoid add_" + field.name + "(std::string " + field.name + ") { \n\t";
-				code += "\tmegrez::MegrezBuilder b;\n\t";
-				code += "\tmegrez::Offset<megrez::String> " + field.name + "_";
-				code += " = b.CreateString(" + field.name + ");\n\t";
-				code += "\tmb_.AddOffset(" + NumToString(field.value.offset) + ", ";
-				code += field.name + "_);\n\t";
-				code += "}\n";
+			// Typed setters of a union also set its type field.
+			if (field.value.type.base_type == BASE_TYPE_UNION) {
+				auto &enum_def = *field.value.type.enum_def;
+				for (auto ev = enum_def.vals.vec.begin() + 1;
+						 ev != enum_def.vals.vec.end();
+						 ++ev) {
+					code += "\tvoid add_" + field.name + "(megrez::Offset<";
+					code += (*ev)->struct_def->name + "> " + field.name + ") { add_";
+					code += field.name + "_type(" + enum_def.name + "_" + (*ev)->name;
+					code += "); add_" + field.name + "(" + field.name + ".Union()); }\n";
+				}
 			}
 		}
 	}
@@ -185,9 +768,7 @@ static void GenInfo(StructDef &struct_def, std::string *code_ptr) {
 		auto &field = **it;
 		if (!field.deprecated) {
 			code += ",\n\t  " + GenTypeWire(field.value.type, " ") + field.name;
-		}
-		if (IsString(field.value.type.base_type)) {
-			has_string_type = true;
+			if (IsString(field.value.type.base_type)) has_string_type = true;
 		}
 	}
 	code += ") {\n\n\t" + struct_def.name + "Builder builder_(_mb);\n";
@@ -207,7 +788,24 @@ static void GenInfo(StructDef &struct_def, std::string *code_ptr) {
 	}
 	code += "\treturn builder_.Finish();\n}\n\n";
 
+	// Size upper bound of the info `Create<Info>()` writes with the same
+	// arguments, reserve it to build the info without regrowing.
+	code += "inline size_t Create" + struct_def.name + "SizeUpperBound(";
+	const char *separator = "\n\t  ";
+	for (auto it = struct_def.fields.vec.begin();
+			 it != struct_def.fields.vec.end();
+			 ++it) {
+		auto &field = **it;
+		if (!field.deprecated) {
+			code += separator + GenTypeWire(field.value.type, "");
+			separator = ",\n\t  ";
+		}
+	}
+	code += ") {\n\treturn " + GenInfoSizeUpperBound(struct_def) + ";\n}\n\n";
+
 
+	// Strings can't be written once the info is started, so this overload
+	// writes them into the same builder first and forwards the offsets.
 	if (has_string_type) {
 		code += "inline megrez::Offset<" + struct_def.name + "> Create";
 		code += struct_def.name;
@@ -220,25 +818,57 @@ static void GenInfo(StructDef &struct_def, std::string *code_ptr) {
 				code += ",\n\t  " + GenTypeWire(field.value.type, " ") + field.name;
 			}
 			if (!field.deprecated && IsString(field.value.type.base_type)) {
-				code += ",\n\t  std::string " + field.name; 
+				code += ",\n\t  megrez::StringRef " + field.name;
 			}
 		}
-		code += ") {\n\n\t" + struct_def.name + "Builder builder_(_mb);\n";
-		for (size_t size = struct_def.sortbysize ? sizeof(max_scalar_t) : 1;
-				 size;
-				 size /= 2) {
-			for (auto it = struct_def.fields.vec.rbegin();
-					 it != struct_def.fields.vec.rend();
-					 ++it) {
-				auto &field = **it;
-				if (!field.deprecated &&
-						(!struct_def.sortbysize ||
-						 size == SizeOf(field.value.type.base_type))) {
-					code += "\tbuilder_.add_" + field.name + "(" + field.name + ");\n";
-				}
+		code += ") {\n";
+		for (auto it = struct_def.fields.vec.begin();
+				 it != struct_def.fields.vec.end();
+				 ++it) {
+			auto &field = **it;
+			if (!field.deprecated && IsString(field.value.type.base_type)) {
+				code += "\tauto " + field.name + "__ = _mb." + CreateString(field) + "(";
+				code += field.name + ");\n";
+			}
+		}
+		code += "\treturn Create" + struct_def.name + "(_mb";
+		for (auto it = struct_def.fields.vec.begin();
+				 it != struct_def.fields.vec.end();
+				 ++it) {
+			auto &field = **it;
+			if (!field.deprecated) {
+				code += ", " + field.name;
+				if (IsString(field.value.type.base_type)) code += "__";
+			}
+		}
+		code += ");\n}\n\n";
+
+		// This one also counts the strings it writes.
+		code += "inline size_t Create" + struct_def.name + "SizeUpperBound(";
+		separator = "\n\t  ";
+		for (auto it = struct_def.fields.vec.begin();
+				 it != struct_def.fields.vec.end();
+				 ++it) {
+			auto &field = **it;
+			if (field.deprecated) continue;
+			code += separator;
+			separator = ",\n\t  ";
+			if (IsString(field.value.type.base_type))
+				code += "megrez::StringRef " + field.name;
+			else
+				code += GenTypeWire(field.value.type, "");
+		}
+		code += ") {\n\treturn " + GenInfoSizeUpperBound(struct_def);
+		for (auto it = struct_def.fields.vec.begin();
+				 it != struct_def.fields.vec.end();
+				 ++it) {
+			auto &field = **it;
+			if (!field.deprecated && IsString(field.value.type.base_type)) {
+				code += " +\n\t\t(" + field.name + ".data() ? ";
+				code += "megrez::StringSizeUpperBound(" + field.name + ".size()) : 0)";
 			}
 		}
-		code += "\treturn builder_.Finish();\n}\n\n";
+		code += ";\n}\n\n";
 	}
 
 
@@ -251,10 +881,11 @@ static void GenStruct(StructDef &struct_def, std::string *code_ptr) {
 	GenComment(struct_def.doc_comment, code_ptr);
 	code += "MANUALLY_ALIGNED_STRUCT(" + NumToString(struct_def.minalign) + ") ";
 	code += struct_def.name + " {\n private:\n";
+	// Members are declared in memory order, the constructor takes the
+	// fields in declaration order.
+	auto layout = struct_def.FieldsByOffset();
 	int padding_id = 0;
-	for (auto it = struct_def.fields.vec.begin();
-			 it != struct_def.fields.vec.end();
-			 ++it) {
+	for (auto it = layout.begin(); it != layout.end(); ++it) {
 		auto &field = **it;
 		code += "\t" + GenTypeGet(field.value.type, " ", "", " ");
 		code += field.name + "_;\n";
@@ -266,7 +897,9 @@ static void GenStruct(StructDef &struct_def, std::string *code_ptr) {
 			assert(!(field.padding & ~0xF));
 		}
 	}
-	code += "\n public:\n\t" + struct_def.name + "(";
+	code += "\n public:\n\t" + struct_def.name + "() { memset(this, 0, sizeof(";
+	code += struct_def.name + ")); }\n";
+	code += "\t" + struct_def.name + "(";
 	for (auto it = struct_def.fields.vec.begin();
 			 it != struct_def.fields.vec.end();
 			 ++it) {
@@ -276,11 +909,9 @@ static void GenStruct(StructDef &struct_def, std::string *code_ptr) {
 	}
 	code += ")\n\t\t: ";
 	padding_id = 0;
-	for (auto it = struct_def.fields.vec.begin();
-			 it != struct_def.fields.vec.end();
-			 ++it) {
+	for (auto it = layout.begin(); it != layout.end(); ++it) {
 		auto &field = **it;
-		if (it != struct_def.fields.vec.begin()) code += ", ";
+		if (it != layout.begin()) code += ", ";
 		code += field.name + "_(";
 		if (IsScalar(field.value.type.base_type))
 			code += "megrez::EndianScalar(" + field.name + "))";
@@ -302,14 +933,24 @@ static void GenStruct(StructDef &struct_def, std::string *code_ptr) {
 		else
 			code += field.name + "_";
 		code += "; }\n";
+		if (IsScalar(field.value.type.base_type)) {
+			code += "\tvoid mutate_" + field.name + "(" + GenTypeBasic(field.value.type);
+			code += " " + field.name + ") { megrez::WriteScalar(&" + field.name;
+			code += "_, " + field.name + "); }\n";
+		} else {
+			code += "\t" + GenTypePointer(field.value.type) + " &mutable_";
+			code += field.name + "() { return " + field.name + "_; }\n";
+		}
 	}
+	GenFieldDecls(struct_def, code_ptr);
 	code += "};\nSTRUCT_END(" + struct_def.name + ", ";
 	code += NumToString(struct_def.bytesize) + ");\n\n";
+	GenFieldTraits(struct_def, code_ptr);
 }
 
 }  // namespace cpp
 
-std::string GenerateCPP(const Parser &parser) {
+std::string GenerateCPP(const Parser &parser, const std::string &file_name) {
 	using namespace cpp;
 	std::string enum_code;
 	for (auto it = parser.enums_.vec.begin();
@@ -319,8 +960,15 @@ std::string GenerateCPP(const Parser &parser) {
 	std::string forward_decl_code;
 	for (auto it = parser.structs_.vec.begin();
 			 it != parser.structs_.vec.end(); ++it) {
-		if (!(*it)->generated)
+		if (!(*it)->generated) {
 			forward_decl_code += "struct " + (*it)->name + ";\n";
+			if (!(*it)->fixed)
+				forward_decl_code += "struct " + (*it)->name + "T;\n";
+		}
+	}
+	for (auto it = parser.enums_.vec.begin();
+			 it != parser.enums_.vec.end(); ++it) {
+		if ((**it).is_union && !(**it).generated) GenUnion(**it, &forward_decl_code);
 	}
 	std::string decl_code;
 	for (auto it = parser.structs_.vec.begin();
@@ -331,15 +979,48 @@ std::string GenerateCPP(const Parser &parser) {
 			 it != parser.structs_.vec.end(); ++it) {
 		if (!(**it).fixed) GenInfo(**it, &decl_code);
 	}
+	for (auto it = parser.enums_.vec.begin();
+			 it != parser.enums_.vec.end(); ++it) {
+		if ((**it).is_union && !(**it).generated) GenUnionVerify(**it, &decl_code);
+	}
+	for (auto it = parser.structs_.vec.begin();
+			 it != parser.structs_.vec.end(); ++it) {
+		if (!(**it).fixed) GenNative(**it, &decl_code);
+	}
+	for (auto it = parser.structs_.vec.begin();
+			 it != parser.structs_.vec.end(); ++it) {
+		if (!(**it).fixed) GenNativeBodies(**it, &decl_code);
+	}
 	if (enum_code.length() || forward_decl_code.length() || decl_code.length()) {
+		// Named after the file and namespace, headers of included schemas
+		// can be reached through more than one path.
+		auto guard = "MEGREZ_GENERATED_" + file_name.substr(file_name.find_last_of("/\\") + 1);
+		for (auto it = parser.name_space_.begin(); it != parser.name_space_.end(); ++it)
+			guard += "_" + *it;
+		guard += "_H_";
+		for (auto it = guard.begin(); it != guard.end(); ++it)
+			*it = isalnum(static_cast<unsigned char>(*it))
+				? static_cast<char>(toupper(static_cast<unsigned char>(*it))) : '_';
 		std::string code;
 		code = "// Automatically generated by MegrezCompiler, DO NOT MODIFY!\n\n";
+		code += "#ifndef " + guard + "\n#define " + guard + "\n\n";
 		code += "#include <megrez/basic.h>\n";
 		code += "#include <megrez/builder.h>\n";
+		code += "#include <megrez/compact.h>\n";
 		code += "#include <megrez/info.h>\n";
+		code += "#include <megrez/native.h>\n";
 		code += "#include <megrez/string.h>\n";
 		code += "#include <megrez/struct.h>\n";
-		code += "#include <megrez/vector.h>\n\n";
+		code += "#include <megrez/vector.h>\n";
+		code += "#include <megrez/verifier.h>\n\n";
+		// The headers generated for included schemas, named after them.
+		for (auto it = parser.includes_.begin(); it != parser.includes_.end(); ++it) {
+			auto dot = it->find_last_of('.');
+			auto base = dot != std::string::npos && dot > it->find_last_of("/\\") + 1
+				? it->substr(0, dot) : *it;
+			code += "#include \"" + base + ".mgz.h\"\n";
+		}
+		if (parser.includes_.size()) code += "\n";
 
 		for (auto it = parser.name_space_.begin();
 				 it != parser.name_space_.end(); ++it) {
@@ -350,16 +1031,37 @@ std::string GenerateCPP(const Parser &parser) {
 		code += forward_decl_code;
 		code += "\n";
 		code += decl_code;
-		if (parser.main_struct_def) {
+		if (parser.main_struct_def && !parser.main_struct_def->generated) {
 			code += "inline const " + parser.main_struct_def->name + " *Get";
 			code += parser.main_struct_def->name;
 			code += "(const void *buf) { return megrez::GetRoot<";
 			code += parser.main_struct_def->name + ">(buf); }\n\n";
+			code += "inline " + parser.main_struct_def->name + " *GetMutable";
+			code += parser.main_struct_def->name;
+			code += "(void *buf) { return megrez::GetMutableRoot<";
+			code += parser.main_struct_def->name + ">(buf); }\n\n";
+			code += "inline megrez::NativePtr<" + parser.main_struct_def->name;
+			code += "T> UnPack" + parser.main_struct_def->name;
+			code += "(const void *buf, megrez::NativeArena *arena = nullptr) {\n";
+			code += "\treturn Get" + parser.main_struct_def->name;
+			code += "(buf)->UnPack(arena);\n}\n\n";
+			code += "inline const " + parser.main_struct_def->name + " *GetSizePrefixed";
+			code += parser.main_struct_def->name;
+			code += "(const void *buf) { return megrez::GetSizePrefixedRoot<";
+			code += parser.main_struct_def->name + ">(buf); }\n\n";
+			code += "inline bool Verify" + parser.main_struct_def->name;
+			code += "Buffer(megrez::Verifier &verifier) { return verifier.VerifyBuffer<";
+			code += parser.main_struct_def->name + ">(); }\n\n";
+			code += "inline bool VerifySizePrefixed" + parser.main_struct_def->name;
+			code += "Buffer(megrez::Verifier &verifier) { ";
+			code += "return verifier.VerifySizePrefixedBuffer<";
+			code += parser.main_struct_def->name + ">(); }\n\n";
 		}
 		for (auto it = parser.name_space_.begin();
 				 it != parser.name_space_.end(); ++it) {
 			code += "}; // namespace " + *it + "\n";
 		}
+		code += "\n#endif  // " + guard + "\n";
 
 		return code;
 	}
@@ -368,9 +1070,9 @@ std::string GenerateCPP(const Parser &parser) {
 }
 
 bool GenerateCPP(const Parser &parser, const std::string &path, const std::string &file_name) {
-	auto code = GenerateCPP(parser);
+	auto code = GenerateCPP(parser, file_name);
 	return !code.length() ||
-			SaveFile((path + file_name + ".mgz.h").c_str(), code, false);
+			SaveFileIfChanged((path + file_name + ".mgz.h").c_str(), code, false);
 }
 
 }  // namespace megrez
\ No newline at end of file
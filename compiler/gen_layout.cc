@@ -0,0 +1,97 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "megrez/util.h"
+#include "compiler/idl.h"
+
+// Prints the memory layout of each type to stdout: offset, size and the
+// padding after every struct field, and how much a (reorder) would save.
+
+namespace megrez {
+namespace layout {
+
+static void Appendf(std::string *out, const char *fmt, ...) {
+	char line[256];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(line, sizeof(line), fmt, args);
+	va_end(args);
+	*out += line;
+}
+
+// The size of a struct laid out in `PackedFieldOrder()`.
+static size_t PackedSize(const StructDef &struct_def) {
+	size_t size = 0;
+	auto order = PackedFieldOrder(struct_def);
+	for (auto it = order.begin(); it != order.end(); ++it) {
+		size += PaddingBytes(size, InlineAlignment((*it)->value.type));
+		size += InlineSize((*it)->value.type);
+	}
+	return size + PaddingBytes(size, struct_def.minalign);
+}
+
+static void ReportStruct(const StructDef &struct_def, std::string *out) {
+	size_t padding = 0;
+	for (auto it = struct_def.fields.vec.begin(); it != struct_def.fields.vec.end(); ++it)
+		padding += (*it)->padding;
+	Appendf(out, "struct %s: size %zu, align %zu, padding %zu (%.0f%%)\n",
+	             struct_def.name.c_str(), struct_def.bytesize, struct_def.minalign,
+	             padding, struct_def.bytesize ? 100.0 * padding / struct_def.bytesize : 0.0);
+	Appendf(out, "  %6s %6s %6s  %s\n", "offset", "size", "pad", "field");
+	auto layout = struct_def.FieldsByOffset();
+	for (auto it = layout.begin(); it != layout.end(); ++it) {
+		auto &field = **it;
+		Appendf(out, "  %6d %6zu %6zu  %s\n", field.value.offset,
+		             InlineSize(field.value.type), field.padding, field.name.c_str());
+	}
+	auto packed = PackedSize(struct_def);
+	if (packed < struct_def.bytesize)
+		Appendf(out, "  (reorder) would make it %zu bytes, saving %zu per element\n",
+		             packed, struct_def.bytesize - packed);
+}
+
+// Info fields are stored by size, so only the worst case is reported.
+static void ReportInfo(const StructDef &struct_def, std::string *out) {
+	size_t inline_size = 0;
+	for (auto it = struct_def.fields.vec.begin(); it != struct_def.fields.vec.end(); ++it)
+		if (!(*it)->deprecated) inline_size += InlineSize((*it)->value.type);
+	Appendf(out, "info %s: %zu fields, vtable %zu bytes, up to %zu bytes inline\n",
+	             struct_def.name.c_str(), struct_def.fields.vec.size(),
+	             static_cast<size_t>(FieldIndexToOffset(
+	               static_cast<vofs_t>(struct_def.fields.vec.size()))),
+	             sizeof(sofs_t) + inline_size);
+}
+
+}  // namespace layout
+
+bool GenerateLayoutReport(const Parser &parser, const std::string &, const std::string &) {
+	using namespace layout;
+	std::string report;
+	for (auto it = parser.structs_.vec.begin(); it != parser.structs_.vec.end(); ++it) {
+		auto &struct_def = **it;
+		if (struct_def.generated) continue;
+		if (struct_def.fixed) ReportStruct(struct_def, &report);
+		else ReportInfo(struct_def, &report);
+	}
+	// In one piece, files compiled in parallel don't interleave.
+	fputs(report.c_str(), stdout);
+	return true;
+}
+
+}  // namespace megrez
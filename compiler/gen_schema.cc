@@ -0,0 +1,171 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#include <algorithm>
+#include <map>
+#include "megrez/basic.h"
+#include "megrez/builder.h"
+#include "megrez/util.h"
+#include "megrez/reflection.mgz.h"
+#include "compiler/idl.h"
+
+// Serializes the parsed schema as a `megrez::reflection::Schema`, so tools
+// can read buffers of any schema at runtime, see megrez/reflection.h.
+
+namespace megrez {
+namespace schema {
+
+static_assert(static_cast<int>(BASE_TYPE_UNION) == reflection::BaseType_Union,
+              "reflection.mgz must mirror BaseType");
+
+// Objects and enums are stored sorted by name, so they can be looked up
+// by key, a type refers to them by their index in that order.
+template<typename T>
+static std::map<const T *, int> SortedIndices(const SymbolInfo<T> &symbols,
+                                              std::vector<const T *> *sorted) {
+	sorted->assign(symbols.vec.begin(), symbols.vec.end());
+	std::stable_sort(sorted->begin(), sorted->end(),
+		[](const T *a, const T *b) { return a->name < b->name; });
+	std::map<const T *, int> indices;
+	for (size_t i = 0; i < sorted->size(); i++)
+		indices[(*sorted)[i]] = static_cast<int>(i);
+	return indices;
+}
+
+struct Context {
+	MegrezBuilder &mb;
+	std::map<const StructDef *, int> objects;
+	std::map<const EnumDef *, int> enums;
+};
+
+static Offset<reflection::Type> SerializeType(Context &ctx, const Type &type) {
+	int index = -1;
+	if (type.struct_def) index = ctx.objects[type.struct_def];
+	else if (type.enum_def) index = ctx.enums[type.enum_def];
+	return reflection::CreateType(ctx.mb,
+		static_cast<uint8_t>(type.base_type),
+		static_cast<uint8_t>(type.element),
+		index,
+		type.compact);
+}
+
+// The map is ordered by name already.
+static Offset<Vector<Offset<reflection::KeyValue>>> SerializeAttributes(
+	  Context &ctx, const SymbolInfo<Value> &attributes) {
+	if (attributes.dict.empty()) return Offset<Vector<Offset<reflection::KeyValue>>>();
+	std::vector<Offset<reflection::KeyValue>> kvs;
+	for (auto it = attributes.dict.begin(); it != attributes.dict.end(); ++it) {
+		auto key = ctx.mb.CreateString(it->first);
+		auto value = ctx.mb.CreateString(it->second->constant);
+		kvs.push_back(reflection::CreateKeyValue(ctx.mb, key, value));
+	}
+	return ctx.mb.CreateVector(kvs);
+}
+
+static Offset<reflection::Field> SerializeField(
+	  Context &ctx, const FieldDef &field, size_t id) {
+	auto &type = field.value.type;
+	auto name = ctx.mb.CreateString(field.name);
+	auto field_type = SerializeType(ctx, type);
+	auto attributes = SerializeAttributes(ctx, field.attributes);
+	return reflection::CreateField(ctx.mb,
+		name,
+		field_type,
+		static_cast<uint16_t>(id),
+		static_cast<uint16_t>(field.value.offset),
+		IsInteger(type.base_type) ? StringToInt(field.value.constant.c_str()) : 0,
+		IsFloat(type.base_type) ? strtod(field.value.constant.c_str(), nullptr) : 0,
+		field.deprecated,
+		field.key,
+		attributes);
+}
+
+static Offset<reflection::Object> SerializeObject(
+	  Context &ctx, const StructDef &struct_def) {
+	std::vector<Offset<reflection::Field>> fields;
+	for (size_t i = 0; i < struct_def.fields.vec.size(); i++)
+		fields.push_back(SerializeField(ctx, *struct_def.fields.vec[i], i));
+	auto name = ctx.mb.CreateString(struct_def.name);
+	auto field_vec = ctx.mb.CreateVectorOfSortedInfos(&fields);
+	auto attributes = SerializeAttributes(ctx, struct_def.attributes);
+	return reflection::CreateObject(ctx.mb,
+		name,
+		field_vec,
+		struct_def.fixed,
+		static_cast<int32_t>(struct_def.minalign),
+		static_cast<int32_t>(struct_def.bytesize),
+		attributes);
+}
+
+static Offset<reflection::Enum> SerializeEnum(Context &ctx, const EnumDef &enum_def) {
+	std::vector<Offset<reflection::EnumVal>> values;
+	for (auto it = enum_def.vals.vec.begin(); it != enum_def.vals.vec.end(); ++it) {
+		auto &ev = **it;
+		auto name = ctx.mb.CreateString(ev.name);
+		values.push_back(reflection::CreateEnumVal(ctx.mb, name, ev.value,
+			ev.struct_def ? ctx.objects[ev.struct_def] : -1));
+	}
+	auto name = ctx.mb.CreateString(enum_def.name);
+	auto value_vec = ctx.mb.CreateVector(values);
+	auto underlying_type = SerializeType(ctx, enum_def.underlying_type);
+	auto attributes = SerializeAttributes(ctx, enum_def.attributes);
+	return reflection::CreateEnum(ctx.mb,
+		name,
+		value_vec,
+		enum_def.is_union,
+		underlying_type,
+		attributes);
+}
+
+}  // namespace schema
+
+void GenerateBinarySchema(const Parser &parser, MegrezBuilder *builder) {
+	using namespace schema;
+	std::vector<const StructDef *> structs;
+	std::vector<const EnumDef *> enums;
+	Context ctx = {
+		*builder,
+		SortedIndices(parser.structs_, &structs),
+		SortedIndices(parser.enums_, &enums)
+	};
+	std::vector<Offset<reflection::Object>> objects;
+	for (auto it = structs.begin(); it != structs.end(); ++it)
+		objects.push_back(SerializeObject(ctx, **it));
+	std::vector<Offset<reflection::Enum>> enum_offsets;
+	for (auto it = enums.begin(); it != enums.end(); ++it)
+		enum_offsets.push_back(SerializeEnum(ctx, **it));
+	std::string name_space;
+	for (auto it = parser.name_space_.begin(); it != parser.name_space_.end(); ++it)
+		name_space += (name_space.empty() ? "" : ".") + *it;
+	auto object_vec = builder->CreateVector(objects);
+	auto enum_vec = builder->CreateVector(enum_offsets);
+	auto ns = builder->CreateString(name_space);
+	builder->Finish(reflection::CreateSchema(*builder,
+		object_vec,
+		enum_vec,
+		ns,
+		parser.main_struct_def ? ctx.objects[parser.main_struct_def] : -1));
+}
+
+bool GenerateBinarySchema(const Parser &parser, const std::string &path, const std::string &file_name) {
+	MegrezBuilder builder;
+	GenerateBinarySchema(parser, &builder);
+	return SaveFileIfChanged((path + file_name + ".mgzs").c_str(),
+		reinterpret_cast<const char *>(builder.GetBufferPointer()),
+		builder.GetSize(), true);
+}
+
+}  // namespace megrez
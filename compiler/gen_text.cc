@@ -0,0 +1,262 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+#include "megrez/basic.h"
+#include "megrez/compact.h"
+#include "megrez/info.h"
+#include "megrez/string.h"
+#include "megrez/util.h"
+#include "megrez/vector.h"
+#include "compiler/idl.h"
+
+// Prints a buffer as JSON the parser reads back. Fields without storage
+// are left out, enums print as their value. Everything is appended to the
+// caller's string, no intermediate strings are built.
+
+namespace megrez {
+namespace text {
+
+template<typename T>
+static void OutputNumber(T v, std::string &text) {
+	char buf[32];
+	auto n = std::is_signed<T>::value
+		? snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v))
+		: snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(v));
+	text.append(buf, static_cast<size_t>(n));
+}
+
+// Enough digits to read back the same value.
+static void OutputNumber(float v, std::string &text) {
+	char buf[32];
+	text.append(buf, static_cast<size_t>(snprintf(buf, sizeof(buf), "%.9g", v)));
+}
+
+static void OutputNumber(double v, std::string &text) {
+	char buf[32];
+	text.append(buf, static_cast<size_t>(snprintf(buf, sizeof(buf), "%.17g", v)));
+}
+
+static void OutputScalar(BaseType type, const uint8_t *p, std::string &text) {
+	if (type == BASE_TYPE_BOOL) {
+		text += *p ? "true" : "false";
+		return;
+	}
+	switch (type) {
+		#define MEGREZ_TD(ENUM, IDLTYPE, CTYPE) \
+			case BASE_TYPE_ ## ENUM: OutputNumber(ReadScalar<CTYPE>(p), text); break;
+			MEGREZ_GEN_TYPES_SCALAR(MEGREZ_TD)
+		#undef MEGREZ_TD
+		default: assert(0);
+	}
+}
+
+static void OutputString(const String &str, std::string &text) {
+	auto s = str.c_str();
+	auto end = s + str.Length();
+	text += '\"';
+	while (s < end) {
+		// Copy runs that need no escaping at once.
+		auto run = s;
+		while (s < end && *s != '\"' && *s != '\\' &&
+		       static_cast<unsigned char>(*s) >= ' ')
+			s++;
+		text.append(run, s);
+		if (s == end) break;
+		switch (*s) {
+			case '\"': text += "\\\""; break;
+			case '\\': text += "\\\\"; break;
+			case '\n': text += "\\n"; break;
+			case '\t': text += "\\t"; break;
+			case '\r': text += "\\r"; break;
+			case '\b': text += "\\b"; break;
+			case '\f': text += "\\f"; break;
+			default:
+				text += "\\u00";
+				text += "0123456789abcdef"[(*s >> 4) & 0xF];
+				text += "0123456789abcdef"[*s & 0xF];
+				break;
+		}
+		s++;
+	}
+	text += '\"';
+}
+
+static void NewLine(int indent_step, std::string &text) {
+	if (indent_step >= 0) text += '\n';
+}
+
+static void Indent(int indent, std::string &text) {
+	if (indent > 0) text.append(static_cast<size_t>(indent), ' ');
+}
+
+static void OutputInfo(const StructDef &struct_def, const uint8_t *info,
+                       int indent, int indent_step, std::string &text);
+
+// A vector element, or a field once its storage has been found:
+// `p` is the inline value, following it for strings and infos.
+static void OutputValue(const Type &type, const uint8_t *p,
+                        int indent, int indent_step, std::string &text) {
+	switch (type.base_type) {
+		case BASE_TYPE_STRING:
+			OutputString(*reinterpret_cast<const String *>(p + ReadScalar<uofs_t>(p)), text);
+			break;
+		case BASE_TYPE_STRUCT:
+			OutputInfo(*type.struct_def,
+			           type.struct_def->fixed ? p : p + ReadScalar<uofs_t>(p),
+			           indent, indent_step, text);
+			break;
+		default:
+			OutputScalar(type.base_type, p, text);
+			break;
+	}
+}
+
+// Compact vectors decode to the bits of each element, print them as the
+// element type.
+static void OutputCompactElement(BaseType type, uint64_t bits, std::string &text) {
+	switch (type) {
+		#define MEGREZ_TD(ENUM, IDLTYPE, CTYPE) \
+			case BASE_TYPE_ ## ENUM: OutputNumber(static_cast<CTYPE>(bits), text); break;
+			MEGREZ_GEN_TYPES_SCALAR(MEGREZ_TD)
+		#undef MEGREZ_TD
+		default: assert(0);
+	}
+}
+
+static void OutputVector(const Type &type, const uint8_t *vec,
+                         int indent, int indent_step, std::string &text) {
+	auto element = type.VectorType();
+	const char *separator = "";
+	text += '[';
+	auto item = [&]() {
+		text += separator;
+		separator = ",";
+		NewLine(indent_step, text);
+		Indent(indent + indent_step, text);
+	};
+	if (type.compact) {
+		reinterpret_cast<const CompactVector<uint64_t> *>(vec)->ForEach([&](uint64_t bits) {
+			item();
+			if (element.base_type == BASE_TYPE_BOOL) text += bits & 0xFF ? "true" : "false";
+			else OutputCompactElement(element.base_type, bits, text);
+		});
+	} else {
+		auto len = ReadScalar<uofs_t>(vec);
+		auto stride = IsScalar(element.base_type) || IsStruct(element)
+			? InlineSize(element) : sizeof(uofs_t);
+		auto data = vec + sizeof(uofs_t);
+		for (uofs_t i = 0; i < len; i++) {
+			item();
+			OutputValue(element, data + i * stride, indent + indent_step, indent_step, text);
+		}
+	}
+	if (*separator) {
+		NewLine(indent_step, text);
+		Indent(indent, text);
+	}
+	text += ']';
+}
+
+static void OutputInfo(const StructDef &struct_def, const uint8_t *info,
+                       int indent, int indent_step, std::string &text) {
+	auto reader = reinterpret_cast<const Info *>(info);
+	const char *separator = "";
+	int union_type = 0;
+	text += '{';
+	for (auto it = struct_def.fields.vec.begin();
+			 it != struct_def.fields.vec.end();
+			 ++it) {
+		auto &field = **it;
+		auto &type = field.value.type;
+		const uint8_t *p;
+		if (struct_def.fixed) {
+			p = info + field.value.offset;
+		} else {
+			auto o = reader->GetOptionalFieldOffset(static_cast<vofs_t>(field.value.offset));
+			if (!o || field.deprecated) continue;
+			p = info + o;
+		}
+		text += separator;
+		separator = ",";
+		NewLine(indent_step, text);
+		Indent(indent + indent_step, text);
+		text += '\"';
+		text += field.name;
+		text += "\":";
+		if (indent_step >= 0) text += ' ';
+		auto inner = indent + indent_step;
+		switch (type.base_type) {
+			case BASE_TYPE_VECTOR:
+				OutputVector(type, p + ReadScalar<uofs_t>(p), inner, indent_step, text);
+				break;
+			case BASE_TYPE_UNION: {
+				// The `_type` field came right before.
+				auto member = type.enum_def->ReverseLookup(union_type);
+				if (member) OutputInfo(*member, p + ReadScalar<uofs_t>(p), inner, indent_step, text);
+				else text += "{}";
+				break;
+			}
+			case BASE_TYPE_UTYPE: {
+				union_type = *p;
+				// By name, unless it's one the schema doesn't know.
+				auto &vals = type.enum_def->vals.vec;
+				auto ev = std::find_if(vals.begin(), vals.end(),
+				                       [&](const EnumVal *v) { return v->value == union_type; });
+				if (ev != vals.end()) text += "\"" + (*ev)->name + "\"";
+				else OutputScalar(type.base_type, p, text);
+				break;
+			}
+			default:
+				OutputValue(type, p, inner, indent_step, text);
+				break;
+		}
+	}
+	if (*separator) {
+		NewLine(indent_step, text);
+		Indent(indent, text);
+	}
+	text += '}';
+}
+
+}  // namespace text
+
+// `buffer` has to be verified already and hold the main type of `parser`.
+// A negative `indent_step` prints everything on one line.
+void GenerateText(const Parser &parser, const void *buffer, int indent_step, std::string *text) {
+	assert(parser.main_struct_def);
+	auto root = GetRoot<uint8_t>(buffer);
+	text::OutputInfo(*parser.main_struct_def, root, 0, indent_step, *text);
+	text::NewLine(indent_step, *text);
+}
+
+bool GenerateTextFile(const Parser &parser, const std::string &path, const std::string &file_name) {
+	if (!parser.builder_.GetSize()) return true;
+	std::string text;
+	GenerateText(parser, parser.builder_.GetBufferPointer(), 2, &text);
+	return SaveFileIfChanged((path + file_name + ".json").c_str(), text, false);
+}
+
+bool GenerateBinaryFile(const Parser &parser, const std::string &path, const std::string &file_name) {
+	if (!parser.builder_.GetSize()) return true;
+	return SaveFileIfChanged((path + file_name + ".bin").c_str(),
+		reinterpret_cast<const char *>(parser.builder_.GetBufferPointer()),
+		parser.builder_.GetSize(), true);
+}
+
+}  // namespace megrez
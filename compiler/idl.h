@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef MEGREZ_IDL_H_
 #define MEGREZ_IDL_H_
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <vector>
@@ -83,13 +84,15 @@ struct Type {
 		: base_type(_base_type),
 		  element(BASE_TYPE_NONE),
 		  struct_def(_sd),
-		  enum_def(nullptr) {}
+		  enum_def(nullptr),
+		  compact(false) {}
 
 	Type VectorType() const { return Type(element, struct_def); }
 	BaseType base_type;
 	BaseType element;       // only set if t == BASE_TYPE_VECTOR
 	StructDef *struct_def;  // only set if t or element == BASE_TYPE_STRUCT
-	EnumDef *enum_def;      // only set if t == BASE_TYPE_UNION / BASE_TYPE_UTYPE
+	EnumDef *enum_def;      // only set if t is an enum, BASE_TYPE_UNION / BASE_TYPE_UTYPE
+	bool compact;           // integer vector stored as varint coded deltas
 };
 
 struct Value {
@@ -102,11 +105,9 @@ struct Value {
 
 template<typename T> 
 class SymbolInfo {
- private:
-	std::map<std::string, T *> dict;
  public:
+	std::map<std::string, T *> dict;  // first definition of each name
 	std::vector<T *> vec;
- public:
 	~SymbolInfo() { for (auto it = vec.begin(); it != vec.end(); ++it) { delete *it; } }
 	bool Add(const std::string &name, T *e) {
 		vec.emplace_back(e);
@@ -128,13 +129,18 @@ struct Definition {
 	std::string doc_comment;
 	SymbolInfo<Value> attributes;
 	bool generated;  // did we already output code for this definition?
+	std::string file;  // the schema it was declared in, if named
 };
 
 struct FieldDef : public Definition {
-	FieldDef() : deprecated(false), padding(0) {}
+	FieldDef()
+		: deprecated(false), key(false), shared(false), padding(0), nested(nullptr) {}
 	Value value;
 	bool deprecated;
+	bool key;        // Infos in vectors are sorted and searched by this field.
+	bool shared;     // Strings are written once per value, `CreateSharedString()`.
 	size_t padding;  // bytes to always pad after this field
+	StructDef *nested;  // root type of the buffer a `(nested)` [ubyte] holds
 };
 
 struct StructDef : public Definition {
@@ -142,6 +148,7 @@ struct StructDef : public Definition {
 	: fixed(false),
 	  predecl(true),
 	  sortbysize(true),
+	  has_key(false),
 	  minalign(1),
 	  bytesize(0) {}
 
@@ -151,10 +158,22 @@ struct StructDef : public Definition {
 		if (fields.vec.size()) fields.vec.back()->padding = padding;
 	}
 
+	// The fields of a struct in memory order, a (reorder) struct doesn't
+	// declare them in that order.
+	std::vector<FieldDef *> FieldsByOffset() const {
+		auto order = fields.vec;
+		std::stable_sort(order.begin(), order.end(),
+		                 [](const FieldDef *a, const FieldDef *b) {
+			return a->value.offset < b->value.offset;
+		});
+		return order;
+	}
+
 	SymbolInfo<FieldDef> fields;
 	bool fixed;       // If it's struct, not a info.
 	bool predecl;     // If it's used before it was defined.
 	bool sortbysize;  // Whether fields come in the declaration or size order.
+	bool has_key;     // If one of the fields is a key.
 	size_t minalign;  // What the whole object needs to be aligned to.
 	size_t bytesize;  // Size if fixed.
 };
@@ -171,6 +190,17 @@ inline size_t InlineAlignment(const Type &type) {
 	return IsStruct(type) ? type.struct_def->minalign : SizeOf(type.base_type);
 }
 
+// The fields of a struct by descending alignment, laid out in this order
+// only its tail can need padding.
+inline std::vector<FieldDef *> PackedFieldOrder(const StructDef &struct_def) {
+	auto order = struct_def.fields.vec;
+	std::stable_sort(order.begin(), order.end(),
+	                 [](const FieldDef *a, const FieldDef *b) {
+		return InlineAlignment(a->value.type) > InlineAlignment(b->value.type);
+	});
+	return order;
+}
+
 struct EnumVal {
 	EnumVal(const std::string &_name, int _val) 
 	: name(_name), value(_val), struct_def(nullptr) {}
@@ -200,12 +230,16 @@ class Parser {
 		main_struct_def(nullptr),
 		source_(nullptr),
 		cursor_(nullptr),
-		line_(1) {}
-	bool Parse(const char *_source);
+		line_(1),
+		include_depth_(0) {}
+	// Includes are looked up next to `source_filename` first, then in
+	// `include_paths_`.
+	bool Parse(const char *_source, const char *source_filename = nullptr);
 	bool SetMainType(const char *name);
 
  private:
 	void Next();
+	void ParseUnicodeEscape();
 	bool IsNext(int t);
 	void Expect(int t);
 	void ParseType(Type &type);
@@ -215,13 +249,16 @@ class Parser {
 	uofs_t ParseInfo(const StructDef &struct_def);
 	void SerializeStruct(const StructDef &struct_def, const Value &val);
 	void AddVector(bool sortbysize, int count);
-	uofs_t ParseVector(const Type &type);
+	uofs_t ParseVector(const Type &type, FieldDef *field = nullptr);
+	uofs_t ParseCompactVector(const Type &type);
 	void ParseMetaData(Definition &def);
 	bool TryTypedValue(int dtoken, bool check, Value &e, BaseType req);
 	void ParseSingleValue(Value &e);
 	StructDef *LookupCreateStruct(const std::string &name);
 	void ParseEnum(bool is_union);
 	void ParseDecl();
+	void ParseInclude(const std::string &name);
+	void ParseFile(const char *source);
 
  public:
 	SymbolInfo<StructDef> structs_;
@@ -230,6 +267,9 @@ class Parser {
 	std::string error_;         // User readable error_ if Parse() == false
 	MegrezBuilder builder_;  // any data contained in the file
 	StructDef *main_struct_def;
+	std::vector<std::string> include_paths_;
+	std::vector<std::string> includes_;      // as written in the last file parsed
+	std::vector<std::string> dependencies_;  // all files it included, transitively
 
  private:
 	const char *source_, *cursor_;
@@ -238,13 +278,32 @@ class Parser {
 	std::string attribute_, doc_comment_;
 	std::vector<std::pair<Value, FieldDef *>> field_stack_;
 	std::vector<uint8_t> struct_stack_;
+	std::string file_;  // the one being parsed, if named
+	int include_depth_;
+	// What each file parsed so far included, so it's parsed only once.
+	std::map<std::string, std::vector<std::string>> file_dependencies_;
+	// What a file parsed to the end left behind, for a file that is
+	// included again or passed to `Parse()` after being included.
+	struct ParsedFile {
+		std::vector<std::string> includes;    // as written
+		std::vector<std::string> name_space;  // the one it ended in
+		StructDef *main_struct_def;
+	};
+	std::map<std::string, ParsedFile> parsed_files_;
 };
 
 extern void GenerateText(const Parser &parser, const void *Megrez, int indent_step, std::string *text);
+extern bool GenerateTextFile(const Parser &parser, const std::string &path, const std::string &file_name);
+extern bool GenerateBinaryFile(const Parser &parser, const std::string &path, const std::string &file_name);
 
-extern std::string GenerateCPP(const Parser &parser);
+extern std::string GenerateCPP(const Parser &parser, const std::string &file_name);
 extern bool GenerateCPP(const Parser &parser, const std::string &path, const std::string &file_name);
 
+extern bool GenerateLayoutReport(const Parser &parser, const std::string &path, const std::string &file_name);
+
+extern void GenerateBinarySchema(const Parser &parser, MegrezBuilder *builder);
+extern bool GenerateBinarySchema(const Parser &parser, const std::string &path, const std::string &file_name);
+
 }  // namespace megrez
 
 #endif  // MEGREZ_IDL_H_
\ No newline at end of file
@@ -14,9 +14,11 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ========================================================================*/
 // The implementation of parser in `idl.h`
+#include <cstring>
 
 #include "megrez/basic.h"
 #include "megrez/builder.h"
+#include "megrez/compact.h"
 #include "megrez/info.h"
 #include "megrez/string.h"
 #include "megrez/struct.h"
@@ -43,28 +45,48 @@ static void Error(const std::string &msg) { throw msg; }
 
 // Ensure that integer values we parse fit inside the declared integer type.
 static void CheckBitsFit(int64_t val, size_t bits) {
+	if (bits >= 64) return;
 	auto mask = (1ll << bits) - 1;  // Bits we allow to be used.
-	if (bits < 64 &&
-		(val & ~mask) != 0 &&  // Positive or unsigned.
+	if ((val & ~mask) != 0 &&  // Positive or unsigned.
 		(val |  mask) != -1)   // Negative.
 		Error("Constant does not fit in a " + NumToString(bits) + "-bit field");
 }
 
+// Decimal integers as the tokenizer produces them, without going through
+// strtoull. Like it, a negative value wraps, but anything beyond 64 bits
+// is an error.
+static int64_t ParseInteger(const char *s) {
+	bool negative = *s == '-';
+	if (negative) s++;
+	uint64_t val = 0;
+	while (*s >= '0' && *s <= '9') {
+		auto digit = static_cast<uint64_t>(*s++ - '0');
+		if (val > (UINT64_MAX - digit) / 10)
+			Error("Constant does not fit in a 64-bit field");
+		val = val * 10 + digit;
+	}
+	if (negative && val > static_cast<uint64_t>(INT64_MAX) + 1)
+		Error("Constant does not fit in a 64-bit field");
+	return static_cast<int64_t>(negative ? 0 - val : val);
+}
+
 // atot: templated version of atoi/atof: convert a string to an instance of T.
 template<typename T> 
 inline T atot(const char *s) {
-	auto val = StringToInt(s);
+	auto val = ParseInteger(s);
 	CheckBitsFit(val, sizeof(T) * 8);
 	return (T)val;
 }
 template<> 
-inline bool atot<bool>(const char *s) { return 0 != atoi(s); }
+inline bool atot<bool>(const char *s) { return 0 != ParseInteger(s); }
 template<> 
 inline float atot<float>(const char *s) { return static_cast<float>(strtod(s, nullptr)); }
 template<> 
 inline double atot<double>(const char *s) { return strtod(s, nullptr); }
 template<> 
-inline Offset<void> atot<Offset<void>>(const char *s) { return Offset<void>(atoi(s)); }
+inline Offset<void> atot<Offset<void>>(const char *s) {
+	return Offset<void>(static_cast<uofs_t>(ParseInteger(s)));
+}
 
 #define MEGREZ_GEN_TOKENS(TD) \
 	TD(Eof, 256, "end of file") \
@@ -77,7 +99,8 @@ inline Offset<void> atot<Offset<void>>(const char *s) { return Offset<void>(atoi
 	TD(Enum, 263, "enum") \
 	TD(Union, 264, "union") \
 	TD(NameSpace, 265, "namespace") \
-	TD(MainType, 266, "Main")
+	TD(MainType, 266, "Main") \
+	TD(Include, 267, "include")
 enum {
 	#define MEGREZ_TOKEN(NAME, VALUE, STRING) kToken ## NAME,
 		MEGREZ_GEN_TOKENS(MEGREZ_TOKEN)
@@ -103,6 +126,88 @@ static std::string TokenToString(int t) {
 	} else { return tokens[t - 256]; } // Other tokens.
 }
 
+// Keywords and type names by length and contents, anything else is an
+// identifier. `true` and `false` come back as integer constants.
+static int KeywordToken(const char *s, size_t len) {
+	#define MEGREZ_KEYWORD(STR, TOKEN) \
+		if (len == sizeof(STR) - 1 && !memcmp(s, STR, len)) return TOKEN;
+	switch (*s) {
+		case 'M': MEGREZ_KEYWORD("Main", kTokenMainType) break;
+		case 'b': MEGREZ_KEYWORD("bool", kTokenBOOL) MEGREZ_KEYWORD("byte", kTokenCHAR) break;
+		case 'd': MEGREZ_KEYWORD("double", kTokenDOUBLE) break;
+		case 'e': MEGREZ_KEYWORD("enum", kTokenEnum) break;
+		case 'f':
+			MEGREZ_KEYWORD("float", kTokenFLOAT)
+			MEGREZ_KEYWORD("false", kTokenIntegerConstant)
+			break;
+		case 'i':
+			MEGREZ_KEYWORD("int", kTokenINT)
+			MEGREZ_KEYWORD("info", kTokenInfo)
+			MEGREZ_KEYWORD("include", kTokenInclude)
+			break;
+		case 'l': MEGREZ_KEYWORD("long", kTokenLONG) break;
+		case 'n': MEGREZ_KEYWORD("namespace", kTokenNameSpace) break;
+		case 's':
+			MEGREZ_KEYWORD("short", kTokenSHORT)
+			MEGREZ_KEYWORD("string", kTokenSTRING)
+			MEGREZ_KEYWORD("struct", kTokenStruct)
+			break;
+		case 't': MEGREZ_KEYWORD("true", kTokenIntegerConstant) break;
+		case 'u':
+			MEGREZ_KEYWORD("ubyte", kTokenUCHAR)
+			MEGREZ_KEYWORD("ushort", kTokenUSHORT)
+			MEGREZ_KEYWORD("uint", kTokenUINT)
+			MEGREZ_KEYWORD("ulong", kTokenULONG)
+			MEGREZ_KEYWORD("union", kTokenUnion)
+			break;
+	}
+	#undef MEGREZ_KEYWORD
+	return kTokenIdentifier;
+}
+
+// Appends the UTF-8 encoding of a `\uXXXX` escape, the cursor is past
+// the `u`. Surrogate pairs are combined.
+void Parser::ParseUnicodeEscape() {
+	auto hex4 = [this]() {
+		uint32_t v = 0;
+		for (int i = 0; i < 4; i++) {
+			auto c = *cursor_;
+			if (!isxdigit(static_cast<unsigned char>(c)))
+				Error("Escape code must be followed by 4 hex digits");
+			cursor_++;
+			v = v * 16 + static_cast<uint32_t>(isdigit(static_cast<unsigned char>(c))
+				? c - '0' : (c | 0x20) - 'a' + 10);
+		}
+		return v;
+	};
+	auto cp = hex4();
+	if (cp >= 0xD800 && cp < 0xDC00) {
+		if (cursor_[0] != '\\' || cursor_[1] != 'u')
+			Error("Unpaired surrogate in string constant");
+		cursor_ += 2;
+		auto lo = hex4();
+		if (lo < 0xDC00 || lo >= 0xE000) Error("Unpaired surrogate in string constant");
+		cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+	} else if (cp >= 0xDC00 && cp < 0xE000) {
+		Error("Unpaired surrogate in string constant");
+	}
+	if (cp < 0x80) {
+		attribute_ += static_cast<char>(cp);
+	} else if (cp < 0x800) {
+		attribute_ += static_cast<char>(0xC0 | (cp >> 6));
+		attribute_ += static_cast<char>(0x80 | (cp & 0x3F));
+	} else if (cp < 0x10000) {
+		attribute_ += static_cast<char>(0xE0 | (cp >> 12));
+		attribute_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+		attribute_ += static_cast<char>(0x80 | (cp & 0x3F));
+	} else {
+		attribute_ += static_cast<char>(0xF0 | (cp >> 18));
+		attribute_ += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+		attribute_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+		attribute_ += static_cast<char>(0x80 | (cp & 0x3F));
+	}
+}
+
 void Parser::Next() {
 	doc_comment_.clear();
 	bool seen_newline = false;
@@ -120,22 +225,28 @@ void Parser::Next() {
 				Error("Floating point constant can\'t start with \".\"");
 				break;
 			case '\"':
-				attribute_ = "";
-				while (*cursor_ != '\"') {
-					if (*cursor_ < ' ' && *cursor_ >= 0)
-						Error("Illegal character in string constant");
-					if (*cursor_ == '\\') {
+				attribute_.clear();
+				for (;;) {
+					// Copy runs of plain characters at once.
+					const char *run = cursor_;
+					while (*cursor_ != '\"' && *cursor_ != '\\' &&
+								 static_cast<unsigned char>(*cursor_) >= ' ')
 						cursor_++;
-						switch (*cursor_) {
-							case 'n':  attribute_ += '\n'; cursor_++; break;
-							case 't':  attribute_ += '\t'; cursor_++; break;
-							case 'r':  attribute_ += '\r'; cursor_++; break;
-							case '\"': attribute_ += '\"'; cursor_++; break;
-							case '\\': attribute_ += '\\'; cursor_++; break;
-							default: Error("Unknown escape code in string constant"); break;
-						}
-					} else {
-						attribute_ += *cursor_++;
+					attribute_.append(run, cursor_);
+					if (*cursor_ == '\"') break;
+					if (*cursor_ != '\\') Error("Illegal character in string constant");
+					cursor_++;
+					switch (*cursor_++) {
+						case 'n':  attribute_ += '\n'; break;
+						case 't':  attribute_ += '\t'; break;
+						case 'r':  attribute_ += '\r'; break;
+						case 'b':  attribute_ += '\b'; break;
+						case 'f':  attribute_ += '\f'; break;
+						case '\"': attribute_ += '\"'; break;
+						case '\\': attribute_ += '\\'; break;
+						case '/':  attribute_ += '/'; break;
+						case 'u':  ParseUnicodeEscape(); break;
+						default: Error("Unknown escape code in string constant"); break;
 					}
 				}
 				cursor_++;
@@ -161,45 +272,30 @@ void Parser::Next() {
 					while (isalnum(static_cast<unsigned char>(*cursor_)) ||
 								 *cursor_ == '_')
 						cursor_++;
-					attribute_.clear();
-					attribute_.append(start, cursor_);
-					// First, see if it is a type keyword from the info of types:
-					#define MEGREZ_TD(ENUM, IDLTYPE, CTYPE) \
-						if (attribute_ == IDLTYPE) { \
-							token_ = kToken ## ENUM; \
-							return; \
-						}
-						MEGREZ_GEN_TYPES(MEGREZ_TD)
-					#undef MEGREZ_TD
-					// If it's a boolean constant keyword, turn those into integers,
-					// which simplifies our logic downstream.
-					if (attribute_ == "true" || attribute_ == "false") {
-						attribute_ = NumToString(attribute_ == "true");
-						token_ = kTokenIntegerConstant;
-						return;
-					}
-					// Check for declaration keywords:
-					if (attribute_ == "info")     { token_ = kTokenInfo;     return; }
-					if (attribute_ == "struct")    { token_ = kTokenStruct;    return; }
-					if (attribute_ == "enum")      { token_ = kTokenEnum;      return; }
-					if (attribute_ == "union")     { token_ = kTokenUnion;     return; }
-					if (attribute_ == "namespace") { token_ = kTokenNameSpace; return; }
-					if (attribute_ == "Main") { token_ = kTokenMainType;  return; }
-					// If not, it is a user-defined identifier:
-					token_ = kTokenIdentifier;
+					attribute_.assign(start, cursor_);
+					token_ = KeywordToken(start, static_cast<size_t>(cursor_ - start));
+					// Boolean constants are integers downstream.
+					if (token_ == kTokenIntegerConstant)
+						attribute_.assign(1, *start == 't' ? '1' : '0');
 					return;
 				} else if (isdigit(static_cast<unsigned char>(c)) || c == '-') {
 					const char *start = cursor_ - 1;
 					while (isdigit(static_cast<unsigned char>(*cursor_))) cursor_++;
+					token_ = kTokenIntegerConstant;
 					if (*cursor_ == '.') {
 						cursor_++;
 						while (isdigit(static_cast<unsigned char>(*cursor_))) cursor_++;
 						token_ = kTokenFloatConstant;
-					} else {
-						token_ = kTokenIntegerConstant;
 					}
-					attribute_.clear();
-					attribute_.append(start, cursor_);
+					if (*cursor_ == 'e' || *cursor_ == 'E') {
+						cursor_++;
+						if (*cursor_ == '+' || *cursor_ == '-') cursor_++;
+						if (!isdigit(static_cast<unsigned char>(*cursor_)))
+							Error("Missing exponent digits in number");
+						while (isdigit(static_cast<unsigned char>(*cursor_))) cursor_++;
+						token_ = kTokenFloatConstant;
+					}
+					attribute_.assign(start, cursor_);
 					return;
 				}
 				std::string ch;
@@ -232,6 +328,7 @@ void Parser::ParseType(Type &type) {
 			auto enum_def = enums_.Lookup(attribute_);
 			if (enum_def) {
 				type = enum_def->underlying_type;
+				type.enum_def = enum_def;
 				if (enum_def->is_union) type.base_type = BASE_TYPE_UNION;
 			} else {
 				type.base_type = BASE_TYPE_STRUCT;
@@ -311,6 +408,38 @@ void Parser::ParseField(StructDef &struct_def) {
 	field.deprecated = field.attributes.Lookup("deprecated") != nullptr;
 	if (field.deprecated && struct_def.fixed)
 		Error("Cannot deprecate fields in a struct");
+	field.key = field.attributes.Lookup("key") != nullptr;
+	if (field.key) {
+		if (struct_def.fixed)
+			Error("Only infos can have a key field");
+		if (struct_def.has_key)
+			Error("Only one field may be set as key: " + field.name);
+		if (!IsScalar(type.base_type) && type.base_type != BASE_TYPE_STRING)
+			Error("Key field must be a scalar or a string: " + field.name);
+		if (field.deprecated)
+			Error("Cannot deprecate a key field: " + field.name);
+		struct_def.has_key = true;
+	}
+	field.value.type.compact = field.attributes.Lookup("compact") != nullptr;
+	if (field.value.type.compact) {
+		if (struct_def.fixed)
+			Error("Only infos can have a compact field");
+		if (type.base_type != BASE_TYPE_VECTOR || !IsInteger(type.element))
+			Error("Only vectors of integers can be compact: " + field.name);
+	}
+	field.shared = field.attributes.Lookup("shared") != nullptr;
+	if (field.shared && type.base_type != BASE_TYPE_STRING &&
+			(type.base_type != BASE_TYPE_VECTOR || type.element != BASE_TYPE_STRING))
+		Error("Only strings and vectors of strings can be shared: " + field.name);
+	auto nested = field.attributes.Lookup("nested");
+	if (nested) {
+		if (nested->type.base_type != BASE_TYPE_STRING)
+			Error("nested needs the name of an info: " + field.name);
+		if (type.base_type != BASE_TYPE_VECTOR || type.element != BASE_TYPE_UCHAR ||
+				type.compact)
+			Error("Only a [ubyte] field can hold a nested buffer: " + field.name);
+		field.nested = LookupCreateStruct(nested->constant);
+	}
 	Expect(';');
 }
 
@@ -331,15 +460,18 @@ void Parser::ParseAnyValue(Value &val, FieldDef *field) {
 		case BASE_TYPE_STRUCT:
 			val.constant = NumToString(ParseInfo(*val.type.struct_def));
 			break;
-		case BASE_TYPE_STRING: {
-			auto s = attribute_;
-			Expect(kTokenStringConstant);
-			val.constant = NumToString(builder_.CreateString(s).o);
+		case BASE_TYPE_STRING:
+			if (token_ != kTokenStringConstant) Expect(kTokenStringConstant);
+			val.constant = NumToString((field && field->shared
+				? builder_.CreateSharedString(attribute_)
+				: builder_.CreateString(attribute_)).o);
+			Next();
 			break;
-		}
 		case BASE_TYPE_VECTOR: {
 			Expect('[');
-			val.constant = NumToString(ParseVector(val.type.VectorType()));
+			val.constant = NumToString(val.type.compact
+				? ParseCompactVector(val.type.VectorType())
+				: ParseVector(val.type.VectorType(), field));
 			break;
 		}
 		default:
@@ -348,31 +480,34 @@ void Parser::ParseAnyValue(Value &val, FieldDef *field) {
 	}
 }
 
+// The caller releases `struct_stack_`, the fields of a (reorder) struct
+// aren't serialized in the order they were parsed in.
 void Parser::SerializeStruct(const StructDef &struct_def, const Value &val) {
 	auto off = atot<uofs_t>(val.constant.c_str());
-	assert(struct_stack_.size() - off == struct_def.bytesize);
+	assert(off + struct_def.bytesize <= struct_stack_.size());
 	builder_.Align(struct_def.minalign);
 	builder_.PushBytes(&struct_stack_[off], struct_def.bytesize);
-	struct_stack_.resize(struct_stack_.size() - struct_def.bytesize);
 	builder_.AddStructOffset(val.offset, builder_.GetSize());
 }
 
 uofs_t Parser::ParseInfo(const StructDef &struct_def) {
 	Expect('{');
+	auto struct_stack_start = struct_stack_.size();
 	size_t fieldn = 0;
 	for (;;) {
-		std::string name = attribute_;
-		if (!IsNext(kTokenStringConstant)) Expect(kTokenIdentifier);
-		auto field = struct_def.fields.Lookup(name);
-		if (!field) Error("Unknown field: " + name);
+		if (token_ != kTokenStringConstant && token_ != kTokenIdentifier)
+			Expect(kTokenIdentifier);
+		auto field = struct_def.fields.Lookup(attribute_);
+		if (!field) Error("Unknown field: " + attribute_);
 		if (struct_def.fixed && (fieldn >= struct_def.fields.vec.size()
 			|| struct_def.fields.vec[fieldn] != field)) {
-			 Error("Struct field appearing out of order: " + name);
+			 Error("Struct field appearing out of order: " + field->name);
 		}
+		Next();
 		Expect(':');
 		Value val = field->value;
 		ParseAnyValue(val, field);
-		field_stack_.push_back(std::make_pair(val, field));
+		field_stack_.push_back(std::make_pair(std::move(val), field));
 		fieldn++;
 		if (IsNext('}')) break;
 		Expect(',');
@@ -382,6 +517,15 @@ uofs_t Parser::ParseInfo(const StructDef &struct_def) {
 	auto start = struct_def.fixed
 				? builder_.StartStruct(struct_def.minalign)
 				: builder_.StartInfo();
+	if (struct_def.fixed) {
+		// Written back to front in memory order, which is the declaration
+		// order unless the struct was reordered.
+		std::stable_sort(field_stack_.end() - fieldn, field_stack_.end(),
+		                 [](const std::pair<Value, FieldDef *> &a,
+		                    const std::pair<Value, FieldDef *> &b) {
+			return a.second->value.offset < b.second->value.offset;
+		});
+	}
 
 	for (size_t size = struct_def.sortbysize ? sizeof(max_scalar_t) : 1;
 			 size;
@@ -396,9 +540,14 @@ uofs_t Parser::ParseInfo(const StructDef &struct_def) {
 					#define MEGREZ_TD(ENUM, IDLTYPE, CTYPE) \
 						case BASE_TYPE_ ## ENUM: \
 							builder_.Pad(field->padding); \
-							builder_.AddElement(value.offset, \
-												atot<CTYPE>(value.constant.c_str()), \
-												atot<CTYPE>(field->value.constant.c_str())); \
+							/* Struct fields are always stored, defaults too. */ \
+							if (struct_def.fixed) { \
+								builder_.PushElement(atot<CTYPE>(value.constant.c_str())); \
+							} else { \
+								builder_.AddElement(value.offset, \
+													atot<CTYPE>(value.constant.c_str()), \
+													atot<CTYPE>(field->value.constant.c_str())); \
+							} \
 							break;
 						MEGREZ_GEN_TYPES_SCALAR(MEGREZ_TD);
 					#undef MEGREZ_TD
@@ -419,6 +568,7 @@ uofs_t Parser::ParseInfo(const StructDef &struct_def) {
 		}
 	}
 	for (size_t i = 0; i < fieldn; i++) field_stack_.pop_back();
+	struct_stack_.resize(struct_stack_start);
 
 	if (struct_def.fixed) {
 		builder_.ClearOffsets();
@@ -436,19 +586,59 @@ uofs_t Parser::ParseInfo(const StructDef &struct_def) {
 	}
 }
 
-uofs_t Parser::ParseVector(const Type &type) {
+// Orders the infos at builder offsets `a` and `b` by their `key` field, as
+// the generated `KeyCompareLessThan()` does, an absent field reads as its
+// default.
+static bool KeyLessThan(const MegrezBuilder &builder, const FieldDef &key,
+                        uofs_t a, uofs_t b) {
+	auto end = builder.GetBufferPointer() + builder.GetSize();
+	auto info_a = reinterpret_cast<const Info *>(end - a);
+	auto info_b = reinterpret_cast<const Info *>(end - b);
+	auto offset = static_cast<vofs_t>(key.value.offset);
+	switch (key.value.type.base_type) {
+		case BASE_TYPE_STRING:
+			return CompareStrings(info_a->GetPointer<const String *>(offset),
+			                      info_b->GetPointer<const String *>(offset)) < 0;
+		#define MEGREZ_TD(ENUM, IDLTYPE, CTYPE) \
+			case BASE_TYPE_ ## ENUM: { \
+				auto def = atot<CTYPE>(key.value.constant.c_str()); \
+				return info_a->GetField<CTYPE>(offset, def) < info_b->GetField<CTYPE>(offset, def); \
+			}
+			MEGREZ_GEN_TYPES_SCALAR(MEGREZ_TD)
+		#undef MEGREZ_TD
+		default:
+			return false;
+	}
+}
+
+// `field` is only passed on to strings, for `(shared)`.
+uofs_t Parser::ParseVector(const Type &type, FieldDef *field) {
 	int count = 0;
+	auto struct_stack_start = struct_stack_.size();
 	if (token_ != ']') for (;;) {
 		Value val;
 		val.type = type;
-		ParseAnyValue(val, NULL);
-		field_stack_.push_back(std::make_pair(val, nullptr));
+		ParseAnyValue(val, type.base_type == BASE_TYPE_STRING ? field : NULL);
+		field_stack_.push_back(std::make_pair(std::move(val), nullptr));
 		count++;
 		if (token_ == ']') break;
 		Expect(',');
 	}
 	Next();
 
+	// Infos with a key are stored sorted, so `LookupByKey()` finds them.
+	if (type.base_type == BASE_TYPE_STRUCT && !type.struct_def->fixed &&
+			type.struct_def->has_key) {
+		auto &fields = type.struct_def->fields.vec;
+		auto key = *std::find_if(fields.begin(), fields.end(),
+		                         [](const FieldDef *f) { return f->key; });
+		std::stable_sort(field_stack_.end() - count, field_stack_.end(),
+			[&](const std::pair<Value, FieldDef *> &a, const std::pair<Value, FieldDef *> &b) {
+				return KeyLessThan(builder_, *key, atot<uofs_t>(a.first.constant.c_str()),
+				                   atot<uofs_t>(b.first.constant.c_str()));
+			});
+	}
+
 	builder_.StartVector(count * InlineSize(type), InlineAlignment((type)));
 	for (int i = 0; i < count; i++) {
 		// start at the back, since we're building the data backwards.
@@ -464,11 +654,37 @@ uofs_t Parser::ParseVector(const Type &type) {
 		}
 		field_stack_.pop_back();
 	}
+	struct_stack_.resize(struct_stack_start);
 
 	builder_.ClearOffsets();
 	return builder_.EndVector(count);
 }
 
+// Elements are truncated to their declared type before they are coded,
+// so the buffer decodes to what a plain vector would have held.
+uofs_t Parser::ParseCompactVector(const Type &type) {
+	std::vector<uint64_t> elems;
+	if (token_ != ']') for (;;) {
+		Value val;
+		val.type = type;
+		ParseSingleValue(val);
+		switch (type.base_type) {
+			#define MEGREZ_TD(ENUM, IDLTYPE, CTYPE) \
+				case BASE_TYPE_ ## ENUM: \
+					elems.push_back(WidenInteger(atot<CTYPE>(val.constant.c_str()))); \
+					break;
+				MEGREZ_GEN_TYPES_SCALAR(MEGREZ_TD)
+			#undef MEGREZ_TD
+			default:
+				assert(0);
+		}
+		if (token_ == ']') break;
+		Expect(',');
+	}
+	Next();
+	return CreateCompactVector(builder_, elems).o;
+}
+
 void Parser::ParseMetaData(Definition &def) {
 	if (IsNext('(')) {
 		for (;;) {
@@ -476,7 +692,16 @@ void Parser::ParseMetaData(Definition &def) {
 			Expect(kTokenIdentifier);
 			auto e = new Value();
 			def.attributes.Add(name, e);
-			if (IsNext(':')) { ParseSingleValue(*e); }
+			if (IsNext(':')) {
+				// A type name, like `(nested: Type)` takes, is kept as a string.
+				if (token_ == kTokenIdentifier) {
+					e->constant = attribute_;
+					e->type.base_type = BASE_TYPE_STRING;
+					Next();
+				} else {
+					ParseSingleValue(*e);
+				}
+			}
 			if (IsNext(')')) { break; }
 			Expect(',');
 		}
@@ -503,6 +728,14 @@ bool Parser::TryTypedValue(int dtoken, bool check, Value &e, BaseType req) {
 }
 
 void Parser::ParseSingleValue(Value &e) {
+	// A quoted enum value, as the text generator prints union types.
+	if (token_ == kTokenStringConstant && e.type.enum_def && IsInteger(e.type.base_type)) {
+		auto ev = e.type.enum_def->vals.Lookup(attribute_);
+		if (!ev) Error("Not valid enum value: " + attribute_);
+		attribute_ = NumToString(ev->value);
+		TryTypedValue(kTokenStringConstant, true, e, BASE_TYPE_INT);
+		return;
+	}
 	if (TryTypedValue(kTokenIntegerConstant,
 					  IsScalar(e.type.base_type), e,
 					  BASE_TYPE_INT) ||
@@ -549,6 +782,7 @@ void Parser::ParseEnum(bool is_union) {
 	Expect(kTokenIdentifier);
 	auto &enum_def = *new EnumDef();
 	enum_def.name = name;
+	enum_def.file = file_;
 	enum_def.doc_comment = dc;
 	enum_def.is_union = is_union;
 	if (enums_.Add(name, &enum_def)) Error("Enum already exists: " + name);
@@ -592,6 +826,27 @@ void Parser::ParseEnum(bool is_union) {
 	Expect('}');
 }
 
+// Lays a struct out again in `PackedFieldOrder()`, since every inline size
+// is a multiple of its alignment that leaves only tail padding.
+static void ReorderStruct(StructDef &struct_def) {
+	struct_def.bytesize = 0;
+	FieldDef *last = nullptr;
+	auto order = PackedFieldOrder(struct_def);
+	for (auto it = order.begin(); it != order.end(); ++it) {
+		auto &field = **it;
+		auto padding = PaddingBytes(struct_def.bytesize, InlineAlignment(field.value.type));
+		if (last) last->padding = padding;
+		struct_def.bytesize += padding;
+		field.padding = 0;
+		field.value.offset = static_cast<uofs_t>(struct_def.bytesize);
+		struct_def.bytesize += InlineSize(field.value.type);
+		last = &field;
+	}
+	auto padding = PaddingBytes(struct_def.bytesize, struct_def.minalign);
+	if (last) last->padding = padding;
+	struct_def.bytesize += padding;
+}
+
 void Parser::ParseDecl() {
 	std::string dc = doc_comment_;
 	bool fixed = IsNext(kTokenStruct);
@@ -602,6 +857,7 @@ void Parser::ParseDecl() {
 	if (!struct_def.predecl) Error("Datatype already exists: " + name);
 	struct_def.predecl = false;
 	struct_def.name = name;
+	struct_def.file = file_;
 	struct_def.doc_comment = dc;
 	struct_def.fixed = fixed;
 	// Move this struct to the back of the vector just in case it was predeclared,
@@ -613,7 +869,13 @@ void Parser::ParseDecl() {
 		struct_def.attributes.Lookup("Original_order") == nullptr && !fixed;
 	Expect('{');
 	while (token_ != '}') ParseField(struct_def);
-	struct_def.PadLastField(struct_def.minalign);
+	if (struct_def.attributes.Lookup("reorder")) {
+		if (!fixed) Error("Only structs can be reordered, info fields are "
+		                  "already stored by size: " + name);
+		ReorderStruct(struct_def);
+	} else {
+		struct_def.PadLastField(struct_def.minalign);
+	}
 	Expect('}');
 	auto force_align = struct_def.attributes.Lookup("Force_align");
 	if (fixed && force_align) {
@@ -633,67 +895,180 @@ bool Parser::SetMainType(const char *name) {
 	return main_struct_def != nullptr;
 }
 
-bool Parser::Parse(const char *source) {
-	source_ = cursor_ = source;
-	line_ = 1;
+// Parses an included file into this parser, once per path. Its
+// definitions are marked generated, the header of the includer includes
+// the one generated for them instead.
+void Parser::ParseInclude(const std::string &name) {
+	auto slash = file_.find_last_of("/\\");
+	std::vector<std::string> candidates;
+	candidates.push_back(slash == std::string::npos ? name : file_.substr(0, slash + 1) + name);
+	for (auto it = include_paths_.begin(); it != include_paths_.end(); ++it)
+		candidates.push_back(*it + (it->empty() || it->back() == '/' ? "" : "/") + name);
+	std::string path, contents;
+	for (auto it = candidates.begin(); it != candidates.end() && path.empty(); ++it)
+		if (LoadFile(it->c_str(), true, &contents)) path = *it;
+	if (path.empty()) Error("Unable to load include file: " + name);
+	auto &deps = file_dependencies_[file_];
+	if (std::find(deps.begin(), deps.end(), path) == deps.end()) deps.push_back(path);
+	auto parsed = file_dependencies_.find(path);
+	if (parsed != file_dependencies_.end()) {
+		// Started but not finished, it includes itself somehow.
+		if (!parsed_files_.count(path)) Error("Cyclic include of: " + name);
+		deps.insert(deps.end(), parsed->second.begin(), parsed->second.end());
+		return;
+	}
+	// The includer's tokenizer state, its main type and namespace.
+	auto source = source_;
+	auto cursor = cursor_;
+	auto line = line_;
+	auto token = token_;
+	auto attribute = attribute_;
+	auto doc_comment = doc_comment_;
+	auto file = file_;
+	auto main_struct = main_struct_def;
+	auto name_space = name_space_;
+	include_depth_++;
+	file_ = path;
+	name_space_.clear();
+	file_dependencies_[path];
+	ParseFile(contents.c_str());
+	include_depth_--;
+	auto &included = file_dependencies_[path];
+	auto &includer = file_dependencies_[file];
+	includer.insert(includer.end(), included.begin(), included.end());
+	source_ = source;
+	cursor_ = cursor;
+	line_ = line;
+	token_ = token;
+	attribute_ = attribute;
+	doc_comment_ = doc_comment;
+	file_ = file;
+	main_struct_def = main_struct;
+	name_space_ = name_space;
+}
+
+bool Parser::Parse(const char *source, const char *source_filename) {
+	file_ = source_filename ? source_filename : "";
 	error_.clear();
+	includes_.clear();
+	include_depth_ = 0;
 	builder_.Clear();
 	try {
+		auto parsed = file_.empty() ? parsed_files_.end() : parsed_files_.find(file_);
+		if (parsed != parsed_files_.end()) {
+			// Already parsed as an include: back to what it declared, its own
+			// definitions are generated again.
+			for (auto it = structs_.vec.begin(); it != structs_.vec.end(); ++it)
+				(*it)->generated = (*it)->file != file_;
+			for (auto it = enums_.vec.begin(); it != enums_.vec.end(); ++it)
+				(*it)->generated = (*it)->file != file_;
+			includes_ = parsed->second.includes;
+			name_space_ = parsed->second.name_space;
+			main_struct_def = parsed->second.main_struct_def;
+		} else {
+			file_dependencies_[file_].clear();
+			ParseFile(source);
+		}
+		// Distinct, in the order they were first included.
+		auto &deps = file_dependencies_[file_];
+		dependencies_.clear();
+		for (auto it = deps.begin(); it != deps.end(); ++it)
+			if (std::find(dependencies_.begin(), dependencies_.end(), *it) == dependencies_.end())
+				dependencies_.push_back(*it);
+	} catch (const std::string &msg) {
+		error_ = (file_.empty() ? "" : file_ + ": ") + "Line " + NumToString(line_) + ": " + msg;
+		return false;
+	}
+	assert(!struct_stack_.size());
+	return true;
+}
+
+void Parser::ParseFile(const char *source) {
+	source_ = cursor_ = source;
+	line_ = 1;
+	Next();
+	std::vector<std::string> includes;
+	while (token_ == kTokenInclude) {
 		Next();
-		while (token_ != kTokenEof) {
-			if (token_ == kTokenNameSpace) {
-				Next();
-				for (;;) {
-					name_space_.push_back(attribute_);
-					Expect(kTokenIdentifier);
-					if (!IsNext('.')) break;
-				}
-				Expect(';');
-			} else if (token_ == '{') {
-				if (!main_struct_def) Error("No main type set to parse json with");
-				if (builder_.GetSize()) {
-					Error("Cannot have more than one json object in a file");
-				}
-				builder_.Finish(Offset<Info>(ParseInfo(*main_struct_def)));
-			} else if (token_ == kTokenEnum) {
-				ParseEnum(false);
-			} else if (token_ == kTokenUnion) {
-				ParseEnum(true);
-			} else if (token_ == kTokenMainType) {
-				Next();
-				auto Main = attribute_;
+		auto name = attribute_;
+		Expect(kTokenStringConstant);
+		includes.push_back(name);
+		ParseInclude(name);
+		Expect(';');
+	}
+	if (!include_depth_) includes_ = includes;
+	if (includes.size()) {
+		for (auto it = structs_.vec.begin(); it != structs_.vec.end(); ++it)
+			if (!(*it)->predecl) (*it)->generated = true;
+		for (auto it = enums_.vec.begin(); it != enums_.vec.end(); ++it)
+			(*it)->generated = true;
+	}
+	while (token_ != kTokenEof) {
+		if (token_ == kTokenNameSpace) {
+			Next();
+			name_space_.clear();
+			for (;;) {
+				name_space_.push_back(attribute_);
 				Expect(kTokenIdentifier);
-				Expect(';');
-				if (!SetMainType(Main.c_str()))
-					Error("Unknown main type: " + Main);
-				if (main_struct_def->fixed)
-					Error("Main type must be a info");
-			} else {
-				ParseDecl();
+				if (!IsNext('.')) break;
 			}
+			Expect(';');
+		} else if (token_ == '{') {
+			if (!main_struct_def) Error("No main type set to parse json with");
+			if (builder_.GetSize()) {
+				Error("Cannot have more than one json object in a file");
+			}
+			builder_.Finish(Offset<Info>(ParseInfo(*main_struct_def)));
+		} else if (token_ == kTokenEnum) {
+			ParseEnum(false);
+		} else if (token_ == kTokenUnion) {
+			ParseEnum(true);
+		} else if (token_ == kTokenMainType) {
+			Next();
+			auto Main = attribute_;
+			Expect(kTokenIdentifier);
+			Expect(';');
+			if (!SetMainType(Main.c_str()))
+				Error("Unknown main type: " + Main);
+			if (main_struct_def->fixed)
+				Error("Main type must be a info");
+		} else {
+			ParseDecl();
 		}
-		for (auto it = structs_.vec.begin(); it != structs_.vec.end(); ++it) {
-			if ((*it)->predecl)
-				Error("Type referenced but not defined: " + (*it)->name);
-		}
-		for (auto it = enums_.vec.begin(); it != enums_.vec.end(); ++it) {
-			auto &enum_def = **it;
-			if (enum_def.is_union) {
-				for (auto it = enum_def.vals.vec.begin();
-					 it != enum_def.vals.vec.end();
-					 ++it) {
-					auto &val = **it;
-					if (val.struct_def && val.struct_def->fixed)
-						Error("Only info can be union elements: " + val.name);
-				}
+	}
+	for (auto it = structs_.vec.begin(); it != structs_.vec.end(); ++it) {
+		if ((*it)->predecl)
+			Error("Type referenced but not defined: " + (*it)->name);
+		auto &fields = (*it)->fields.vec;
+		for (auto field = fields.begin(); field != fields.end(); ++field)
+			if ((*field)->nested && (*field)->nested->fixed)
+				Error("A nested buffer has to have an info as root: " + (*field)->name);
+	}
+	// The generated header refers to the included definitions unqualified,
+	// from within its own namespace.
+	auto &deps = file_dependencies_[file_];
+	for (auto it = deps.begin(); it != deps.end(); ++it)
+		if (parsed_files_.find(*it)->second.name_space != name_space_)
+			Error("Included file has a different namespace: " + *it);
+	for (auto it = enums_.vec.begin(); it != enums_.vec.end(); ++it) {
+		auto &enum_def = **it;
+		if (enum_def.is_union) {
+			for (auto it = enum_def.vals.vec.begin();
+				 it != enum_def.vals.vec.end();
+				 ++it) {
+				auto &val = **it;
+				if (val.struct_def && val.struct_def->fixed)
+					Error("Only info can be union elements: " + val.name);
 			}
 		}
-	} catch (const std::string &msg) {
-		error_ = "Line " + NumToString(line_) + ": " + msg;
-		return false;
 	}
-	assert(!struct_stack_.size());
-	return true;
+	// A file that holds data is parsed for it every time.
+	if (!builder_.GetSize()) {
+		auto &parsed = parsed_files_[file_];
+		parsed.includes = includes;
+		parsed.name_space = name_space_;
+		parsed.main_struct_def = main_struct_def;
+	}
 }
 
 }  // namespace megrez
\ No newline at end of file
@@ -0,0 +1,161 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#ifndef MEGREZ_ALLOCATOR_H_
+#define MEGREZ_ALLOCATOR_H_
+
+#include <assert.h>
+#include <new>
+#include <vector>
+#include "megrez/basic.h"
+#include "megrez/util.h"
+
+namespace megrez {
+
+// The memory source of `vector_downward`. Blocks are always released with
+// the same size they were requested with.
+class Allocator {
+ public:
+	virtual ~Allocator() {}
+	virtual uint8_t *allocate(size_t size) = 0;
+	virtual void deallocate(uint8_t *p, size_t size) = 0;
+};
+
+// What the builder and the native arena allocate with. An allocator that
+// is out of memory (an exhausted `ArenaAllocator`) becomes `std::bad_alloc`,
+// the same failure the default `new[]` reports.
+inline uint8_t *AllocateOrThrow(Allocator *allocator, size_t size) {
+	auto p = allocator->allocate(size);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+// Plain `new[]`/`delete[]`, used when no allocator is given.
+class DefaultAllocator : public Allocator {
+ public:
+	uint8_t *allocate(size_t size) override { return new uint8_t[size]; }
+	void deallocate(uint8_t *p, size_t) override { delete[] p; }
+
+	static DefaultAllocator &instance() {
+		static DefaultAllocator allocator;
+		return allocator;
+	}
+};
+
+// Bump allocator over a caller owned region, it never touches the heap.
+// A block is only given back when it is the last one handed out, and the
+// whole arena is rewound once every block has been released, which covers
+// the allocate-new/free-old pattern of a growing builder.
+// Returns nullptr when the arena is exhausted, a builder using it throws
+// `std::bad_alloc` then.
+class ArenaAllocator : public Allocator {
+ private:
+	uint8_t *begin_;
+	uint8_t *end_;
+	uint8_t *top_;
+	size_t live_;
+
+ public:
+	ArenaAllocator(void *buf, size_t size)
+		: begin_(reinterpret_cast<uint8_t *>(buf)),
+		  end_(begin_ + size),
+		  top_(begin_),
+		  live_(0) {}
+
+	uint8_t *allocate(size_t size) override {
+		auto p = top_ + PaddingBytes(reinterpret_cast<size_t>(top_),
+		                             sizeof(max_scalar_t));
+		if (p > end_ || static_cast<size_t>(end_ - p) < size) return nullptr;
+		top_ = p + size;
+		live_++;
+		return p;
+	}
+
+	void deallocate(uint8_t *p, size_t size) override {
+		if (!p) return;
+		assert(live_ && p >= begin_ && p + size <= end_);
+		if (p + size == top_) top_ = p;
+		if (!--live_) top_ = begin_;
+	}
+
+	size_t used() const { return static_cast<size_t>(top_ - begin_); }
+	size_t capacity() const { return static_cast<size_t>(end_ - begin_); }
+};
+
+// Keeps released blocks in power of two size classes and hands them out
+// again, so short-lived builders reuse warm storage instead of going back
+// to `upstream`. Not thread-safe, see `ThreadLocalPoolAllocator()`.
+class PoolAllocator : public Allocator {
+ private:
+	static const size_t kNumClasses = 24;
+	static const size_t kMinClassSize = 64;
+	std::vector<uint8_t *> free_[kNumClasses];
+	Allocator *upstream_;
+	size_t max_blocks_per_class_;
+
+	static size_t SizeClass(size_t size) {
+		size_t c = 0;
+		while ((kMinClassSize << c) < size) c++;
+		return c;
+	}
+
+ public:
+	explicit PoolAllocator(size_t max_blocks_per_class = 16,
+	                       Allocator *upstream = nullptr)
+		: upstream_(upstream ? upstream : &DefaultAllocator::instance()),
+		  max_blocks_per_class_(max_blocks_per_class) {}
+	PoolAllocator(const PoolAllocator &) = delete;
+	PoolAllocator &operator=(const PoolAllocator &) = delete;
+	~PoolAllocator() { Trim(); }
+
+	uint8_t *allocate(size_t size) override {
+		auto c = SizeClass(size);
+		if (c >= kNumClasses) return upstream_->allocate(size);
+		if (free_[c].size()) {
+			auto p = free_[c].back();
+			free_[c].pop_back();
+			return p;
+		}
+		return upstream_->allocate(kMinClassSize << c);
+	}
+
+	void deallocate(uint8_t *p, size_t size) override {
+		if (!p) return;
+		auto c = SizeClass(size);
+		if (c >= kNumClasses) return upstream_->deallocate(p, size);
+		if (free_[c].size() < max_blocks_per_class_) free_[c].push_back(p);
+		else upstream_->deallocate(p, kMinClassSize << c);
+	}
+
+	// Give all cached blocks back to the upstream allocator.
+	void Trim() {
+		for (size_t c = 0; c < kNumClasses; c++) {
+			for (auto it = free_[c].begin(); it != free_[c].end(); ++it)
+				upstream_->deallocate(*it, kMinClassSize << c);
+			free_[c].clear();
+		}
+	}
+};
+
+// One pool per thread, blocks must be released on the thread that got them.
+inline PoolAllocator &ThreadLocalPoolAllocator() {
+	static thread_local PoolAllocator pool;
+	return pool;
+}
+
+} // namespace megrez
+
+#endif // MEGREZ_ALLOCATOR_H_
@@ -116,6 +116,7 @@ size_t AlignOf() {
 template<typename T> 
 struct IndirectHelper {
 	typedef T return_type;
+	static const size_t element_stride = sizeof(T);
 	static return_type Read(const uint8_t *p, uofs_t i) {
 		return EndianScalar((reinterpret_cast<const T *>(p))[i]);
 	}
@@ -124,6 +125,7 @@ struct IndirectHelper {
 template<typename T> 
 struct IndirectHelper<Offset<T>> {
 	typedef const T *return_type;
+	static const size_t element_stride = sizeof(uofs_t);
 	static return_type Read(const uint8_t *p, uofs_t i) {
 		p += i * sizeof(uofs_t);
 		return EndianScalar(reinterpret_cast<return_type>(
@@ -134,6 +136,7 @@ struct IndirectHelper<Offset<T>> {
 template<typename T> 
 struct IndirectHelper<const T *> {
 	typedef const T &return_type;
+	static const size_t element_stride = sizeof(T);
 	static return_type Read(const uint8_t *p, uofs_t i) {
 		return *reinterpret_cast<const T *>(p + i * sizeof(T));
 	}
@@ -18,8 +18,11 @@ limitations under the License.
 #define MEGREZ_BUILDER_H_
 
 #include <assert.h>
+#include <iterator>
+#include <limits>
 #include <vector>
 #include <type_traits>
+#include "megrez/hash.h"
 #include "megrez/vector.h"
 #include "megrez/string.h"
 #include "megrez/basic.h"
@@ -27,6 +30,37 @@ limitations under the License.
 
 namespace megrez {
 
+// Worst case space the builder takes for each kind of object, alignment
+// padding included. Their sum is never smaller than the finished buffer,
+// so `Reserve()` with it builds without a single regrowth. The generated
+// `Create<Info>SizeUpperBound()` and `<Info>T::SerializedSizeUpperBound()`
+// cover infos.
+constexpr size_t StringSizeUpperBound(size_t len) {
+	return len + 1 + 2 * sizeof(uofs_t) - 1;
+}
+
+constexpr size_t VectorSizeUpperBound(size_t len, size_t elemsize, size_t alignment) {
+	return len * elemsize + alignment - 1 + 2 * sizeof(uofs_t) - 1;
+}
+
+// For vectors of scalars, offsets and structs, made with `CreateVector()`
+// or `CreateVectorOfStructs()`.
+template<typename T>
+constexpr size_t VectorSizeUpperBound(size_t len) {
+	return VectorSizeUpperBound(len, sizeof(T), alignof(T));
+}
+
+// `field_bytes` is the sum of the field sizes plus their alignment minus
+// one each, `numfields` counts deprecated fields too.
+constexpr size_t InfoSizeUpperBound(size_t numfields, size_t field_bytes) {
+	return field_bytes + 2 * sizeof(uofs_t) - 1 + (numfields + 2) * sizeof(vofs_t);
+}
+
+// The root offset and size prefix of `Finish()`/`FinishSizePrefixed()`.
+constexpr size_t RootSizeUpperBound(size_t minalign = sizeof(max_scalar_t)) {
+	return 2 * sizeof(uofs_t) + minalign - 1;
+}
+
 class MegrezBuilder {
  private:
 	struct FieldLoc {
@@ -35,16 +69,21 @@ class MegrezBuilder {
 	};
 	vector_downward buf_;
 	std::vector<FieldLoc> offsetbuf_;
-	std::vector<uofs_t> vinfo_;
+	OffsetHashTable vinfo_;
+	size_t vinfo_limit_;
+	OffsetHashTable strings_;
 	size_t minalign_;
 	bool force_defaults_;
 	const char *Megrez_version_string;
 
  public:
-	explicit MegrezBuilder(uofs_t initial_size = 1024)
-		: buf_(initial_size), minalign_(1), force_defaults_(false) {
+	explicit MegrezBuilder(uofs_t initial_size = 1024,
+	                       Allocator *allocator = nullptr)
+		: buf_(initial_size, allocator),
+		  vinfo_limit_(std::numeric_limits<size_t>::max()),
+		  minalign_(1),
+		  force_defaults_(false) {
 		offsetbuf_.reserve(16);
-		vinfo_.reserve(16);
 		EndianCheck();
 		Megrez_version_string =
 			"Megrez "
@@ -56,17 +95,52 @@ class MegrezBuilder {
 	void Clear() {
 		buf_.clear();
 		offsetbuf_.clear();
-		vinfo_.clear();
+		vinfo_.Clear();
+		strings_.Clear();
+		minalign_ = 1;
 	}
 
 	uofs_t GetSize() const { return buf_.size(); }
+	size_t GetMinAlign() const { return minalign_; }
+	// Only the whole buffer when it isn't segmented, see
+	// `GetBufferSegments()`.
 	uint8_t *GetBufferPointer() const { return buf_.data(); }
+
+	// Build into a chain of `segment_size` byte blocks instead of one block
+	// that is copied on every growth; the finished buffer then comes as
+	// segments for scatter-gather output. Call on an empty builder, 0 goes
+	// back to contiguous. `Release()` and `CreateVectorOfSortedInfos()`,
+	// which read it back in place, copy a segmented buffer into one block
+	// first.
+	void SetSegmentSize(uofs_t segment_size) { buf_.set_segment_size(segment_size); }
+	bool IsSegmented() const { return buf_.segmented(); }
+	void GetBufferSegments(std::vector<BufferSegment> *segments) const {
+		buf_.segments(segments);
+	}
+	Allocator *GetAllocator() const { return buf_.allocator(); }
+#ifdef MEGREZ_BUILDER_STATS
+	// Counted since construction or `ResetStats()`, `Clear()` keeps them
+	// so they can cover many messages of a reused builder.
+	BuilderStats GetStats() const { return buf_.stats(); }
+	void ResetStats() { buf_.reset_stats(); }
+#endif
 	const char *GetVersionString() { return Megrez_version_string; }
 	void ForceDefaults(bool fd) { force_defaults_ = fd; }
-	void Pad(size_t num_bytes) { buf_.fill(num_bytes); }
+	// At most `limit` distinct vtables are remembered for deduplication,
+	// 0 turns it off. Trades buffer size for build latency.
+	void SetVTableDedupLimit(size_t limit) { vinfo_limit_ = limit; }
+	// Makes room for `len` more bytes up front, so a message whose size is
+	// known (see the `SizeUpperBound` helpers) is built without regrowing.
+	void Reserve(size_t len) { buf_.reserve(len); }
+	void Pad(size_t num_bytes) {
+		MEGREZ_STATS(buf_.mutable_stats().padding_bytes += num_bytes);
+		buf_.fill(num_bytes);
+	}
 	void Align(size_t elem_size) {
 		if (elem_size > minalign_) minalign_ = elem_size;
-		buf_.fill(PaddingBytes(buf_.size(), elem_size));
+		auto padding = PaddingBytes(buf_.size(), elem_size);
+		MEGREZ_STATS(buf_.mutable_stats().padding_bytes += padding);
+		buf_.fill(padding);
 	}
 
 	void PushBytes(const uint8_t *bytes, size_t size) { buf_.push(bytes, size); }
@@ -84,7 +158,7 @@ class MegrezBuilder {
 		AssertScalarT<T>();
 		T litle_endian_element = EndianScalar(element);
 		Align(sizeof(T));
-		PushBytes(reinterpret_cast<uint8_t *>(&litle_endian_element), sizeof(T));
+		buf_.push_small(litle_endian_element);
 		return GetSize();
 	}
 
@@ -136,11 +210,15 @@ class MegrezBuilder {
 
 	uofs_t EndInfo(uofs_t start, vofs_t numfields) {
 		auto vInfoOffsetloc = PushElement<uofs_t>(0);
-		buf_.fill(numfields * sizeof(vofs_t));
 		auto info_object_size = vInfoOffsetloc - start;
 		assert(info_object_size < 0x10000);
-		PushElement<vofs_t>(info_object_size);
-		PushElement<vofs_t>(FieldIndexToOffset(numfields));
+		// The vtable goes in with one `make_space()`, so it is contiguous
+		// even in a segmented buffer.
+		auto vtsize = FieldIndexToOffset(numfields);
+		auto vt = buf_.make_space(vtsize);
+		memset(vt, 0, vtsize);
+		WriteScalar<vofs_t>(vt, vtsize);
+		WriteScalar<vofs_t>(vt + sizeof(vofs_t), static_cast<vofs_t>(info_object_size));
 		for (auto field_location = offsetbuf_.begin();
 							field_location != offsetbuf_.end();
 						++field_location) {
@@ -149,18 +227,26 @@ class MegrezBuilder {
 			WriteScalar<vofs_t>(buf_.data() + field_location->id, pos);
 		}
 		offsetbuf_.clear();
-		auto vt1 = reinterpret_cast<vofs_t *>(buf_.data());
-		auto vt1_size = *vt1;
+		auto vt1 = buf_.data();
+		auto vt1_size = ReadScalar<vofs_t>(vt1);
 		auto vt_use = GetSize();
-		for (auto it = vinfo_.begin(); it != vinfo_.end(); ++it) {
-			if (memcmp(buf_.data_at(*it), vt1, vt1_size)) continue;
-			vt_use = *it;
-			buf_.pop(GetSize() - vInfoOffsetloc);
-			break;
-		}
-		if (vt_use == GetSize()) {
-			vinfo_.push_back(vt_use);
+		if (vinfo_limit_) {
+			auto hash = HashBytes(vt1, vt1_size);
+			auto existing = vinfo_.Find(hash, [&](uofs_t off) {
+				auto vt2 = buf_.data_at(off);
+				return ReadScalar<vofs_t>(vt2) == vt1_size &&
+				       !memcmp(vt2, vt1, vt1_size);
+			});
+			if (existing) {
+				vt_use = existing;
+				buf_.pop(GetSize() - vInfoOffsetloc);
+			} else if (vinfo_.size() < vinfo_limit_) {
+				vinfo_.Insert(hash, vt_use);
+			}
 		}
+		MEGREZ_STATS(vt_use == GetSize()
+			? buf_.mutable_stats().vtables_written++
+			: buf_.mutable_stats().vtables_deduplicated++);
 		WriteScalar(buf_.data_at(vInfoOffsetloc),
 								static_cast<sofs_t>(vt_use) -
 									static_cast<sofs_t>(vInfoOffsetloc));
@@ -175,7 +261,10 @@ class MegrezBuilder {
 	uofs_t EndStruct() { return GetSize(); }
 	void ClearOffsets() { offsetbuf_.clear(); }
 	void PreAlign(size_t len, size_t alignment) {
-		buf_.fill(PaddingBytes(GetSize() + len, alignment));
+		if (alignment > minalign_) minalign_ = alignment;
+		auto padding = PaddingBytes(GetSize() + len, alignment);
+		MEGREZ_STATS(buf_.mutable_stats().padding_bytes += padding);
+		buf_.fill(padding);
 	}
 	template<typename T> void PreAlign(size_t len) {
 		AssertScalarT<T>();
@@ -193,6 +282,41 @@ class MegrezBuilder {
 
 	Offset<String> CreateString(const char *str) { return CreateString(str, strlen(str)); }
 	Offset<String> CreateString(const std::string &str) { return CreateString(str.c_str(), str.length()); }
+	Offset<String> CreateString(const StringRef &str) {
+		return str.data() ? CreateString(str.data(), str.size()) : Offset<String>();
+	}
+
+	// Like `CreateString()`, but a value already written through here is
+	// not written again, its first offset is returned. Fields marked
+	// `(shared)` in the schema are built with it.
+	Offset<String> CreateSharedString(const char *str, size_t len) {
+		NotNested();
+		auto hash = HashBytes(reinterpret_cast<const uint8_t *>(str), len);
+		auto existing = strings_.Find(hash, [&](uofs_t off) {
+			auto s = buf_.data_at(off);
+			return ReadScalar<uofs_t>(s) == len && !memcmp(s + sizeof(uofs_t), str, len);
+		});
+		if (existing) {
+			MEGREZ_STATS(buf_.mutable_stats().strings_shared++);
+			return Offset<String>(existing);
+		}
+		// In one piece, so it can be compared even in a segmented buffer.
+		PreAlign<uofs_t>(len + 1);
+		auto s = buf_.make_space(static_cast<uofs_t>(sizeof(uofs_t) + len + 1));
+		WriteScalar(s, static_cast<uofs_t>(len));
+		memcpy(s + sizeof(uofs_t), str, len);
+		s[sizeof(uofs_t) + len] = 0;
+		strings_.Insert(hash, GetSize());
+		return Offset<String>(GetSize());
+	}
+
+	Offset<String> CreateSharedString(const char *str) { return CreateSharedString(str, strlen(str)); }
+	Offset<String> CreateSharedString(const std::string &str) {
+		return CreateSharedString(str.c_str(), str.length());
+	}
+	Offset<String> CreateSharedString(const StringRef &str) {
+		return str.data() ? CreateSharedString(str.data(), str.size()) : Offset<String>();
+	}
 
 	uofs_t EndVector(size_t len) {
 		return PushElement(static_cast<uofs_t>(len));
@@ -207,39 +331,183 @@ class MegrezBuilder {
 		return buf_.make_space(len * elemsize);
 	}
 
+	// Scalars are already laid out the way the wire wants them on little
+	// endian hosts, so the whole array goes in with one copy.
+	template<typename T> 
+	void PushElements(const T *v, size_t len, std::true_type) {
+		if (!len) return;
+		#if MEGREZ_LITTLEENDIAN
+			PushBytes(reinterpret_cast<const uint8_t *>(v), len * sizeof(T));
+		#else
+			auto dest = reinterpret_cast<T *>(ReserveElements(len, sizeof(T)));
+			for (size_t i = 0; i < len; i++) dest[i] = EndianScalar(v[i]);
+		#endif
+	}
+
+	// Offsets are relative to where they end up, so they go one by one.
+	template<typename T> 
+	void PushElements(const T *v, size_t len, std::false_type) {
+		for (auto i = len; i;) PushElement(v[--i]);
+	}
+
 	template<typename T> 
 	Offset<Vector<T>> CreateVector(const T *v, size_t len) {
 		NotNested();
 		StartVector(len, sizeof(T));
-		auto i = len;
-		do {
-			PushElement(v[--i]);
-		} while (i);
+		PushElements(v, len, std::is_scalar<T>());
 		return Offset<Vector<T>>(EndVector(len));
 	}
 
 	template<typename T> 
 	Offset<Vector<T>> CreateVector(const std::vector<T> &v){
-		return CreateVector(&v[0], v.size());
+		return CreateVector(v.data(), v.size());
+	}
+
+	// A finished buffer copied in as the bytes of a `(nested)` field, they
+	// start `alignment` aligned so its root can be read in place.
+	Offset<Vector<uint8_t>> CreateNestedBuffer(const uint8_t *buf, size_t len,
+	                                           size_t alignment = sizeof(max_scalar_t)) {
+		NotNested();
+		StartVector(len, 1);
+		PreAlign(len, alignment);
+		PushBytes(buf, len);
+		return Offset<Vector<uint8_t>>(EndVector(len));
+	}
+
+	// The contiguous buffer `nested` finished.
+	Offset<Vector<uint8_t>> CreateNestedBuffer(const MegrezBuilder &nested) {
+		return CreateNestedBuffer(nested.GetBufferPointer(), nested.GetSize(),
+		                          nested.GetMinAlign());
+	}
+
+	// Reserve room for `len` elements without writing them, `*buf` points at
+	// the first one afterwards and stays valid until the builder grows.
+	uofs_t CreateUninitializedVector(size_t len, size_t elemsize, uint8_t **buf) {
+		NotNested();
+		StartVector(len, elemsize);
+		ReserveElements(len, elemsize);
+		auto vec_start = GetSize();
+		auto vec_end = EndVector(len);
+		*buf = buf_.data_at(vec_start);
+		return vec_end;
+	}
+
+	template<typename T> 
+	Offset<Vector<T>> CreateUninitializedVector(size_t len, T **buf) {
+		AssertScalarT<T>();
+		return Offset<Vector<T>>(CreateUninitializedVector(
+			len, sizeof(T), reinterpret_cast<uint8_t **>(buf)));
+	}
+
+	template<typename T, typename F> 
+	Offset<Vector<T>> CreateVectorFrom(size_t len, F &f, std::true_type) {
+		T *dest;
+		auto vec = CreateUninitializedVector(len, &dest);
+		for (size_t i = 0; i < len; i++) WriteScalar(dest + i, static_cast<T>(f(i)));
+		return vec;
+	}
+
+	template<typename T, typename F> 
+	Offset<Vector<T>> CreateVectorFrom(size_t len, F &f, std::false_type) {
+		std::vector<T> elems;
+		elems.reserve(len);
+		for (size_t i = 0; i < len; i++) elems.push_back(f(i));
+		return CreateVector(elems);
+	}
+
+	// Element `i` is `f(i)`, `f` is called for every index in increasing
+	// order. Scalars are written straight into the buffer; offsets have to
+	// be collected first, since `f` builds their targets.
+	template<typename F> 
+	auto CreateVector(size_t len, F f) -> Offset<Vector<decltype(f(len))>> {
+		typedef decltype(f(len)) T;
+		return CreateVectorFrom<T>(len, f, std::is_scalar<T>());
+	}
+
+	template<typename It> 
+	auto CreateVector(It first, It last)
+			-> Offset<Vector<typename std::iterator_traits<It>::value_type>> {
+		auto len = static_cast<size_t>(std::distance(first, last));
+		return CreateVector(len, [&](size_t) { return *first++; });
 	}
 
 	template<typename T> 
 	Offset<Vector<const T *>> CreateVectorOfStructs(const T *v, size_t len) {
 		NotNested();
-		StartVector(len, AlignOf<T>());
+		StartVector(len * sizeof(T) / AlignOf<T>(), AlignOf<T>());
 		PushBytes(reinterpret_cast<const uint8_t *>(v), sizeof(T) * len);
 		return Offset<Vector<const T *>>(EndVector(len));
 	}
 
 	template<typename T> 
 	Offset<Vector<const T *>> CreateVectorOfStructs(const std::vector<T> &v) {
-		return CreateVector(&v[0], v.size());
+		return CreateVectorOfStructs(v.data(), v.size());
+	}
+	// Appends everything `sub` has built (it must not be finished) to this
+	// builder. References inside `sub` are relative, so the bytes are
+	// copied as they are, aligned the way `sub` needs. Returns the base to
+	// add to offsets from `sub`, see the typed overload.
+	uofs_t Splice(const MegrezBuilder &sub) {
+		NotNested();
+		Align(sub.GetMinAlign());
+		auto base = GetSize();
+		std::vector<BufferSegment> segments;
+		sub.GetBufferSegments(&segments);
+		for (auto it = segments.rbegin(); it != segments.rend(); ++it)
+			PushBytes(it->data, it->size);
+		return base;
+	}
+
+	// Splices `sub` and returns where its object `off` ended up.
+	template<typename T>
+	Offset<T> Splice(const MegrezBuilder &sub, Offset<T> off) {
+		return Offset<T>(Splice(sub) + off.o);
+	}
+
+	// Sorts `v` by the `(key)` field of `T` and writes it out, so the
+	// vector can be searched with `Vector::LookupByKey()`. The infos must
+	// have been written to this builder. An info can refer to other
+	// segments, a segmented buffer is flattened first.
+	template<typename T>
+	Offset<Vector<Offset<T>>> CreateVectorOfSortedInfos(Offset<T> *v, size_t len) {
+		buf_.flatten();
+		std::sort(v, v + len, [this](const Offset<T> &a, const Offset<T> &b) {
+			auto info_a = reinterpret_cast<const T *>(buf_.data_at(a.o));
+			auto info_b = reinterpret_cast<const T *>(buf_.data_at(b.o));
+			return info_a->KeyCompareLessThan(info_b);
+		});
+		return CreateVector(v, len);
+	}
+
+	template<typename T>
+	Offset<Vector<Offset<T>>> CreateVectorOfSortedInfos(std::vector<Offset<T>> *v) {
+		return CreateVectorOfSortedInfos(v->data(), v->size());
 	}
+
 	template<typename T> 
 	void Finish(Offset<T> root) {
 		PreAlign(sizeof(uofs_t), minalign_);
 		PushElement(ReferTo(root.o));
 	}
+
+	// Like `Finish()`, but the buffer starts with its own size (not counting
+	// the prefix) so buffers can be stored back to back in a stream. The
+	// total is padded to a multiple of `max_scalar_t`, which keeps every
+	// frame of such a stream aligned, read it with `GetSizePrefixedRoot()`.
+	template<typename T> 
+	void FinishSizePrefixed(Offset<T> root) {
+		PreAlign(2 * sizeof(uofs_t), std::max(minalign_, sizeof(max_scalar_t)));
+		PushElement(ReferTo(root.o));
+		PushElement(GetSize());
+	}
+
+	// Move the finished buffer out without copying it, the builder is left
+	// cleared on a fresh block from its allocator.
+	DetachedBuffer Release() {
+		auto detached = buf_.release();
+		Clear();
+		return detached;
+	}
 };
 
 } // namespace megrez
@@ -0,0 +1,153 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#ifndef MEGREZ_COMPACT_H_
+#define MEGREZ_COMPACT_H_
+
+#include <type_traits>
+#include <vector>
+#include "megrez/basic.h"
+#include "megrez/builder.h"
+#include "megrez/vector.h"
+
+// Integer vectors declared `(compact)` are stored as a `[ubyte]` holding
+// a varint count followed by one varint per element: the zigzag coded
+// difference to the previous element. Sorted ids, timestamps and small
+// counters mostly take one byte per element instead of four or eight.
+
+namespace megrez {
+
+inline size_t VarintSize(uint64_t v) {
+	size_t n = 1;
+	while (v >= 0x80) { v >>= 7; n++; }
+	return n;
+}
+
+inline uint8_t *WriteVarint(uint8_t *p, uint64_t v) {
+	while (v >= 0x80) {
+		*p++ = static_cast<uint8_t>(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = static_cast<uint8_t>(v);
+	return p;
+}
+
+// Fails instead of reading past `end` or beyond 10 bytes.
+inline bool ReadVarint(const uint8_t *&p, const uint8_t *end, uint64_t *v) {
+	uint64_t result = 0;
+	for (int shift = 0; shift < 64 && p < end; shift += 7) {
+		auto b = *p++;
+		result |= static_cast<uint64_t>(b & 0x7F) << shift;
+		if (!(b & 0x80)) {
+			*v = result;
+			return true;
+		}
+	}
+	return false;
+}
+
+inline uint64_t ZigZagEncode(uint64_t delta) {
+	return (delta << 1) ^ (0 - (delta >> 63));
+}
+
+inline uint64_t ZigZagDecode(uint64_t z) {
+	return (z >> 1) ^ (0 - (z & 1));
+}
+
+// Sign or zero extends `v`, the codec works in 64 bit modular arithmetic
+// so every integer type round trips exactly.
+template<typename T>
+uint64_t WidenInteger(T v) {
+	typedef typename std::conditional<std::is_signed<T>::value,
+	                                  int64_t, uint64_t>::type wide;
+	return static_cast<uint64_t>(static_cast<wide>(v));
+}
+
+template<typename T>
+class CompactVector : public Vector<uint8_t> {
+ public:
+	// Number of elements, 0 for a malformed vector. Never more than its
+	// byte length, so it is safe to size an output with.
+	uofs_t Count() const {
+		auto p = Data();
+		uint64_t count;
+		if (!ReadVarint(p, Data() + Vector<uint8_t>::Length(), &count)) return 0;
+		auto left = static_cast<uint64_t>(Data() + Vector<uint8_t>::Length() - p);
+		return count <= left ? static_cast<uofs_t>(count) : 0;
+	}
+
+	// Calls `f(element)` in order. Returns false, after the elements that
+	// could be decoded, when the data is malformed.
+	template<typename F>
+	bool ForEach(F f) const {
+		auto p = Data();
+		auto end = p + Vector<uint8_t>::Length();
+		uint64_t count;
+		if (!ReadVarint(p, end, &count)) return false;
+		uint64_t acc = 0;
+		for (uint64_t i = 0; i < count; i++) {
+			uint64_t z;
+			// Single byte deltas are the common case.
+			if (p < end && !(*p & 0x80)) z = *p++;
+			else if (!ReadVarint(p, end, &z)) return false;
+			acc += ZigZagDecode(z);
+			f(static_cast<T>(acc));
+		}
+		return true;
+	}
+
+	// `out` needs room for `Count()` elements.
+	bool Decode(T *out) const {
+		return ForEach([&out](T v) { *out++ = v; });
+	}
+};
+
+// Worst case size of `CreateCompactVector()` for `len` elements.
+constexpr size_t CompactVectorSizeUpperBound(size_t len) {
+	return VectorSizeUpperBound((len + 1) * 10, 1, 1);
+}
+
+// Measures the encoding first, then writes it straight into the buffer.
+template<typename T>
+Offset<CompactVector<T>> CreateCompactVector(MegrezBuilder &mb, const T *v, size_t len) {
+	static_assert(std::is_integral<T>::value, "compact vectors hold integers");
+	auto size = VarintSize(len);
+	uint64_t prev = 0;
+	for (size_t i = 0; i < len; i++) {
+		auto cur = WidenInteger(v[i]);
+		size += VarintSize(ZigZagEncode(cur - prev));
+		prev = cur;
+	}
+	uint8_t *p;
+	auto vec = mb.CreateUninitializedVector(size, 1, &p);
+	p = WriteVarint(p, len);
+	prev = 0;
+	for (size_t i = 0; i < len; i++) {
+		auto cur = WidenInteger(v[i]);
+		p = WriteVarint(p, ZigZagEncode(cur - prev));
+		prev = cur;
+	}
+	return Offset<CompactVector<T>>(vec);
+}
+
+template<typename T, typename A>
+Offset<CompactVector<T>> CreateCompactVector(MegrezBuilder &mb, const std::vector<T, A> &v) {
+	return CreateCompactVector(mb, v.data(), v.size());
+}
+
+} // namespace megrez
+
+#endif // MEGREZ_COMPACT_H_
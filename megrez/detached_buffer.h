@@ -0,0 +1,119 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#ifndef MEGREZ_DETACHED_BUFFER_H_
+#define MEGREZ_DETACHED_BUFFER_H_
+
+#include "megrez/basic.h"
+#include "megrez/allocator.h"
+
+namespace megrez {
+
+// A finished buffer moved out of a builder. It owns the whole block it
+// was built in and frees it through its deleter, so it can be queued or
+// handed to the I/O layer without copying the bytes.
+class DetachedBuffer {
+ public:
+	typedef void (*Deleter)(void *context, uint8_t *block, size_t block_size);
+
+ private:
+	Deleter deleter_;
+	void *context_;
+	uint8_t *block_;
+	size_t block_size_;
+	uint8_t *data_;
+	size_t size_;
+
+	static void DeallocateWith(void *allocator, uint8_t *block, size_t block_size) {
+		static_cast<Allocator *>(allocator)->deallocate(block, block_size);
+	}
+
+	void Destroy() {
+		if (block_ && deleter_) deleter_(context_, block_, block_size_);
+		Forget();
+	}
+
+	void Forget() {
+		deleter_ = nullptr;
+		context_ = nullptr;
+		block_ = nullptr;
+		block_size_ = 0;
+		data_ = nullptr;
+		size_ = 0;
+	}
+
+ public:
+	DetachedBuffer()
+		: deleter_(nullptr), context_(nullptr), block_(nullptr),
+		  block_size_(0), data_(nullptr), size_(0) {}
+
+	// `block` came from `allocator`, the message is `[data, data + size)`.
+	DetachedBuffer(Allocator *allocator, uint8_t *block, size_t block_size,
+	               uint8_t *data, size_t size)
+		: deleter_(DeallocateWith), context_(allocator), block_(block),
+		  block_size_(block_size), data_(data), size_(size) {}
+
+	// `deleter(context, block, block_size)` runs once the buffer is dropped.
+	DetachedBuffer(Deleter deleter, void *context, uint8_t *block,
+	               size_t block_size, uint8_t *data, size_t size)
+		: deleter_(deleter), context_(context), block_(block),
+		  block_size_(block_size), data_(data), size_(size) {}
+
+	DetachedBuffer(DetachedBuffer &&other)
+		: deleter_(other.deleter_), context_(other.context_),
+		  block_(other.block_), block_size_(other.block_size_),
+		  data_(other.data_), size_(other.size_) {
+		other.Forget();
+	}
+
+	DetachedBuffer &operator=(DetachedBuffer &&other) {
+		if (this == &other) return *this;
+		Destroy();
+		deleter_ = other.deleter_;
+		context_ = other.context_;
+		block_ = other.block_;
+		block_size_ = other.block_size_;
+		data_ = other.data_;
+		size_ = other.size_;
+		other.Forget();
+		return *this;
+	}
+
+	DetachedBuffer(const DetachedBuffer &) = delete;
+	DetachedBuffer &operator=(const DetachedBuffer &) = delete;
+	~DetachedBuffer() { Destroy(); }
+
+	const uint8_t *data() const { return data_; }
+	uint8_t *data() { return data_; }
+	size_t size() const { return size_; }
+	bool empty() const { return !size_; }
+
+	// Give up ownership, the caller now has to pass `block`/`block_size`
+	// to the deleter (or the allocator) it was built with.
+	uint8_t *ReleaseRaw(size_t *block_size, size_t *data_offset) {
+		auto block = block_;
+		*block_size = block_size_;
+		*data_offset = static_cast<size_t>(data_ - block_);
+		Forget();
+		return block;
+	}
+
+	void Reset() { Destroy(); }
+};
+
+} // namespace megrez
+
+#endif // MEGREZ_DETACHED_BUFFER_H_
@@ -0,0 +1,102 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#ifndef MEGREZ_HASH_H_
+#define MEGREZ_HASH_H_
+
+#include <assert.h>
+#include <vector>
+#include "megrez/basic.h"
+
+namespace megrez {
+
+// FNV-1a, good enough for the short keys (vtables, strings) we index.
+inline uint32_t HashBytes(const uint8_t *bytes, size_t len) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Open addressing set of buffer offsets, keyed by a hash of whatever the
+// offset refers to. The caller decides equality, since only it knows how
+// to read the bytes behind an offset. Offset 0 marks an empty slot, which
+// is never a valid object position in a builder.
+// `Clear()` keeps the slots, so a builder reused for the same kind of
+// message does not grow the table again.
+class OffsetHashTable {
+ private:
+	struct Slot {
+		uint32_t hash;
+		uofs_t off;
+	};
+	std::vector<Slot> slots_;
+	size_t count_;
+
+	void Grow() {
+		std::vector<Slot> old;
+		old.swap(slots_);
+		slots_.resize(old.size() ? old.size() * 2 : 16);
+		for (auto it = slots_.begin(); it != slots_.end(); ++it) it->off = 0;
+		for (auto it = old.begin(); it != old.end(); ++it)
+			if (it->off) Place(*it);
+	}
+
+	void Place(const Slot &slot) {
+		auto mask = slots_.size() - 1;
+		auto i = slot.hash & mask;
+		while (slots_[i].off) i = (i + 1) & mask;
+		slots_[i] = slot;
+	}
+
+ public:
+	OffsetHashTable() : count_(0) {}
+
+	// Returns the first offset with `hash` for which `equal(off)` holds,
+	// or 0 if there is none.
+	template<typename Eq> 
+	uofs_t Find(uint32_t hash, Eq equal) const {
+		if (!count_) return 0;
+		auto mask = slots_.size() - 1;
+		for (auto i = hash & mask; slots_[i].off; i = (i + 1) & mask) {
+			if (slots_[i].hash == hash && equal(slots_[i].off))
+				return slots_[i].off;
+		}
+		return 0;
+	}
+
+	void Insert(uint32_t hash, uofs_t off) {
+		assert(off);
+		if ((count_ + 1) * 2 > slots_.size()) Grow();
+		Slot slot = { hash, off };
+		Place(slot);
+		count_++;
+	}
+
+	void Clear() {
+		if (!count_) return;
+		for (auto it = slots_.begin(); it != slots_.end(); ++it) it->off = 0;
+		count_ = 0;
+	}
+
+	size_t size() const { return count_; }
+};
+
+} // namespace megrez
+
+#endif // MEGREZ_HASH_H_
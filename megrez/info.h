@@ -18,6 +18,7 @@ limitations under the License.
 #define MEGREZ_INFO_H_
 
 #include "megrez/basic.h"
+#include "megrez/verifier.h"
 
 namespace megrez {
 
@@ -55,16 +56,97 @@ class Info {
 		return field_offset ? reinterpret_cast<P>(&data_[field_offset]) : nullptr;
 	}
 
+	// Overwrites a field in place, fields that weren't written (or equaled
+	// their default when written) have no storage, so this returns false.
 	template<typename T> 
-	void SetField(vofs_t field, T val) {
+	bool SetField(vofs_t field, T val) {
 		auto field_offset = GetOptionalFieldOffset(field);
-		assert(field_offset);
+		if (!field_offset) return false;
 		WriteScalar(&data_[field_offset], val);
+		return true;
+	}
+
+	template<typename T> 
+	T *GetMutablePointer(vofs_t field) {
+		return const_cast<T *>(GetPointer<const T *>(field));
+	}
+
+	template<typename T> 
+	T *GetMutableStruct(vofs_t field) {
+		return const_cast<T *>(GetStruct<const T *>(field));
 	}
 
 	bool CheckField(vofs_t field) const {
 		return GetOptionalFieldOffset(field) != 0;
 	}
+
+	// Verification helpers for the generated `Verify()`, a missing field
+	// always passes.
+	bool VerifyInfoStart(Verifier &verifier) const {
+		return verifier.VerifyInfoStart(data_);
+	}
+
+	template<typename T> 
+	bool VerifyField(const Verifier &verifier, vofs_t field) const {
+		auto field_offset = GetOptionalFieldOffset(field);
+		return !field_offset || verifier.VerifyField<T>(data_ + field_offset);
+	}
+
+	bool VerifyOffset(const Verifier &verifier, vofs_t field) const {
+		auto field_offset = GetOptionalFieldOffset(field);
+		return !field_offset || verifier.VerifyOffset(data_ + field_offset);
+	}
+};
+
+// Read side cache for the vtable of an info with `N` fields. `Reset()`
+// resolves the vtable into a flat offset array, so every field read after
+// it is a single load. Moving to an info with the same vtable (the builder
+// shares identical ones, e.g. across a vector of similar infos) skips the
+// resolve. The generated `<Info>View` types derive from this.
+template<int N>
+class InfoView {
+ private:
+	const uint8_t *info_;
+	const uint8_t *vtable_;
+	vofs_t offsets_[N ? N : 1];
+
+ public:
+	explicit InfoView(const void *info = nullptr) : info_(nullptr), vtable_(nullptr) {
+		Reset(info);
+	}
+
+	void Reset(const void *info) {
+		info_ = reinterpret_cast<const uint8_t *>(info);
+		auto vtable = info_ ? info_ - ReadScalar<sofs_t>(info_) : nullptr;
+		if (vtable == vtable_ && vtable) return;
+		vtable_ = vtable;
+		auto vtsize = vtable ? ReadScalar<vofs_t>(vtable) : 0;
+		for (int i = 0; i < N; i++) {
+			auto field = static_cast<vofs_t>((i + 2) * sizeof(vofs_t));
+			offsets_[i] = field < vtsize ? ReadScalar<vofs_t>(vtable + field) : 0;
+		}
+	}
+
+	const void *info() const { return info_; }
+
+	template<typename T>
+	T GetField(int i, T defaultval) const {
+		return offsets_[i] ? ReadScalar<T>(info_ + offsets_[i]) : defaultval;
+	}
+
+	template<typename P>
+	P GetPointer(int i) const {
+		if (!offsets_[i]) return nullptr;
+		auto p = info_ + offsets_[i];
+		return reinterpret_cast<P>(p + ReadScalar<uofs_t>(p));
+	}
+
+	template<typename P>
+	P GetStruct(int i) const {
+		return offsets_[i] ? reinterpret_cast<P>(info_ + offsets_[i]) : nullptr;
+	}
+
+	bool CheckField(int i) const { return offsets_[i] != 0; }
 };
 
 } // namespace megrez
@@ -0,0 +1,174 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#ifndef MEGREZ_MMAP_H_
+#define MEGREZ_MMAP_H_
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	// Or the min/max macros break std::min and std::max.
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+#include <utility>
+#include "megrez/basic.h"
+#include "megrez/util.h"
+#include "megrez/verifier.h"
+
+namespace megrez {
+
+// A read-only view of a whole file, mapped instead of read, so a large
+// buffer is paged in on demand and its pages are shared by every process
+// mapping the same file.
+class MappedFile {
+ public:
+	enum Access {
+		kAccessNormal,
+		kAccessSequential,  // Read ahead aggressively.
+		kAccessRandom,      // Don't read ahead.
+		kAccessWillNeed     // Start paging everything in now.
+	};
+
+ private:
+	#ifdef _WIN32
+		HANDLE file_;
+		HANDLE mapping_;
+	#else
+		int fd_;
+	#endif
+	const uint8_t *data_;
+	size_t size_;
+
+	void Forget() {
+		#ifdef _WIN32
+			file_ = INVALID_HANDLE_VALUE;
+			mapping_ = nullptr;
+		#else
+			fd_ = -1;
+		#endif
+		data_ = nullptr;
+		size_ = 0;
+	}
+
+ public:
+	MappedFile() { Forget(); }
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	MappedFile(MappedFile &&other) {
+		Forget();
+		*this = std::move(other);
+	}
+	MappedFile &operator=(MappedFile &&other) {
+		if (this == &other) return *this;
+		Close();
+		#ifdef _WIN32
+			file_ = other.file_;
+			mapping_ = other.mapping_;
+		#else
+			fd_ = other.fd_;
+		#endif
+		data_ = other.data_;
+		size_ = other.size_;
+		other.Forget();
+		return *this;
+	}
+	~MappedFile() { Close(); }
+
+	bool Open(const char *name, Access hint = kAccessNormal) {
+		Close();
+		#ifdef _WIN32
+			file_ = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, nullptr,
+			                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file_ == INVALID_HANDLE_VALUE) return false;
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(file_, &size) || !size.QuadPart) { Close(); return false; }
+			mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!mapping_) { Close(); return false; }
+			auto p = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+			if (!p) { Close(); return false; }
+			data_ = reinterpret_cast<const uint8_t *>(p);
+			size_ = static_cast<size_t>(size.QuadPart);
+		#else
+			fd_ = open(name, O_RDONLY);
+			if (fd_ < 0) return false;
+			struct stat st;
+			if (fstat(fd_, &st) || st.st_size <= 0) { Close(); return false; }
+			auto p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+			              MAP_SHARED, fd_, 0);
+			if (p == MAP_FAILED) { Close(); return false; }
+			data_ = reinterpret_cast<const uint8_t *>(p);
+			size_ = static_cast<size_t>(st.st_size);
+		#endif
+		Advise(hint);
+		return true;
+	}
+
+	void Close() {
+		#ifdef _WIN32
+			if (data_) UnmapViewOfFile(data_);
+			if (mapping_) CloseHandle(mapping_);
+			if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+		#else
+			if (data_) munmap(const_cast<uint8_t *>(data_), size_);
+			if (fd_ >= 0) close(fd_);
+		#endif
+		Forget();
+	}
+
+	// Only a hint, Windows ignores it.
+	bool Advise(Access hint) {
+		if (!data_) return false;
+		#ifdef _WIN32
+			(void)hint;
+			return true;
+		#else
+			static const int advice[] = {
+				MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED
+			};
+			return !madvise(const_cast<uint8_t *>(data_), size_, advice[hint]);
+		#endif
+	}
+
+	bool is_open() const { return data_ != nullptr; }
+	const uint8_t *data() const { return data_; }
+	size_t size() const { return size_; }
+
+	// The root of the mapped buffer, or nullptr when the file isn't open or
+	// doesn't verify as a `T` buffer. Verification reads every reachable
+	// object once; pass `verify = false` for trusted files to skip it.
+	template<typename T> 
+	const T *GetRoot(bool verify = true) const {
+		if (!data_ || size_ < sizeof(uofs_t)) return nullptr;
+		if (verify) {
+			Verifier verifier(data_, size_);
+			if (!verifier.VerifyBuffer<T>()) return nullptr;
+		}
+		return megrez::GetRoot<T>(data_);
+	}
+};
+
+} // namespace megrez
+
+#endif // MEGREZ_MMAP_H_
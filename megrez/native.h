@@ -0,0 +1,155 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#ifndef MEGREZ_NATIVE_H_
+#define MEGREZ_NATIVE_H_
+
+#include <assert.h>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#include "megrez/allocator.h"
+#include "megrez/builder.h"
+
+// Support for the generated native types (`<Info>T`), the mutable mirrors
+// that `UnPack()` fills from a buffer and `Pack()` serializes again.
+
+namespace megrez {
+
+// Chained bump allocator for native objects. Nothing is freed on its own,
+// `Reset()` (or the destructor) drops all blocks at once, after the
+// objects living in them have been destroyed.
+class NativeArena {
+ private:
+	struct Block {
+		Block *next;
+		size_t size;
+	};
+	static const size_t kHeaderSize =
+		(sizeof(Block) + sizeof(max_scalar_t) - 1) & ~(sizeof(max_scalar_t) - 1);
+	Allocator *allocator_;
+	size_t block_size_;
+	Block *blocks_;
+	uint8_t *cur_;
+	uint8_t *end_;
+
+ public:
+	explicit NativeArena(size_t block_size = 4096, Allocator *allocator = nullptr)
+		: allocator_(allocator ? allocator : &DefaultAllocator::instance()),
+		  block_size_(block_size),
+		  blocks_(nullptr),
+		  cur_(nullptr),
+		  end_(nullptr) {}
+	NativeArena(const NativeArena &) = delete;
+	NativeArena &operator=(const NativeArena &) = delete;
+	~NativeArena() { Reset(); }
+
+	void *allocate(size_t size, size_t alignment) {
+		auto p = cur_ ? cur_ + PaddingBytes(reinterpret_cast<size_t>(cur_), alignment)
+		              : nullptr;
+		if (!p || p > end_ || static_cast<size_t>(end_ - p) < size) {
+			auto block_size = std::max(block_size_, kHeaderSize + size + alignment);
+			auto block = reinterpret_cast<Block *>(AllocateOrThrow(allocator_, block_size));
+			block->next = blocks_;
+			block->size = block_size;
+			blocks_ = block;
+			cur_ = reinterpret_cast<uint8_t *>(block) + kHeaderSize;
+			end_ = reinterpret_cast<uint8_t *>(block) + block_size;
+			p = cur_ + PaddingBytes(reinterpret_cast<size_t>(cur_), alignment);
+		}
+		cur_ = p + size;
+		return p;
+	}
+
+	void Reset() {
+		while (blocks_) {
+			auto next = blocks_->next;
+			allocator_->deallocate(reinterpret_cast<uint8_t *>(blocks_), blocks_->size);
+			blocks_ = next;
+		}
+		cur_ = end_ = nullptr;
+	}
+};
+
+// STL allocator drawing from a `NativeArena`, or the heap without one.
+template<typename T>
+class NativeAllocator {
+ private:
+	NativeArena *arena_;
+
+ public:
+	typedef T value_type;
+
+	NativeAllocator(NativeArena *arena = nullptr) : arena_(arena) {}
+	template<typename U>
+	NativeAllocator(const NativeAllocator<U> &other) : arena_(other.arena()) {}
+
+	T *allocate(size_t n) {
+		return static_cast<T *>(arena_
+			? arena_->allocate(n * sizeof(T), AlignOf<T>())
+			: ::operator new(n * sizeof(T)));
+	}
+	void deallocate(T *p, size_t) { if (!arena_) ::operator delete(p); }
+
+	NativeArena *arena() const { return arena_; }
+	template<typename U>
+	bool operator==(const NativeAllocator<U> &other) const { return arena_ == other.arena(); }
+	template<typename U>
+	bool operator!=(const NativeAllocator<U> &other) const { return arena_ != other.arena(); }
+};
+
+typedef std::basic_string<char, std::char_traits<char>, NativeAllocator<char>> NativeString;
+
+template<typename T>
+using NativeVector = std::vector<T, NativeAllocator<T>>;
+
+// Objects placed in an arena are only destroyed, heap ones are deleted.
+template<typename T>
+class NativeDeleter {
+ private:
+	NativeArena *arena_;
+
+ public:
+	NativeDeleter(NativeArena *arena = nullptr) : arena_(arena) {}
+	void operator()(T *p) const {
+		if (arena_) p->~T();
+		else delete p;
+	}
+};
+
+template<typename T>
+using NativePtr = std::unique_ptr<T, NativeDeleter<T>>;
+
+template<typename T, typename... Args>
+NativePtr<T> MakeNative(NativeArena *arena, Args &&... args) {
+	if (!arena) return NativePtr<T>(new T(std::forward<Args>(args)...));
+	auto p = arena->allocate(sizeof(T), AlignOf<T>());
+	return NativePtr<T>(new (p) T(std::forward<Args>(args)...), NativeDeleter<T>(arena));
+}
+
+// Serializes `native` as the root of `mb`, which is grown once to the
+// size upper bound first.
+template<typename T>
+void FinishNative(MegrezBuilder &mb, const T &native) {
+	mb.Reserve(native.SerializedSizeUpperBound() + RootSizeUpperBound());
+	mb.Finish(T::InfoType::Pack(mb, native));
+}
+
+} // namespace megrez
+
+#endif // MEGREZ_NATIVE_H_
@@ -0,0 +1,116 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#ifndef MEGREZ_PARALLEL_H_
+#define MEGREZ_PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "megrez/allocator.h"
+#include "megrez/builder.h"
+
+namespace megrez {
+
+// Lets several threads share an allocator that isn't thread-safe, one
+// call at a time.
+class LockedAllocator : public Allocator {
+ private:
+	Allocator *allocator_;
+	std::mutex mutex_;
+
+ public:
+	explicit LockedAllocator(Allocator *allocator) : allocator_(allocator) {}
+
+	uint8_t *allocate(size_t size) override {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return allocator_->allocate(size);
+	}
+	void deallocate(uint8_t *p, size_t size) override {
+		std::lock_guard<std::mutex> lock(mutex_);
+		allocator_->deallocate(p, size);
+	}
+};
+
+// Builds a vector of `len` infos on `threads` workers (0 means one per
+// core), element `i` is `f(mb_of_the_worker, i)` and `f` must only write to
+// the builder it is given. Workers claim `chunk` indices at a time from a
+// shared counter, so the fast ones take over what slow ones haven't reached.
+// Each worker has its own builder on the allocator of `mb`, they are
+// spliced into `mb` afterwards and the element offsets rebased. Needs `mb`
+// not to be inside an info. An exception from a worker (`f`, or the
+// allocator) stops the others and is rethrown here once they're done.
+template<typename T, typename F>
+Offset<Vector<Offset<T>>> ParallelCreateVector(MegrezBuilder &mb, size_t len, F f,
+                                               unsigned threads = 0,
+                                               size_t chunk = 64) {
+	if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+	if (!chunk) chunk = 1;
+	threads = static_cast<unsigned>(
+		std::min<size_t>(threads, (len + chunk - 1) / chunk));
+	std::vector<Offset<T>> offsets(len);
+	if (threads <= 1) {
+		for (size_t i = 0; i < len; i++) offsets[i] = f(mb, i);
+		return mb.CreateVector(offsets);
+	}
+
+	// The default allocator is thread-safe already.
+	LockedAllocator locked(mb.GetAllocator());
+	auto allocator = mb.GetAllocator() == &DefaultAllocator::instance()
+		? mb.GetAllocator() : &locked;
+	std::vector<std::unique_ptr<MegrezBuilder>> builders;
+	std::vector<unsigned> owner(len);
+	for (unsigned t = 0; t < threads; t++)
+		builders.emplace_back(new MegrezBuilder(1024, allocator));
+	std::atomic<size_t> next(0);
+	std::vector<std::exception_ptr> errors(threads);
+	auto work = [&](unsigned t) {
+		auto &sub = *builders[t];
+		try {
+			for (;;) {
+				auto begin = next.fetch_add(chunk);
+				if (begin >= len) break;
+				auto end = std::min(begin + chunk, len);
+				for (auto i = begin; i < end; i++) {
+					offsets[i] = f(sub, i);
+					owner[i] = t;
+				}
+			}
+		} catch (...) {
+			errors[t] = std::current_exception();
+			next.store(len);
+		}
+	};
+	std::vector<std::thread> workers;
+	for (unsigned t = 1; t < threads; t++) workers.emplace_back(work, t);
+	work(0);
+	for (auto it = workers.begin(); it != workers.end(); ++it) it->join();
+	for (auto it = errors.begin(); it != errors.end(); ++it)
+		if (*it) std::rethrow_exception(*it);
+
+	std::vector<uofs_t> bases(threads);
+	for (unsigned t = 0; t < threads; t++) bases[t] = mb.Splice(*builders[t]);
+	for (size_t i = 0; i < len; i++) offsets[i].o += bases[owner[i]];
+	return mb.CreateVector(offsets);
+}
+
+} // namespace megrez
+
+#endif // MEGREZ_PARALLEL_H_
@@ -0,0 +1,459 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#ifndef MEGREZ_PATCH_H_
+#define MEGREZ_PATCH_H_
+
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+#include "megrez/reflection.h"
+
+// Delta encoding between two versions of a buffer of the same schema.
+// `DiffBuffers()` walks both through `SchemaTables` and records the bytes
+// that changed as writes at their position in the old buffer. What can't
+// change in place (a string or vector of another length, a field that
+// appeared or went away, another union member) is handled by copying the
+// smallest changed subtree from the new buffer past the end of the old one
+// and rewriting the offset to it, everything else stays where it is. When
+// that doesn't pay off the patch carries the whole new buffer.
+//
+// A patch is flat: the uofs_t size of the buffer it applies to, the uofs_t
+// size of the result, then runs of uofs_t position, uofs_t length and
+// `length` bytes, sorted by position.
+
+namespace megrez {
+
+// Patch fields sit right after bytes of any length, so they are unaligned.
+inline uofs_t ReadPatchScalar(const uint8_t *p) {
+	uofs_t v;
+	memcpy(&v, p, sizeof(v));
+	return EndianScalar(v);
+}
+
+class BufferDiff {
+ private:
+	// What an offset points at: a vector of `vector` elements, an `info`,
+	// or a string when neither is set.
+	struct Ref {
+		const ReflectedField *vector;
+		const ReflectedObject *info;
+		Ref(const ReflectedField *v, const ReflectedObject *i) : vector(v), info(i) {}
+	};
+
+	// Bytes to write at `position`, from the new buffer or from `scratch_`.
+	struct Run {
+		size_t position;
+		size_t length;
+		size_t from;
+		bool scratch;
+		bool operator<(const Run &other) const { return position < other.position; }
+	};
+
+	// Where to roll back to when a subtree turns out not to fit in place.
+	struct Mark {
+		size_t runs, scratch, tail, matched, copied;
+	};
+
+	// Runs closer than this are sent as one, a run header costs as much.
+	static const size_t kMergeGap = 2 * sizeof(uofs_t);
+
+	const SchemaTables &tables_;
+	const uint8_t *old_buf_;
+	size_t old_size_;
+	const uint8_t *new_buf_;
+	size_t new_size_;
+	size_t align_;
+	size_t tail_;
+	bool ok_;
+	std::vector<Run> runs_;
+	std::vector<uint8_t> scratch_;
+	// Old objects reachable more than once are only changed for the new
+	// object they were first diffed against, others get a copy.
+	std::map<size_t, size_t> matched_;
+	std::vector<size_t> matched_log_;
+	// New objects already copied past the end, by their copy.
+	std::map<size_t, size_t> copied_;
+	std::vector<size_t> copied_log_;
+
+	size_t OldPos(const uint8_t *p) const { return static_cast<size_t>(p - old_buf_); }
+	size_t NewPos(const uint8_t *p) const { return static_cast<size_t>(p - new_buf_); }
+
+	static const uint8_t *Follow(const uint8_t *p) { return p + ReadScalar<uofs_t>(p); }
+
+	Mark GetMark() const {
+		Mark m = { runs_.size(), scratch_.size(), tail_, matched_log_.size(), copied_log_.size() };
+		return m;
+	}
+
+	void Rollback(const Mark &m) {
+		runs_.resize(m.runs);
+		scratch_.resize(m.scratch);
+		tail_ = m.tail;
+		for (auto i = m.matched; i < matched_log_.size(); i++) matched_.erase(matched_log_[i]);
+		matched_log_.resize(m.matched);
+		for (auto i = m.copied; i < copied_log_.size(); i++) copied_.erase(copied_log_[i]);
+		copied_log_.resize(m.copied);
+	}
+
+	void Write(size_t position, const uint8_t *bytes, size_t len) {
+		Run run = { position, len, NewPos(bytes), false };
+		runs_.push_back(run);
+	}
+
+	void WriteOffset(size_t position, uofs_t o) {
+		Run run = { position, sizeof(uofs_t), scratch_.size(), true };
+		scratch_.resize(scratch_.size() + sizeof(uofs_t));
+		WriteScalar(&scratch_[run.from], o);
+		runs_.push_back(run);
+	}
+
+	// A write for every stretch of `len` bytes that differ.
+	void DiffBytes(const uint8_t *o, const uint8_t *n, size_t len) {
+		for (size_t i = 0; i < len; ) {
+			if (o[i] == n[i]) { i++; continue; }
+			auto start = i;
+			while (i < len && o[i] != n[i]) i++;
+			Write(OldPos(o) + start, n + start, i - start);
+		}
+	}
+
+	bool DiffString(const uint8_t *o, const uint8_t *n) {
+		auto len = ReadScalar<uofs_t>(n);
+		if (ReadScalar<uofs_t>(o) != len) return false;
+		DiffBytes(o + sizeof(uofs_t), n + sizeof(uofs_t), len);
+		return true;
+	}
+
+	bool DiffVector(const ReflectedField &field, const uint8_t *o, const uint8_t *n) {
+		auto len = ReadScalar<uofs_t>(n);
+		if (ReadScalar<uofs_t>(o) != len) return false;
+		o += sizeof(uofs_t);
+		n += sizeof(uofs_t);
+		if (field.compact) {
+			DiffBytes(o, n, len);
+			return true;
+		}
+		auto element = tables_.object(field.index);
+		if (field.element == reflection::BaseType_String ||
+		    (field.element == reflection::BaseType_Obj && element && !element->is_struct())) {
+			Ref ref(nullptr, field.element == reflection::BaseType_Obj ? element : nullptr);
+			for (uofs_t i = 0; i < len; i++)
+				DiffOffset(ref, o + i * sizeof(uofs_t), n + i * sizeof(uofs_t));
+			return true;
+		}
+		if (!field.size || field.element == reflection::BaseType_Union) return false;
+		DiffBytes(o, n, len * field.size);
+		return true;
+	}
+
+	bool DiffInfo(const ReflectedObject &object, const uint8_t *o, const uint8_t *n) {
+		auto &old_info = *reinterpret_cast<const Info *>(o);
+		auto &new_info = *reinterpret_cast<const Info *>(n);
+		// The same fields have to be stored, both can be found in place.
+		for (size_t id = 0; id < object.size(); id++) {
+			auto &field = object.field(id);
+			if (field.def && !old_info.CheckField(field.offset) != !new_info.CheckField(field.offset))
+				return false;
+		}
+		for (size_t id = 0; id < object.size(); id++) {
+			auto &field = object.field(id);
+			if (!field.def) continue;
+			auto oo = old_info.GetOptionalFieldOffset(field.offset);
+			if (!oo) continue;
+			auto po = o + oo;
+			auto pn = n + new_info.GetOptionalFieldOffset(field.offset);
+			switch (field.base_type) {
+				case reflection::BaseType_String:
+					DiffOffset(Ref(nullptr, nullptr), po, pn);
+					break;
+				case reflection::BaseType_Vector:
+					DiffOffset(Ref(&field, nullptr), po, pn);
+					break;
+				case reflection::BaseType_Obj: {
+					auto sub = tables_.object(field.index);
+					if (!sub) return false;
+					if (sub->is_struct()) DiffBytes(po, pn, field.size);
+					else DiffOffset(Ref(nullptr, sub), po, pn);
+					break;
+				}
+				case reflection::BaseType_Union: {
+					// The `_type` field right before it was diffed as a scalar,
+					// another member is just another subtree to copy.
+					if (!id) return false;
+					auto member = tables_.UnionMember(field, GetAnyFieldI(new_info, object.field(id - 1)));
+					if (!member) return false;
+					if (GetAnyFieldI(old_info, object.field(id - 1)) ==
+					    GetAnyFieldI(new_info, object.field(id - 1)))
+						DiffOffset(Ref(nullptr, member), po, pn);
+					else
+						Copy(Ref(nullptr, member), OldPos(po), Follow(pn));
+					break;
+				}
+				default:
+					if (!field.size) return false;
+					DiffBytes(po, pn, field.size);
+					break;
+			}
+		}
+		return true;
+	}
+
+	bool DiffRef(const Ref &ref, const uint8_t *o, const uint8_t *n) {
+		auto it = matched_.find(OldPos(o));
+		if (it != matched_.end()) return it->second == NewPos(n);
+		matched_[OldPos(o)] = NewPos(n);
+		matched_log_.push_back(OldPos(o));
+		if (ref.info) return DiffInfo(*ref.info, o, n);
+		if (ref.vector) return DiffVector(*ref.vector, o, n);
+		return DiffString(o, n);
+	}
+
+	// The offsets at `po` and `pn` point at `ref`, the subtree is written in
+	// place when it fits and copied otherwise.
+	void DiffOffset(const Ref &ref, const uint8_t *po, const uint8_t *pn) {
+		auto mark = GetMark();
+		if (DiffRef(ref, Follow(po), Follow(pn))) return;
+		Rollback(mark);
+		Copy(ref, OldPos(po), Follow(pn));
+	}
+
+	// Extends [`*lo`, `*hi`) by everything `n` is made of in the new buffer.
+	bool Span(const Ref &ref, const uint8_t *n, size_t *lo, size_t *hi,
+	          std::set<size_t> *seen) const {
+		if (!seen->insert(NewPos(n)).second) return true;
+		auto extend = [&](const uint8_t *p, size_t len) {
+			*lo = std::min(*lo, NewPos(p));
+			*hi = std::max(*hi, NewPos(p) + len);
+		};
+		if (!ref.info) {
+			auto len = ReadScalar<uofs_t>(n);
+			if (!ref.vector) {
+				extend(n, sizeof(uofs_t) + len + 1);
+				return true;
+			}
+			auto &field = *ref.vector;
+			auto element = tables_.object(field.index);
+			if (!field.size || field.element == reflection::BaseType_Union) return false;
+			extend(n, sizeof(uofs_t) + len * field.size);
+			if (field.compact ||
+			    (field.element != reflection::BaseType_String &&
+			     !(field.element == reflection::BaseType_Obj && element && !element->is_struct())))
+				return true;
+			Ref sub(nullptr, field.element == reflection::BaseType_Obj ? element : nullptr);
+			for (uofs_t i = 0; i < len; i++)
+				if (!Span(sub, Follow(n + sizeof(uofs_t) + i * sizeof(uofs_t)), lo, hi, seen))
+					return false;
+			return true;
+		}
+		auto &object = *ref.info;
+		auto &info = *reinterpret_cast<const Info *>(n);
+		auto vtable = n - ReadScalar<sofs_t>(n);
+		extend(vtable, ReadScalar<vofs_t>(vtable));
+		extend(n, ReadScalar<vofs_t>(vtable + sizeof(vofs_t)));
+		for (size_t id = 0; id < object.size(); id++) {
+			auto &field = object.field(id);
+			if (!field.def) continue;
+			auto o = info.GetOptionalFieldOffset(field.offset);
+			if (!o) continue;
+			// Only followed for the fields that hold an offset.
+			auto p = n + o;
+			bool ok = true;
+			switch (field.base_type) {
+				case reflection::BaseType_String:
+					ok = Span(Ref(nullptr, nullptr), Follow(p), lo, hi, seen);
+					break;
+				case reflection::BaseType_Vector:
+					ok = Span(Ref(&field, nullptr), Follow(p), lo, hi, seen);
+					break;
+				case reflection::BaseType_Obj: {
+					auto sub = tables_.object(field.index);
+					ok = sub && (sub->is_struct() || Span(Ref(nullptr, sub), Follow(p), lo, hi, seen));
+					break;
+				}
+				case reflection::BaseType_Union: {
+					auto member = id ? tables_.UnionMember(field, GetAnyFieldI(info, object.field(id - 1)))
+					                 : nullptr;
+					ok = member && Span(Ref(nullptr, member), Follow(p), lo, hi, seen);
+					break;
+				}
+				default:
+					break;
+			}
+			if (!ok) return false;
+		}
+		return true;
+	}
+
+	// Appends the subtree at `n` past the end of the old buffer and points
+	// the offset at old position `slot` to it.
+	void Copy(const Ref &ref, size_t slot, const uint8_t *n) {
+		auto it = copied_.find(NewPos(n));
+		if (it == copied_.end()) {
+			size_t lo = new_size_, hi = 0;
+			std::set<size_t> seen;
+			if (!Span(ref, n, &lo, &hi, &seen)) {
+				ok_ = false;
+				return;
+			}
+			// Everything keeps its alignment relative to the buffer start.
+			auto start = tail_ + (lo % align_ + align_ - tail_ % align_) % align_;
+			Write(start, new_buf_ + lo, hi - lo);
+			tail_ = start + hi - lo;
+			it = copied_.insert(std::make_pair(NewPos(n), start + NewPos(n) - lo)).first;
+			copied_log_.push_back(NewPos(n));
+		}
+		WriteOffset(slot, static_cast<uofs_t>(it->second - slot));
+	}
+
+	void Put(std::vector<uint8_t> *patch, size_t v) const {
+		auto at = patch->size();
+		auto o = EndianScalar(static_cast<uofs_t>(v));
+		patch->resize(at + sizeof(uofs_t));
+		memcpy(&(*patch)[at], &o, sizeof(o));
+	}
+
+	const uint8_t *RunBytes(const Run &run) const {
+		return run.scratch ? &scratch_[run.from] : new_buf_ + run.from;
+	}
+
+	void Encode(std::vector<uint8_t> *patch) {
+		patch->clear();
+		Put(patch, old_size_);
+		Put(patch, tail_);
+		std::stable_sort(runs_.begin(), runs_.end());
+		for (size_t i = 0; i < runs_.size(); ) {
+			// Neighbours are joined together with the bytes between them, as
+			// they are in the old buffer or the zero padding past its end.
+			auto end = runs_[i].position + runs_[i].length;
+			size_t j = i + 1;
+			while (j < runs_.size() && runs_[j].position <= end + kMergeGap) {
+				end = std::max(end, runs_[j].position + runs_[j].length);
+				j++;
+			}
+			auto start = runs_[i].position;
+			Put(patch, start);
+			Put(patch, end - start);
+			auto at = patch->size();
+			patch->resize(at + end - start, 0);
+			auto out = &(*patch)[at];
+			if (start < old_size_)
+				memcpy(out, old_buf_ + start, std::min(end, old_size_) - start);
+			for (; i < j; i++)
+				memcpy(out + runs_[i].position - start, RunBytes(runs_[i]), runs_[i].length);
+		}
+	}
+
+	void EncodeFull(std::vector<uint8_t> *patch) const {
+		patch->clear();
+		Put(patch, old_size_);
+		Put(patch, new_size_);
+		Put(patch, 0);
+		Put(patch, new_size_);
+		patch->insert(patch->end(), new_buf_, new_buf_ + new_size_);
+	}
+
+ public:
+	// Both buffers have to be verified against `tables`, with the root
+	// `Diff()` is given.
+	BufferDiff(const SchemaTables &tables, const uint8_t *old_buf, size_t old_size,
+	           const uint8_t *new_buf, size_t new_size)
+		: tables_(tables), old_buf_(old_buf), old_size_(old_size),
+		  new_buf_(new_buf), new_size_(new_size), align_(sizeof(max_scalar_t)),
+		  tail_(old_size), ok_(true) {
+		for (size_t i = 0; i < tables.size(); i++)
+			align_ = std::max(align_, static_cast<size_t>(tables.object(static_cast<int>(i))->def()->minalign()));
+	}
+
+	// Returns true if the patch keeps the old buffer where it can, false
+	// if it had to fall back to carrying the whole new one. The patched
+	// buffer never grows past `max_growth` times the size of the new one,
+	// so one that is patched over and over doesn't pile up dead subtrees.
+	bool Diff(const ReflectedObject &root, std::vector<uint8_t> *patch,
+	          double max_growth = 2.0) {
+		DiffOffset(Ref(nullptr, &root), old_buf_, new_buf_);
+		if (ok_) Encode(patch);
+		if (ok_ && patch->size() < new_size_ + 4 * sizeof(uofs_t) &&
+		    tail_ <= max_growth * new_size_)
+			return true;
+		EncodeFull(patch);
+		return false;
+	}
+};
+
+// A patch turning `old_buf` into (a buffer that reads the same as)
+// `new_buf`, see `BufferDiff`.
+inline bool DiffBuffers(const SchemaTables &tables, const ReflectedObject &root,
+                        const uint8_t *old_buf, size_t old_size,
+                        const uint8_t *new_buf, size_t new_size,
+                        std::vector<uint8_t> *patch) {
+	return BufferDiff(tables, old_buf, old_size, new_buf, new_size).Diff(root, patch);
+}
+
+// Size of the buffer `patch` makes, 0 if it isn't well formed or doesn't
+// apply to a buffer of `size` bytes. Every run is checked, so applying a
+// patch this accepts can't write out of bounds.
+inline size_t PatchedSize(size_t size, const uint8_t *patch, size_t patch_size) {
+	if (patch_size < 2 * sizeof(uofs_t) || ReadPatchScalar(patch) != size) return 0;
+	size_t result = ReadPatchScalar(patch + sizeof(uofs_t));
+	for (size_t at = 2 * sizeof(uofs_t); at < patch_size; ) {
+		if (patch_size - at < 2 * sizeof(uofs_t)) return 0;
+		size_t position = ReadPatchScalar(patch + at);
+		size_t length = ReadPatchScalar(patch + at + sizeof(uofs_t));
+		at += 2 * sizeof(uofs_t);
+		if (length > patch_size - at || position > result || length > result - position)
+			return 0;
+		at += length;
+	}
+	return result;
+}
+
+// Applies a patch to a buffer that is `PatchedSize()` bytes large or more,
+// the runs are copied and nothing else is touched.
+inline void ApplyPatchRuns(uint8_t *buf, const uint8_t *patch, size_t patch_size) {
+	for (size_t at = 2 * sizeof(uofs_t); at < patch_size; ) {
+		auto position = ReadPatchScalar(patch + at);
+		auto length = ReadPatchScalar(patch + at + sizeof(uofs_t));
+		at += 2 * sizeof(uofs_t);
+		memcpy(buf + position, patch + at, length);
+		at += length;
+	}
+}
+
+// In place, for a patch that doesn't change the size of the buffer.
+inline bool ApplyBufferPatch(uint8_t *buf, size_t size,
+                             const uint8_t *patch, size_t patch_size) {
+	if (!size || PatchedSize(size, patch, patch_size) != size) return false;
+	ApplyPatchRuns(buf, patch, patch_size);
+	return true;
+}
+
+// Grows or shrinks `buf` as the patch says, a malformed patch or one made
+// for another base leaves it alone.
+inline bool ApplyBufferPatch(std::vector<uint8_t> *buf,
+                             const uint8_t *patch, size_t patch_size) {
+	auto size = PatchedSize(buf->size(), patch, patch_size);
+	if (!size) return false;
+	buf->resize(size, 0);
+	ApplyPatchRuns(buf->data(), patch, patch_size);
+	return true;
+}
+
+} // namespace megrez
+
+#endif // MEGREZ_PATCH_H_
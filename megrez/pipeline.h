@@ -0,0 +1,236 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#ifndef MEGREZ_PIPELINE_H_
+#define MEGREZ_PIPELINE_H_
+
+#include <assert.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "megrez/allocator.h"
+#include "megrez/builder.h"
+
+// Hands messages from the thread that builds them to the thread that sends
+// them. A fixed set of builders circulates between the two: the producer
+// takes a cleared one, builds and submits it (it is finished size prefixed,
+// see megrez/stream.h), the consumer collects what was submitted into a
+// batch of frames for one `writev()`, and once the I/O is done the batch's
+// builders go back cleared but with their grown buffers. After warm up
+// nothing on either side allocates, and neither side ever takes a lock.
+
+namespace megrez {
+
+// Bounded ring for exactly one pushing and one popping thread.
+template<typename T>
+class SpscQueue {
+ private:
+	// Each index is written by one side only, padded to a cache line of
+	// its own together with that side's last view of the other index.
+	struct Index {
+		std::atomic<size_t> pos;
+		size_t cached;
+		char padding[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+		Index() : pos(0), cached(0) {}
+	};
+
+	std::vector<T> ring_;
+	size_t mask_;
+	Index head_;  // next to pop, written by the consumer
+	Index tail_;  // next to push, written by the producer
+
+ public:
+	// Rounded up to a power of two.
+	explicit SpscQueue(size_t capacity) {
+		size_t size = 2;
+		while (size < capacity) size *= 2;
+		ring_.resize(size);
+		mask_ = size - 1;
+	}
+	SpscQueue(const SpscQueue &) = delete;
+	SpscQueue &operator=(const SpscQueue &) = delete;
+
+	bool TryPush(const T &value) {
+		auto tail = tail_.pos.load(std::memory_order_relaxed);
+		if (tail - tail_.cached > mask_) {
+			tail_.cached = head_.pos.load(std::memory_order_acquire);
+			if (tail - tail_.cached > mask_) return false;
+		}
+		ring_[tail & mask_] = value;
+		tail_.pos.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(T *value) {
+		auto head = head_.pos.load(std::memory_order_relaxed);
+		if (head == head_.cached) {
+			head_.cached = tail_.pos.load(std::memory_order_acquire);
+			if (head == head_.cached) return false;
+		}
+		*value = ring_[head & mask_];
+		head_.pos.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t capacity() const { return ring_.size(); }
+};
+
+class FramePipeline;
+
+// Frames collected by `FramePipeline::NextBatch()`, in submission order.
+// Reuse one batch, the vectors keep their capacity.
+class FrameBatch {
+ public:
+	// Runs once the frame went out, from `Complete()`.
+	typedef void (*Completion)(void *context, const MegrezBuilder &mb);
+
+ private:
+	struct Frame {
+		MegrezBuilder *mb;
+		Completion completion;
+		void *context;
+	};
+
+	FramePipeline *pipeline_;
+	std::vector<Frame> frames_;
+	std::vector<BufferSegment> segments_;
+	std::vector<BufferSegment> pieces_;  // of one frame
+	size_t bytes_;
+
+	friend class FramePipeline;
+
+ public:
+	FrameBatch() : pipeline_(nullptr), bytes_(0) {}
+	FrameBatch(const FrameBatch &) = delete;
+	FrameBatch &operator=(const FrameBatch &) = delete;
+	~FrameBatch() { assert(frames_.empty()); }
+
+	// Every frame's bytes, ready for `WriteSegments()`.
+	const std::vector<BufferSegment> &segments() const { return segments_; }
+	size_t frames() const { return frames_.size(); }
+	size_t bytes() const { return bytes_; }
+	bool empty() const { return frames_.empty(); }
+
+	// The I/O layer is done with the segments: runs the completions and
+	// returns the builders. Call on the consumer thread.
+	void Complete();
+};
+
+class FramePipeline {
+ private:
+	std::vector<std::unique_ptr<MegrezBuilder>> builders_;
+	SpscQueue<MegrezBuilder *> free_;              // consumer to producer
+	SpscQueue<FrameBatch::Frame> ready_;           // producer to consumer
+	std::atomic<bool> closed_;
+
+	friend class FrameBatch;
+
+	void Recycle(MegrezBuilder *mb) {
+		mb->Clear();
+		auto ok = free_.TryPush(mb);
+		assert(ok);  // there are never more builders than slots
+		(void)ok;
+	}
+
+ public:
+	// `builders` messages can be in flight at once, each builder starts
+	// with `initial_size` bytes from `allocator`.
+	explicit FramePipeline(size_t builders = 64, uofs_t initial_size = 1024,
+	                       Allocator *allocator = nullptr)
+		: free_(builders), ready_(builders), closed_(false) {
+		assert(builders);
+		for (size_t i = 0; i < builders; i++) {
+			builders_.emplace_back(new MegrezBuilder(initial_size, allocator));
+			free_.TryPush(builders_.back().get());
+		}
+	}
+	FramePipeline(const FramePipeline &) = delete;
+	FramePipeline &operator=(const FramePipeline &) = delete;
+
+	// Producer side. A cleared builder, or nullptr while all of them are in
+	// flight.
+	MegrezBuilder *TryAcquire() {
+		MegrezBuilder *mb;
+		return free_.TryPop(&mb) ? mb : nullptr;
+	}
+
+	// Waits for the consumer to give one back.
+	MegrezBuilder *Acquire() {
+		for (;;) {
+			auto mb = TryAcquire();
+			if (mb) return mb;
+			std::this_thread::yield();
+		}
+	}
+
+	// Finishes `mb` as a frame with `root` and queues it. `completion`, if
+	// any, runs with `context` once the frame has been sent.
+	template<typename T>
+	void Submit(MegrezBuilder *mb, Offset<T> root,
+	            FrameBatch::Completion completion = nullptr,
+	            void *context = nullptr) {
+		mb->FinishSizePrefixed(root);
+		FrameBatch::Frame frame = { mb, completion, context };
+		// Can't be full, it has a slot for every builder.
+		auto ok = ready_.TryPush(frame);
+		assert(ok);
+		(void)ok;
+	}
+
+	// No more submissions, see `closed()`.
+	void Close() { closed_.store(true, std::memory_order_release); }
+
+	// Consumer side. Moves up to `max_frames` submitted frames into
+	// `batch`, which must have been completed. Returns false when there was
+	// nothing.
+	bool NextBatch(FrameBatch *batch, size_t max_frames = 64) {
+		assert(batch->frames_.empty());
+		batch->pipeline_ = this;
+		batch->segments_.clear();
+		batch->bytes_ = 0;
+		FrameBatch::Frame frame;
+		while (batch->frames_.size() < max_frames && ready_.TryPop(&frame)) {
+			batch->frames_.push_back(frame);
+			batch->bytes_ += frame.mb->GetSize();
+		}
+		for (auto it = batch->frames_.begin(); it != batch->frames_.end(); ++it) {
+			it->mb->GetBufferSegments(&batch->pieces_);
+			batch->segments_.insert(batch->segments_.end(), batch->pieces_.begin(),
+			                        batch->pieces_.end());
+		}
+		return !batch->frames_.empty();
+	}
+
+	// Read before a `NextBatch()` that comes back empty, true then means
+	// every submitted frame has been handed out.
+	bool closed() const { return closed_.load(std::memory_order_acquire); }
+	size_t builders() const { return builders_.size(); }
+};
+
+inline void FrameBatch::Complete() {
+	for (auto it = frames_.begin(); it != frames_.end(); ++it) {
+		if (it->completion) it->completion(it->context, *it->mb);
+		pipeline_->Recycle(it->mb);
+	}
+	frames_.clear();
+	segments_.clear();
+	bytes_ = 0;
+}
+
+} // namespace megrez
+
+#endif // MEGREZ_PIPELINE_H_
@@ -0,0 +1,95 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#ifndef MEGREZ_POOL_H_
+#define MEGREZ_POOL_H_
+
+#include <memory>
+#include <vector>
+#include "megrez/allocator.h"
+#include "megrez/builder.h"
+
+namespace megrez {
+
+class BuilderPool;
+
+// Hands a builder back to its pool instead of deleting it.
+struct BuilderRecycler {
+	BuilderPool *pool;
+	void operator()(MegrezBuilder *mb) const;
+};
+
+typedef std::unique_ptr<MegrezBuilder, BuilderRecycler> PooledBuilder;
+
+// A free list of cleared builders, so a short-lived builder keeps the
+// buffer its predecessor already grew. Not thread-safe, see
+// `ThreadLocalBuilderPool()`.
+class BuilderPool {
+ private:
+	std::vector<MegrezBuilder *> free_;
+	uofs_t initial_size_;
+	Allocator *allocator_;
+	size_t max_pooled_;
+
+ public:
+	explicit BuilderPool(uofs_t initial_size = 1024,
+	                     Allocator *allocator = nullptr,
+	                     size_t max_pooled = 16)
+		: initial_size_(initial_size),
+		  allocator_(allocator),
+		  max_pooled_(max_pooled) {}
+	BuilderPool(const BuilderPool &) = delete;
+	BuilderPool &operator=(const BuilderPool &) = delete;
+	~BuilderPool() {
+		for (auto it = free_.begin(); it != free_.end(); ++it) delete *it;
+	}
+
+	PooledBuilder Acquire() {
+		BuilderRecycler recycler = { this };
+		if (free_.size()) {
+			auto mb = free_.back();
+			free_.pop_back();
+			return PooledBuilder(mb, recycler);
+		}
+		return PooledBuilder(new MegrezBuilder(initial_size_, allocator_), recycler);
+	}
+
+	void Recycle(MegrezBuilder *mb) {
+		if (free_.size() < max_pooled_) {
+			mb->Clear();
+			free_.push_back(mb);
+		} else {
+			delete mb;
+		}
+	}
+
+	size_t pooled() const { return free_.size(); }
+};
+
+inline void BuilderRecycler::operator()(MegrezBuilder *mb) const {
+	pool->Recycle(mb);
+}
+
+// One pool per thread backed by `ThreadLocalPoolAllocator()`. A builder
+// must be released on the thread that acquired it.
+inline BuilderPool &ThreadLocalBuilderPool() {
+	static thread_local BuilderPool pool(1024, &ThreadLocalPoolAllocator());
+	return pool;
+}
+
+} // namespace megrez
+
+#endif // MEGREZ_POOL_H_
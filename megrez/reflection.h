@@ -0,0 +1,370 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#ifndef MEGREZ_REFLECTION_H_
+#define MEGREZ_REFLECTION_H_
+
+#include <string.h>
+#include <vector>
+#include "megrez/basic.h"
+#include "megrez/info.h"
+#include "megrez/reflection.mgz.h"
+#include "megrez/verifier.h"
+
+// Reads buffers of any schema through the binary schema `MegrezC -s`
+// writes. `SchemaTables` resolves the schema once into flat per object
+// field tables, after that a field read is a vtable lookup and a switch
+// on its type, no schema access.
+
+namespace megrez {
+
+// Inline size of a scalar of `reflection::BaseType` `t`, 0 otherwise.
+inline size_t ReflectedScalarSize(uint8_t t) {
+	static const uint8_t sizes[] = { 1, 1, 1, 1, 1, 2, 2, 4, 4, 8, 8, 4, 8 };
+	return t <= reflection::BaseType_Double ? sizes[t] : 0;
+}
+
+inline bool IsReflectedInteger(uint8_t t) {
+	return t >= reflection::BaseType_UType && t <= reflection::BaseType_ULong;
+}
+
+inline bool IsReflectedFloat(uint8_t t) {
+	return t == reflection::BaseType_Float || t == reflection::BaseType_Double;
+}
+
+// Any scalar at `p`, converted.
+inline int64_t ReadAnyScalarI(uint8_t t, const uint8_t *p) {
+	switch (t) {
+		case reflection::BaseType_UType:
+		case reflection::BaseType_Bool:
+		case reflection::BaseType_UByte:  return ReadScalar<uint8_t>(p);
+		case reflection::BaseType_Byte:   return ReadScalar<int8_t>(p);
+		case reflection::BaseType_Short:  return ReadScalar<int16_t>(p);
+		case reflection::BaseType_UShort: return ReadScalar<uint16_t>(p);
+		case reflection::BaseType_Int:    return ReadScalar<int32_t>(p);
+		case reflection::BaseType_UInt:   return ReadScalar<uint32_t>(p);
+		case reflection::BaseType_Long:   return ReadScalar<int64_t>(p);
+		case reflection::BaseType_ULong:  return static_cast<int64_t>(ReadScalar<uint64_t>(p));
+		case reflection::BaseType_Float:  return static_cast<int64_t>(ReadScalar<float>(p));
+		case reflection::BaseType_Double: return static_cast<int64_t>(ReadScalar<double>(p));
+		default:                          return 0;
+	}
+}
+
+inline double ReadAnyScalarF(uint8_t t, const uint8_t *p) {
+	switch (t) {
+		case reflection::BaseType_Float:  return ReadScalar<float>(p);
+		case reflection::BaseType_Double: return ReadScalar<double>(p);
+		case reflection::BaseType_ULong:  return static_cast<double>(ReadScalar<uint64_t>(p));
+		default:                          return static_cast<double>(ReadAnyScalarI(t, p));
+	}
+}
+
+// One field with everything a read needs copied out of the schema.
+struct ReflectedField {
+	const reflection::Field *def;
+	vofs_t offset;      // vtable offset, or byte offset inside a struct
+	uint8_t base_type;
+	uint8_t element;    // for vectors
+	bool compact;
+	int index;          // object or enum index, -1 if none
+	size_t size;        // inline size of a scalar, or of the vector elements
+	int64_t default_integer;
+	double default_real;
+};
+
+class SchemaTables;
+
+// The fields of an object in declaration order.
+class ReflectedObject {
+ private:
+	const reflection::Object *def_;
+	std::vector<ReflectedField> fields_;
+
+	friend class SchemaTables;
+
+ public:
+	ReflectedObject() : def_(nullptr) {}
+
+	const reflection::Object *def() const { return def_; }
+	const char *name() const { return def_->name()->c_str(); }
+	bool is_struct() const { return def_->is_struct(); }
+	size_t size() const { return fields_.size(); }
+	const ReflectedField &field(size_t id) const { return fields_[id]; }
+
+	// Binary search by name, nullptr if there's no such field.
+	const ReflectedField *Find(const char *name) const {
+		auto fields = def_->fields();
+		auto f = fields ? fields->LookupByKey(name) : nullptr;
+		return f && f->id() < fields_.size() ? &fields_[f->id()] : nullptr;
+	}
+};
+
+class SchemaTables {
+ private:
+	const reflection::Schema *schema_;
+	std::vector<ReflectedObject> objects_;
+
+	int ObjectIndex(int index) const {
+		return index >= 0 && static_cast<size_t>(index) < objects_.size() ? index : -1;
+	}
+
+ public:
+	// `schema` has to outlive the tables, verify it with
+	// `reflection::VerifySchemaBuffer()` first if it isn't trusted.
+	explicit SchemaTables(const reflection::Schema *schema) : schema_(schema) {
+		auto objects = schema->objects();
+		if (!objects) return;
+		objects_.resize(objects->size());
+		for (uofs_t i = 0; i < objects->size(); i++) {
+			auto &object = objects_[i];
+			object.def_ = objects->Get(i);
+			auto fields = object.def_->fields();
+			if (!fields) continue;
+			object.fields_.resize(fields->size());
+			for (auto f : *fields) {
+				if (f->id() >= fields->size()) continue;
+				auto type = f->type();
+				auto &field = object.fields_[f->id()];
+				field.def = f;
+				field.offset = f->offset();
+				field.base_type = type ? type->base_type() : 0;
+				field.element = type ? type->element() : 0;
+				field.compact = type && type->compact();
+				field.index = type ? type->index() : -1;
+				field.size = ReflectedScalarSize(field.base_type);
+				field.default_integer = f->default_integer();
+				field.default_real = f->default_real();
+			}
+		}
+		// Element sizes need the struct sizes.
+		for (auto it = objects_.begin(); it != objects_.end(); ++it) {
+			for (auto f = it->fields_.begin(); f != it->fields_.end(); ++f) {
+				if (f->base_type == reflection::BaseType_Obj) {
+					auto o = ObjectIndex(f->index);
+					if (o >= 0 && objects_[o].is_struct())
+						f->size = static_cast<size_t>(objects_[o].def()->bytesize());
+				} else if (f->base_type == reflection::BaseType_Vector) {
+					auto o = ObjectIndex(f->index);
+					f->size = f->compact ? 1
+						: f->element == reflection::BaseType_Obj && o >= 0 && objects_[o].is_struct()
+							? static_cast<size_t>(objects_[o].def()->bytesize())
+							: f->element >= reflection::BaseType_String ? sizeof(uofs_t)
+								: ReflectedScalarSize(f->element);
+				}
+			}
+		}
+	}
+
+	const reflection::Schema *schema() const { return schema_; }
+	size_t size() const { return objects_.size(); }
+
+	// nullptr for an index out of range.
+	const ReflectedObject *object(int index) const {
+		return ObjectIndex(index) >= 0 ? &objects_[index] : nullptr;
+	}
+
+	const ReflectedObject *main() const { return object(schema_->main_object()); }
+
+	const ReflectedObject *Find(const char *name) const {
+		auto objects = schema_->objects();
+		if (!objects) return nullptr;
+		// Objects are sorted by name, searched by hand since the table
+		// is found by index.
+		uofs_t lo = 0, hi = objects->size();
+		while (lo < hi) {
+			auto mid = lo + (hi - lo) / 2;
+			auto c = strcmp(objects->Get(mid)->name()->c_str(), name);
+			if (!c) return &objects_[mid];
+			if (c < 0) lo = mid + 1;
+			else hi = mid;
+		}
+		return nullptr;
+	}
+
+	// The object a union field holds for the value of its `_type` field.
+	const ReflectedObject *UnionMember(const ReflectedField &field, int64_t type) const {
+		auto enums = schema_->enums();
+		if (field.index < 0 || !enums || static_cast<uofs_t>(field.index) >= enums->size())
+			return nullptr;
+		auto values = enums->Get(field.index)->values();
+		if (!values) return nullptr;
+		for (auto v : *values)
+			if (v->value() == type) return object(v->object());
+		return nullptr;
+	}
+};
+
+// Generic field reads on an info, scalars are converted, a field of
+// another kind reads as its default or nullptr.
+inline int64_t GetAnyFieldI(const Info &info, const ReflectedField &field) {
+	if (!field.size || field.base_type > reflection::BaseType_Double)
+		return field.default_integer;
+	auto o = info.GetOptionalFieldOffset(field.offset);
+	if (!o) return IsReflectedFloat(field.base_type)
+		? static_cast<int64_t>(field.default_real) : field.default_integer;
+	return ReadAnyScalarI(field.base_type, reinterpret_cast<const uint8_t *>(&info) + o);
+}
+
+inline double GetAnyFieldF(const Info &info, const ReflectedField &field) {
+	if (!field.size || field.base_type > reflection::BaseType_Double)
+		return field.default_real;
+	auto o = info.GetOptionalFieldOffset(field.offset);
+	if (!o) return IsReflectedFloat(field.base_type)
+		? field.default_real : static_cast<double>(field.default_integer);
+	return ReadAnyScalarF(field.base_type, reinterpret_cast<const uint8_t *>(&info) + o);
+}
+
+inline const String *GetAnyFieldS(const Info &info, const ReflectedField &field) {
+	return field.base_type == reflection::BaseType_String
+		? info.GetPointer<const String *>(field.offset) : nullptr;
+}
+
+// A sub info or the member of a union.
+inline const Info *GetAnyFieldInfo(const Info &info, const ReflectedField &field) {
+	return field.base_type == reflection::BaseType_Union ||
+	       (field.base_type == reflection::BaseType_Obj && !field.size)
+		? info.GetPointer<const Info *>(field.offset) : nullptr;
+}
+
+// The inline bytes of a struct field.
+inline const uint8_t *GetAnyFieldStruct(const Info &info, const ReflectedField &field) {
+	return field.base_type == reflection::BaseType_Obj && field.size
+		? info.GetStruct<const uint8_t *>(field.offset) : nullptr;
+}
+
+// Elements are `field.size` bytes apart, `GetAnyVectorElement*()` read them.
+inline const Vector<uint8_t> *GetAnyFieldVector(const Info &info, const ReflectedField &field) {
+	return field.base_type == reflection::BaseType_Vector
+		? info.GetPointer<const Vector<uint8_t> *>(field.offset) : nullptr;
+}
+
+inline const uint8_t *GetAnyVectorElement(const Vector<uint8_t> &vec,
+                                          const ReflectedField &field, uofs_t i) {
+	return vec.data() + i * field.size;
+}
+
+inline int64_t GetAnyVectorElementI(const Vector<uint8_t> &vec,
+                                    const ReflectedField &field, uofs_t i) {
+	return ReadAnyScalarI(field.element, GetAnyVectorElement(vec, field, i));
+}
+
+inline double GetAnyVectorElementF(const Vector<uint8_t> &vec,
+                                   const ReflectedField &field, uofs_t i) {
+	return ReadAnyScalarF(field.element, GetAnyVectorElement(vec, field, i));
+}
+
+// Strings and infos of a vector of offsets.
+template<typename T>
+const T *GetAnyVectorElementPointer(const Vector<uint8_t> &vec,
+                                    const ReflectedField &field, uofs_t i) {
+	auto p = GetAnyVectorElement(vec, field, i);
+	return reinterpret_cast<const T *>(p + ReadScalar<uofs_t>(p));
+}
+
+// Scalars inside a struct, at their byte offset.
+inline int64_t GetAnyStructFieldI(const uint8_t *s, const ReflectedField &field) {
+	return ReadAnyScalarI(field.base_type, s + field.offset);
+}
+
+inline double GetAnyStructFieldF(const uint8_t *s, const ReflectedField &field) {
+	return ReadAnyScalarF(field.base_type, s + field.offset);
+}
+
+// The schema driven counterpart of the generated `Verify()`.
+inline bool VerifyAnyInfo(Verifier &verifier, const SchemaTables &tables,
+                          const ReflectedObject &object, const Info *info) {
+	if (!info) return true;
+	if (!info->VerifyInfoStart(verifier)) return false;
+	for (size_t id = 0; id < object.size(); id++) {
+		auto &field = object.field(id);
+		if (!field.def || field.def->deprecated()) continue;
+		auto o = info->GetOptionalFieldOffset(field.offset);
+		if (!o) continue;
+		auto p = reinterpret_cast<const uint8_t *>(info) + o;
+		switch (field.base_type) {
+			case reflection::BaseType_String:
+				if (!verifier.VerifyOffset(p) ||
+				    !verifier.VerifyString(GetAnyFieldS(*info, field)))
+					return false;
+				break;
+			case reflection::BaseType_Vector: {
+				auto element = tables.object(field.index);
+				if (!field.size || !verifier.VerifyOffset(p)) return false;
+				auto vec = reinterpret_cast<const uint8_t *>(GetAnyFieldVector(*info, field));
+				if (!verifier.VerifyVectorOrString(vec, field.size) ||
+				    !verifier.VerifyAlignment(vec + sizeof(uofs_t),
+				      element && element->is_struct()
+				        ? static_cast<size_t>(element->def()->minalign())
+				        : field.size))
+					return false;
+				if (field.element != reflection::BaseType_String &&
+				    !(field.element == reflection::BaseType_Obj && element &&
+				      !element->is_struct()))
+					break;
+				auto &v = *reinterpret_cast<const Vector<uint8_t> *>(vec);
+				for (uofs_t i = 0; i < v.size(); i++) {
+					if (!verifier.VerifyOffset(GetAnyVectorElement(v, field, i))) return false;
+					if (field.element == reflection::BaseType_String
+					    ? !verifier.VerifyString(GetAnyVectorElementPointer<String>(v, field, i))
+					    : !VerifyAnyInfo(verifier, tables, *element,
+					        GetAnyVectorElementPointer<Info>(v, field, i)))
+						return false;
+				}
+				break;
+			}
+			case reflection::BaseType_Obj: {
+				auto sub = tables.object(field.index);
+				if (!sub) return false;
+				if (sub->is_struct()) {
+					if (!verifier.Verify(p, field.size) ||
+					    !verifier.VerifyAlignment(p, static_cast<size_t>(sub->def()->minalign())))
+						return false;
+				} else if (!verifier.VerifyOffset(p) ||
+				           !VerifyAnyInfo(verifier, tables, *sub, GetAnyFieldInfo(*info, field))) {
+					return false;
+				}
+				break;
+			}
+			case reflection::BaseType_Union: {
+				if (!verifier.VerifyOffset(p)) return false;
+				// The parser puts the `_type` field right before the union.
+				if (!id) return false;
+				auto member = tables.UnionMember(field, GetAnyFieldI(*info, object.field(id - 1)));
+				if (member && !VerifyAnyInfo(verifier, tables, *member, GetAnyFieldInfo(*info, field)))
+					return false;
+				break;
+			}
+			default:
+				if (!field.size || !verifier.Verify(p, field.size) ||
+				    !verifier.VerifyAlignment(p, field.size))
+					return false;
+				break;
+		}
+	}
+	return verifier.EndInfo();
+}
+
+// A buffer whose root is `object`.
+inline bool VerifyAnyBuffer(Verifier &verifier, const SchemaTables &tables,
+                            const ReflectedObject &object, const uint8_t *buf) {
+	return verifier.VerifyOffset(buf) &&
+	       VerifyAnyInfo(verifier, tables, object, GetRoot<Info>(buf));
+}
+
+} // namespace megrez
+
+#endif // MEGREZ_REFLECTION_H_
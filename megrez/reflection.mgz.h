@@ -0,0 +1,1430 @@
+// Automatically generated by MegrezCompiler, DO NOT MODIFY!
+
+#ifndef MEGREZ_GENERATED_REFLECTION_MEGREZ_REFLECTION_H_
+#define MEGREZ_GENERATED_REFLECTION_MEGREZ_REFLECTION_H_
+
+#include <megrez/basic.h>
+#include <megrez/builder.h>
+#include <megrez/compact.h>
+#include <megrez/info.h>
+#include <megrez/native.h>
+#include <megrez/string.h>
+#include <megrez/struct.h>
+#include <megrez/vector.h>
+#include <megrez/verifier.h>
+
+namespace megrez {
+namespace reflection {
+
+enum {
+	BaseType_None = 0,
+	BaseType_UType = 1,
+	BaseType_Bool = 2,
+	BaseType_Byte = 3,
+	BaseType_UByte = 4,
+	BaseType_Short = 5,
+	BaseType_UShort = 6,
+	BaseType_Int = 7,
+	BaseType_UInt = 8,
+	BaseType_Long = 9,
+	BaseType_ULong = 10,
+	BaseType_Float = 11,
+	BaseType_Double = 12,
+	BaseType_String = 13,
+	BaseType_Vector = 14,
+	BaseType_Obj = 15,
+	BaseType_Union = 16,
+};
+
+inline const char **EnumNamesBaseType() {
+	static const char *names[] = { "None", "UType", "Bool", "Byte", "UByte", "Short", "UShort", "Int", "UInt", "Long", "ULong", "Float", "Double", "String", "Vector", "Obj", "Union", nullptr };
+	return names;
+}
+
+inline const char *EnumNameBaseType(int e) { return EnumNamesBaseType()[e]; }
+
+struct Type;
+struct TypeT;
+struct KeyValue;
+struct KeyValueT;
+struct EnumVal;
+struct EnumValT;
+struct Enum;
+struct EnumT;
+struct Field;
+struct FieldT;
+struct Object;
+struct ObjectT;
+struct Schema;
+struct SchemaT;
+
+struct Type : private megrez::Info {
+	uint8_t base_type() const { return GetField<uint8_t>(4, 0); }
+	bool mutate_base_type(uint8_t base_type) { return SetField<uint8_t>(4, base_type); }
+	uint8_t element() const { return GetField<uint8_t>(6, 0); }
+	bool mutate_element(uint8_t element) { return SetField<uint8_t>(6, element); }
+	int32_t index() const { return GetField<int32_t>(8, -1); }
+	bool mutate_index(int32_t index) { return SetField<int32_t>(8, index); }
+	uint8_t compact() const { return GetField<uint8_t>(10, 0); }
+	bool mutate_compact(uint8_t compact) { return SetField<uint8_t>(10, compact); }
+	megrez::NativePtr<TypeT> UnPack(megrez::NativeArena *arena = nullptr) const;
+	void UnPackTo(TypeT *_o) const;
+	static megrez::Offset<Type> Pack(megrez::MegrezBuilder &_mb, const TypeT &_o);
+	enum {
+		Field_base_type = 0,
+		Field_element = 1,
+		Field_index = 2,
+		Field_compact = 3,
+	};
+	template<int F> struct FieldTraits;
+	template<int F> typename FieldTraits<F>::type Get() const { return FieldTraits<F>::Get(this); }
+	template<typename V> void VisitFields(V &&v) const;
+	bool Verify(megrez::Verifier &verifier) const {
+		return VerifyInfoStart(verifier) &&
+		       VerifyField<uint8_t>(verifier, 4) &&
+		       VerifyField<uint8_t>(verifier, 6) &&
+		       VerifyField<int32_t>(verifier, 8) &&
+		       VerifyField<uint8_t>(verifier, 10) &&
+		       verifier.EndInfo();
+	}
+};
+
+template<> struct Type::FieldTraits<Type::Field_base_type> {
+	typedef uint8_t type;
+	static constexpr const char *name() { return "base_type"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 4; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const Type *o) { return o->base_type(); }
+};
+template<> struct Type::FieldTraits<Type::Field_element> {
+	typedef uint8_t type;
+	static constexpr const char *name() { return "element"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 6; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const Type *o) { return o->element(); }
+};
+template<> struct Type::FieldTraits<Type::Field_index> {
+	typedef int32_t type;
+	static constexpr const char *name() { return "index"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 8; }
+	static constexpr type default_value() { return -1; }
+	static type Get(const Type *o) { return o->index(); }
+};
+template<> struct Type::FieldTraits<Type::Field_compact> {
+	typedef uint8_t type;
+	static constexpr const char *name() { return "compact"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 10; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const Type *o) { return o->compact(); }
+};
+template<typename V> inline void Type::VisitFields(V &&v) const {
+	v(FieldTraits<Field_base_type>(), base_type());
+	v(FieldTraits<Field_element>(), element());
+	v(FieldTraits<Field_index>(), index());
+	v(FieldTraits<Field_compact>(), compact());
+}
+
+struct TypeView : public megrez::InfoView<4> {
+	explicit TypeView(const Type *info = nullptr) : megrez::InfoView<4>(info) {}
+	uint8_t base_type() const { return GetField<uint8_t>(0, 0); }
+	uint8_t element() const { return GetField<uint8_t>(1, 0); }
+	int32_t index() const { return GetField<int32_t>(2, -1); }
+	uint8_t compact() const { return GetField<uint8_t>(3, 0); }
+};
+
+struct TypeBuilder {
+	megrez::MegrezBuilder &mb_;
+	megrez::uofs_t start_;
+	void add_base_type(uint8_t base_type) { mb_.AddElement<uint8_t>(4, base_type, 0); }
+	void add_element(uint8_t element) { mb_.AddElement<uint8_t>(6, element, 0); }
+	void add_index(int32_t index) { mb_.AddElement<int32_t>(8, index, -1); }
+	void add_compact(uint8_t compact) { mb_.AddElement<uint8_t>(10, compact, 0); }
+	TypeBuilder(megrez::MegrezBuilder &_mb) : mb_(_mb) { start_ = mb_.StartInfo(); }
+	megrez::Offset<Type> Finish() { return megrez::Offset<Type>(mb_.EndInfo(start_, 4)); }
+};
+
+inline megrez::Offset<Type> CreateType(
+	  megrez::MegrezBuilder &_mb,
+	  uint8_t base_type,
+	  uint8_t element,
+	  int32_t index,
+	  uint8_t compact) {
+
+	TypeBuilder builder_(_mb);
+	builder_.add_index(index);
+	builder_.add_compact(compact);
+	builder_.add_element(element);
+	builder_.add_base_type(base_type);
+	return builder_.Finish();
+}
+
+inline size_t CreateTypeSizeUpperBound(
+	  uint8_t,
+	  uint8_t,
+	  int32_t,
+	  uint8_t) {
+	return megrez::InfoSizeUpperBound(4, 10);
+}
+
+struct KeyValue : private megrez::Info {
+	const megrez::String *key() const { return GetPointer<const megrez::String *>(4); }
+	megrez::String *mutable_key() { return GetMutablePointer<megrez::String>(4); }
+	const megrez::String *value() const { return GetPointer<const megrez::String *>(6); }
+	megrez::String *mutable_value() { return GetMutablePointer<megrez::String>(6); }
+	bool KeyCompareLessThan(const KeyValue *o) const { return megrez::CompareStrings(key(), o->key()) < 0; }
+	int KeyCompareWithValue(megrez::StringRef val) const { return megrez::CompareStrings(key(), val); }
+	megrez::NativePtr<KeyValueT> UnPack(megrez::NativeArena *arena = nullptr) const;
+	void UnPackTo(KeyValueT *_o) const;
+	static megrez::Offset<KeyValue> Pack(megrez::MegrezBuilder &_mb, const KeyValueT &_o);
+	enum {
+		Field_key = 0,
+		Field_value = 1,
+	};
+	template<int F> struct FieldTraits;
+	template<int F> typename FieldTraits<F>::type Get() const { return FieldTraits<F>::Get(this); }
+	template<typename V> void VisitFields(V &&v) const;
+	bool Verify(megrez::Verifier &verifier) const {
+		return VerifyInfoStart(verifier) &&
+		       VerifyOffset(verifier, 4) && verifier.VerifyString(key()) &&
+		       VerifyOffset(verifier, 6) && verifier.VerifyString(value()) &&
+		       verifier.EndInfo();
+	}
+};
+
+template<> struct KeyValue::FieldTraits<KeyValue::Field_key> {
+	typedef const megrez::String * type;
+	static constexpr const char *name() { return "key"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 4; }
+	static type Get(const KeyValue *o) { return o->key(); }
+};
+template<> struct KeyValue::FieldTraits<KeyValue::Field_value> {
+	typedef const megrez::String * type;
+	static constexpr const char *name() { return "value"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 6; }
+	static type Get(const KeyValue *o) { return o->value(); }
+};
+template<typename V> inline void KeyValue::VisitFields(V &&v) const {
+	v(FieldTraits<Field_key>(), key());
+	v(FieldTraits<Field_value>(), value());
+}
+
+struct KeyValueView : public megrez::InfoView<2> {
+	explicit KeyValueView(const KeyValue *info = nullptr) : megrez::InfoView<2>(info) {}
+	const megrez::String *key() const { return GetPointer<const megrez::String *>(0); }
+	const megrez::String *value() const { return GetPointer<const megrez::String *>(1); }
+};
+
+struct KeyValueBuilder {
+	megrez::MegrezBuilder &mb_;
+	megrez::uofs_t start_;
+	void add_key(megrez::Offset<megrez::String> key) { mb_.AddOffset(4, key); }
+	void add_value(megrez::Offset<megrez::String> value) { mb_.AddOffset(6, value); }
+	KeyValueBuilder(megrez::MegrezBuilder &_mb) : mb_(_mb) { start_ = mb_.StartInfo(); }
+	megrez::Offset<KeyValue> Finish() { return megrez::Offset<KeyValue>(mb_.EndInfo(start_, 2)); }
+};
+
+inline megrez::Offset<KeyValue> CreateKeyValue(
+	  megrez::MegrezBuilder &_mb,
+	  megrez::Offset<megrez::String> key,
+	  megrez::Offset<megrez::String> value) {
+
+	KeyValueBuilder builder_(_mb);
+	builder_.add_value(value);
+	builder_.add_key(key);
+	return builder_.Finish();
+}
+
+inline size_t CreateKeyValueSizeUpperBound(
+	  megrez::Offset<megrez::String>,
+	  megrez::Offset<megrez::String>) {
+	return megrez::InfoSizeUpperBound(2, 14);
+}
+
+inline megrez::Offset<KeyValue> CreateKeyValue(
+	  megrez::MegrezBuilder &_mb,
+	  megrez::StringRef key,
+	  megrez::StringRef value) {
+	auto key__ = _mb.CreateString(key);
+	auto value__ = _mb.CreateString(value);
+	return CreateKeyValue(_mb, key__, value__);
+}
+
+inline size_t CreateKeyValueSizeUpperBound(
+	  megrez::StringRef key,
+	  megrez::StringRef value) {
+	return megrez::InfoSizeUpperBound(2, 14) +
+		(key.data() ? megrez::StringSizeUpperBound(key.size()) : 0) +
+		(value.data() ? megrez::StringSizeUpperBound(value.size()) : 0);
+}
+
+struct EnumVal : private megrez::Info {
+	const megrez::String *name() const { return GetPointer<const megrez::String *>(4); }
+	megrez::String *mutable_name() { return GetMutablePointer<megrez::String>(4); }
+	int64_t value() const { return GetField<int64_t>(6, 0); }
+	bool mutate_value(int64_t value) { return SetField<int64_t>(6, value); }
+	int32_t object() const { return GetField<int32_t>(8, -1); }
+	bool mutate_object(int32_t object) { return SetField<int32_t>(8, object); }
+	megrez::NativePtr<EnumValT> UnPack(megrez::NativeArena *arena = nullptr) const;
+	void UnPackTo(EnumValT *_o) const;
+	static megrez::Offset<EnumVal> Pack(megrez::MegrezBuilder &_mb, const EnumValT &_o);
+	enum {
+		Field_name = 0,
+		Field_value = 1,
+		Field_object = 2,
+	};
+	template<int F> struct FieldTraits;
+	template<int F> typename FieldTraits<F>::type Get() const { return FieldTraits<F>::Get(this); }
+	template<typename V> void VisitFields(V &&v) const;
+	bool Verify(megrez::Verifier &verifier) const {
+		return VerifyInfoStart(verifier) &&
+		       VerifyOffset(verifier, 4) && verifier.VerifyString(name()) &&
+		       VerifyField<int64_t>(verifier, 6) &&
+		       VerifyField<int32_t>(verifier, 8) &&
+		       verifier.EndInfo();
+	}
+};
+
+template<> struct EnumVal::FieldTraits<EnumVal::Field_name> {
+	typedef const megrez::String * type;
+	static constexpr const char *name() { return "name"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 4; }
+	static type Get(const EnumVal *o) { return o->name(); }
+};
+template<> struct EnumVal::FieldTraits<EnumVal::Field_value> {
+	typedef int64_t type;
+	static constexpr const char *name() { return "value"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 6; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const EnumVal *o) { return o->value(); }
+};
+template<> struct EnumVal::FieldTraits<EnumVal::Field_object> {
+	typedef int32_t type;
+	static constexpr const char *name() { return "object"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 8; }
+	static constexpr type default_value() { return -1; }
+	static type Get(const EnumVal *o) { return o->object(); }
+};
+template<typename V> inline void EnumVal::VisitFields(V &&v) const {
+	v(FieldTraits<Field_name>(), name());
+	v(FieldTraits<Field_value>(), value());
+	v(FieldTraits<Field_object>(), object());
+}
+
+struct EnumValView : public megrez::InfoView<3> {
+	explicit EnumValView(const EnumVal *info = nullptr) : megrez::InfoView<3>(info) {}
+	const megrez::String *name() const { return GetPointer<const megrez::String *>(0); }
+	int64_t value() const { return GetField<int64_t>(1, 0); }
+	int32_t object() const { return GetField<int32_t>(2, -1); }
+};
+
+struct EnumValBuilder {
+	megrez::MegrezBuilder &mb_;
+	megrez::uofs_t start_;
+	void add_name(megrez::Offset<megrez::String> name) { mb_.AddOffset(4, name); }
+	void add_value(int64_t value) { mb_.AddElement<int64_t>(6, value, 0); }
+	void add_object(int32_t object) { mb_.AddElement<int32_t>(8, object, -1); }
+	EnumValBuilder(megrez::MegrezBuilder &_mb) : mb_(_mb) { start_ = mb_.StartInfo(); }
+	megrez::Offset<EnumVal> Finish() { return megrez::Offset<EnumVal>(mb_.EndInfo(start_, 3)); }
+};
+
+inline megrez::Offset<EnumVal> CreateEnumVal(
+	  megrez::MegrezBuilder &_mb,
+	  megrez::Offset<megrez::String> name,
+	  int64_t value,
+	  int32_t object) {
+
+	EnumValBuilder builder_(_mb);
+	builder_.add_value(value);
+	builder_.add_object(object);
+	builder_.add_name(name);
+	return builder_.Finish();
+}
+
+inline size_t CreateEnumValSizeUpperBound(
+	  megrez::Offset<megrez::String>,
+	  int64_t,
+	  int32_t) {
+	return megrez::InfoSizeUpperBound(3, 29);
+}
+
+inline megrez::Offset<EnumVal> CreateEnumVal(
+	  megrez::MegrezBuilder &_mb,
+	  megrez::StringRef name,
+	  int64_t value,
+	  int32_t object) {
+	auto name__ = _mb.CreateString(name);
+	return CreateEnumVal(_mb, name__, value, object);
+}
+
+inline size_t CreateEnumValSizeUpperBound(
+	  megrez::StringRef name,
+	  int64_t,
+	  int32_t) {
+	return megrez::InfoSizeUpperBound(3, 29) +
+		(name.data() ? megrez::StringSizeUpperBound(name.size()) : 0);
+}
+
+struct Enum : private megrez::Info {
+	const megrez::String *name() const { return GetPointer<const megrez::String *>(4); }
+	megrez::String *mutable_name() { return GetMutablePointer<megrez::String>(4); }
+	const megrez::Vector<megrez::Offset<EnumVal>> *values() const { return GetPointer<const megrez::Vector<megrez::Offset<EnumVal>> *>(6); }
+	megrez::Vector<megrez::Offset<EnumVal>> *mutable_values() { return GetMutablePointer<megrez::Vector<megrez::Offset<EnumVal>>>(6); }
+	uint8_t is_union() const { return GetField<uint8_t>(8, 0); }
+	bool mutate_is_union(uint8_t is_union) { return SetField<uint8_t>(8, is_union); }
+	const Type *underlying_type() const { return GetPointer<const Type *>(10); }
+	Type *mutable_underlying_type() { return GetMutablePointer<Type>(10); }
+	const megrez::Vector<megrez::Offset<KeyValue>> *attributes() const { return GetPointer<const megrez::Vector<megrez::Offset<KeyValue>> *>(12); }
+	megrez::Vector<megrez::Offset<KeyValue>> *mutable_attributes() { return GetMutablePointer<megrez::Vector<megrez::Offset<KeyValue>>>(12); }
+	bool KeyCompareLessThan(const Enum *o) const { return megrez::CompareStrings(name(), o->name()) < 0; }
+	int KeyCompareWithValue(megrez::StringRef val) const { return megrez::CompareStrings(name(), val); }
+	megrez::NativePtr<EnumT> UnPack(megrez::NativeArena *arena = nullptr) const;
+	void UnPackTo(EnumT *_o) const;
+	static megrez::Offset<Enum> Pack(megrez::MegrezBuilder &_mb, const EnumT &_o);
+	enum {
+		Field_name = 0,
+		Field_values = 1,
+		Field_is_union = 2,
+		Field_underlying_type = 3,
+		Field_attributes = 4,
+	};
+	template<int F> struct FieldTraits;
+	template<int F> typename FieldTraits<F>::type Get() const { return FieldTraits<F>::Get(this); }
+	template<typename V> void VisitFields(V &&v) const;
+	bool Verify(megrez::Verifier &verifier) const {
+		return VerifyInfoStart(verifier) &&
+		       VerifyOffset(verifier, 4) && verifier.VerifyString(name()) &&
+		       VerifyOffset(verifier, 6) && verifier.VerifyVector(values()) && verifier.VerifyVectorOfInfos(values()) &&
+		       VerifyField<uint8_t>(verifier, 8) &&
+		       VerifyOffset(verifier, 10) && verifier.VerifyInfo(underlying_type()) &&
+		       VerifyOffset(verifier, 12) && verifier.VerifyVector(attributes()) && verifier.VerifyVectorOfInfos(attributes()) &&
+		       verifier.EndInfo();
+	}
+};
+
+template<> struct Enum::FieldTraits<Enum::Field_name> {
+	typedef const megrez::String * type;
+	static constexpr const char *name() { return "name"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 4; }
+	static type Get(const Enum *o) { return o->name(); }
+};
+template<> struct Enum::FieldTraits<Enum::Field_values> {
+	typedef const megrez::Vector<megrez::Offset<EnumVal>> * type;
+	static constexpr const char *name() { return "values"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 6; }
+	static type Get(const Enum *o) { return o->values(); }
+};
+template<> struct Enum::FieldTraits<Enum::Field_is_union> {
+	typedef uint8_t type;
+	static constexpr const char *name() { return "is_union"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 8; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const Enum *o) { return o->is_union(); }
+};
+template<> struct Enum::FieldTraits<Enum::Field_underlying_type> {
+	typedef const Type * type;
+	static constexpr const char *name() { return "underlying_type"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 10; }
+	static type Get(const Enum *o) { return o->underlying_type(); }
+};
+template<> struct Enum::FieldTraits<Enum::Field_attributes> {
+	typedef const megrez::Vector<megrez::Offset<KeyValue>> * type;
+	static constexpr const char *name() { return "attributes"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 12; }
+	static type Get(const Enum *o) { return o->attributes(); }
+};
+template<typename V> inline void Enum::VisitFields(V &&v) const {
+	v(FieldTraits<Field_name>(), name());
+	v(FieldTraits<Field_values>(), values());
+	v(FieldTraits<Field_is_union>(), is_union());
+	v(FieldTraits<Field_underlying_type>(), underlying_type());
+	v(FieldTraits<Field_attributes>(), attributes());
+}
+
+struct EnumView : public megrez::InfoView<5> {
+	explicit EnumView(const Enum *info = nullptr) : megrez::InfoView<5>(info) {}
+	const megrez::String *name() const { return GetPointer<const megrez::String *>(0); }
+	const megrez::Vector<megrez::Offset<EnumVal>> *values() const { return GetPointer<const megrez::Vector<megrez::Offset<EnumVal>> *>(1); }
+	uint8_t is_union() const { return GetField<uint8_t>(2, 0); }
+	const Type *underlying_type() const { return GetPointer<const Type *>(3); }
+	const megrez::Vector<megrez::Offset<KeyValue>> *attributes() const { return GetPointer<const megrez::Vector<megrez::Offset<KeyValue>> *>(4); }
+};
+
+struct EnumBuilder {
+	megrez::MegrezBuilder &mb_;
+	megrez::uofs_t start_;
+	void add_name(megrez::Offset<megrez::String> name) { mb_.AddOffset(4, name); }
+	void add_values(megrez::Offset<megrez::Vector<megrez::Offset<EnumVal>>> values) { mb_.AddOffset(6, values); }
+	void add_is_union(uint8_t is_union) { mb_.AddElement<uint8_t>(8, is_union, 0); }
+	void add_underlying_type(megrez::Offset<Type> underlying_type) { mb_.AddOffset(10, underlying_type); }
+	void add_attributes(megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>> attributes) { mb_.AddOffset(12, attributes); }
+	EnumBuilder(megrez::MegrezBuilder &_mb) : mb_(_mb) { start_ = mb_.StartInfo(); }
+	megrez::Offset<Enum> Finish() { return megrez::Offset<Enum>(mb_.EndInfo(start_, 5)); }
+};
+
+inline megrez::Offset<Enum> CreateEnum(
+	  megrez::MegrezBuilder &_mb,
+	  megrez::Offset<megrez::String> name,
+	  megrez::Offset<megrez::Vector<megrez::Offset<EnumVal>>> values,
+	  uint8_t is_union,
+	  megrez::Offset<Type> underlying_type,
+	  megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>> attributes) {
+
+	EnumBuilder builder_(_mb);
+	builder_.add_attributes(attributes);
+	builder_.add_underlying_type(underlying_type);
+	builder_.add_values(values);
+	builder_.add_name(name);
+	builder_.add_is_union(is_union);
+	return builder_.Finish();
+}
+
+inline size_t CreateEnumSizeUpperBound(
+	  megrez::Offset<megrez::String>,
+	  megrez::Offset<megrez::Vector<megrez::Offset<EnumVal>>>,
+	  uint8_t,
+	  megrez::Offset<Type>,
+	  megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>>) {
+	return megrez::InfoSizeUpperBound(5, 29);
+}
+
+inline megrez::Offset<Enum> CreateEnum(
+	  megrez::MegrezBuilder &_mb,
+	  megrez::StringRef name,
+	  megrez::Offset<megrez::Vector<megrez::Offset<EnumVal>>> values,
+	  uint8_t is_union,
+	  megrez::Offset<Type> underlying_type,
+	  megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>> attributes) {
+	auto name__ = _mb.CreateString(name);
+	return CreateEnum(_mb, name__, values, is_union, underlying_type, attributes);
+}
+
+inline size_t CreateEnumSizeUpperBound(
+	  megrez::StringRef name,
+	  megrez::Offset<megrez::Vector<megrez::Offset<EnumVal>>>,
+	  uint8_t,
+	  megrez::Offset<Type>,
+	  megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>>) {
+	return megrez::InfoSizeUpperBound(5, 29) +
+		(name.data() ? megrez::StringSizeUpperBound(name.size()) : 0);
+}
+
+struct Field : private megrez::Info {
+	const megrez::String *name() const { return GetPointer<const megrez::String *>(4); }
+	megrez::String *mutable_name() { return GetMutablePointer<megrez::String>(4); }
+	const Type *type() const { return GetPointer<const Type *>(6); }
+	Type *mutable_type() { return GetMutablePointer<Type>(6); }
+	uint16_t id() const { return GetField<uint16_t>(8, 0); }
+	bool mutate_id(uint16_t id) { return SetField<uint16_t>(8, id); }
+	uint16_t offset() const { return GetField<uint16_t>(10, 0); }
+	bool mutate_offset(uint16_t offset) { return SetField<uint16_t>(10, offset); }
+	int64_t default_integer() const { return GetField<int64_t>(12, 0); }
+	bool mutate_default_integer(int64_t default_integer) { return SetField<int64_t>(12, default_integer); }
+	double default_real() const { return GetField<double>(14, 0); }
+	bool mutate_default_real(double default_real) { return SetField<double>(14, default_real); }
+	uint8_t deprecated() const { return GetField<uint8_t>(16, 0); }
+	bool mutate_deprecated(uint8_t deprecated) { return SetField<uint8_t>(16, deprecated); }
+	uint8_t key() const { return GetField<uint8_t>(18, 0); }
+	bool mutate_key(uint8_t key) { return SetField<uint8_t>(18, key); }
+	const megrez::Vector<megrez::Offset<KeyValue>> *attributes() const { return GetPointer<const megrez::Vector<megrez::Offset<KeyValue>> *>(20); }
+	megrez::Vector<megrez::Offset<KeyValue>> *mutable_attributes() { return GetMutablePointer<megrez::Vector<megrez::Offset<KeyValue>>>(20); }
+	bool KeyCompareLessThan(const Field *o) const { return megrez::CompareStrings(name(), o->name()) < 0; }
+	int KeyCompareWithValue(megrez::StringRef val) const { return megrez::CompareStrings(name(), val); }
+	megrez::NativePtr<FieldT> UnPack(megrez::NativeArena *arena = nullptr) const;
+	void UnPackTo(FieldT *_o) const;
+	static megrez::Offset<Field> Pack(megrez::MegrezBuilder &_mb, const FieldT &_o);
+	enum {
+		Field_name = 0,
+		Field_type = 1,
+		Field_id = 2,
+		Field_offset = 3,
+		Field_default_integer = 4,
+		Field_default_real = 5,
+		Field_deprecated = 6,
+		Field_key = 7,
+		Field_attributes = 8,
+	};
+	template<int F> struct FieldTraits;
+	template<int F> typename FieldTraits<F>::type Get() const { return FieldTraits<F>::Get(this); }
+	template<typename V> void VisitFields(V &&v) const;
+	bool Verify(megrez::Verifier &verifier) const {
+		return VerifyInfoStart(verifier) &&
+		       VerifyOffset(verifier, 4) && verifier.VerifyString(name()) &&
+		       VerifyOffset(verifier, 6) && verifier.VerifyInfo(type()) &&
+		       VerifyField<uint16_t>(verifier, 8) &&
+		       VerifyField<uint16_t>(verifier, 10) &&
+		       VerifyField<int64_t>(verifier, 12) &&
+		       VerifyField<double>(verifier, 14) &&
+		       VerifyField<uint8_t>(verifier, 16) &&
+		       VerifyField<uint8_t>(verifier, 18) &&
+		       VerifyOffset(verifier, 20) && verifier.VerifyVector(attributes()) && verifier.VerifyVectorOfInfos(attributes()) &&
+		       verifier.EndInfo();
+	}
+};
+
+template<> struct Field::FieldTraits<Field::Field_name> {
+	typedef const megrez::String * type;
+	static constexpr const char *name() { return "name"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 4; }
+	static type Get(const Field *o) { return o->name(); }
+};
+template<> struct Field::FieldTraits<Field::Field_type> {
+	typedef const Type * type;
+	static constexpr const char *name() { return "type"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 6; }
+	static type Get(const Field *o) { return o->type(); }
+};
+template<> struct Field::FieldTraits<Field::Field_id> {
+	typedef uint16_t type;
+	static constexpr const char *name() { return "id"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 8; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const Field *o) { return o->id(); }
+};
+template<> struct Field::FieldTraits<Field::Field_offset> {
+	typedef uint16_t type;
+	static constexpr const char *name() { return "offset"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 10; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const Field *o) { return o->offset(); }
+};
+template<> struct Field::FieldTraits<Field::Field_default_integer> {
+	typedef int64_t type;
+	static constexpr const char *name() { return "default_integer"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 12; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const Field *o) { return o->default_integer(); }
+};
+template<> struct Field::FieldTraits<Field::Field_default_real> {
+	typedef double type;
+	static constexpr const char *name() { return "default_real"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 14; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const Field *o) { return o->default_real(); }
+};
+template<> struct Field::FieldTraits<Field::Field_deprecated> {
+	typedef uint8_t type;
+	static constexpr const char *name() { return "deprecated"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 16; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const Field *o) { return o->deprecated(); }
+};
+template<> struct Field::FieldTraits<Field::Field_key> {
+	typedef uint8_t type;
+	static constexpr const char *name() { return "key"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 18; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const Field *o) { return o->key(); }
+};
+template<> struct Field::FieldTraits<Field::Field_attributes> {
+	typedef const megrez::Vector<megrez::Offset<KeyValue>> * type;
+	static constexpr const char *name() { return "attributes"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 20; }
+	static type Get(const Field *o) { return o->attributes(); }
+};
+template<typename V> inline void Field::VisitFields(V &&v) const {
+	v(FieldTraits<Field_name>(), name());
+	v(FieldTraits<Field_type>(), type());
+	v(FieldTraits<Field_id>(), id());
+	v(FieldTraits<Field_offset>(), offset());
+	v(FieldTraits<Field_default_integer>(), default_integer());
+	v(FieldTraits<Field_default_real>(), default_real());
+	v(FieldTraits<Field_deprecated>(), deprecated());
+	v(FieldTraits<Field_key>(), key());
+	v(FieldTraits<Field_attributes>(), attributes());
+}
+
+struct FieldView : public megrez::InfoView<9> {
+	explicit FieldView(const Field *info = nullptr) : megrez::InfoView<9>(info) {}
+	const megrez::String *name() const { return GetPointer<const megrez::String *>(0); }
+	const Type *type() const { return GetPointer<const Type *>(1); }
+	uint16_t id() const { return GetField<uint16_t>(2, 0); }
+	uint16_t offset() const { return GetField<uint16_t>(3, 0); }
+	int64_t default_integer() const { return GetField<int64_t>(4, 0); }
+	double default_real() const { return GetField<double>(5, 0); }
+	uint8_t deprecated() const { return GetField<uint8_t>(6, 0); }
+	uint8_t key() const { return GetField<uint8_t>(7, 0); }
+	const megrez::Vector<megrez::Offset<KeyValue>> *attributes() const { return GetPointer<const megrez::Vector<megrez::Offset<KeyValue>> *>(8); }
+};
+
+struct FieldBuilder {
+	megrez::MegrezBuilder &mb_;
+	megrez::uofs_t start_;
+	void add_name(megrez::Offset<megrez::String> name) { mb_.AddOffset(4, name); }
+	void add_type(megrez::Offset<Type> type) { mb_.AddOffset(6, type); }
+	void add_id(uint16_t id) { mb_.AddElement<uint16_t>(8, id, 0); }
+	void add_offset(uint16_t offset) { mb_.AddElement<uint16_t>(10, offset, 0); }
+	void add_default_integer(int64_t default_integer) { mb_.AddElement<int64_t>(12, default_integer, 0); }
+	void add_default_real(double default_real) { mb_.AddElement<double>(14, default_real, 0); }
+	void add_deprecated(uint8_t deprecated) { mb_.AddElement<uint8_t>(16, deprecated, 0); }
+	void add_key(uint8_t key) { mb_.AddElement<uint8_t>(18, key, 0); }
+	void add_attributes(megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>> attributes) { mb_.AddOffset(20, attributes); }
+	FieldBuilder(megrez::MegrezBuilder &_mb) : mb_(_mb) { start_ = mb_.StartInfo(); }
+	megrez::Offset<Field> Finish() { return megrez::Offset<Field>(mb_.EndInfo(start_, 9)); }
+};
+
+inline megrez::Offset<Field> CreateField(
+	  megrez::MegrezBuilder &_mb,
+	  megrez::Offset<megrez::String> name,
+	  megrez::Offset<Type> type,
+	  uint16_t id,
+	  uint16_t offset,
+	  int64_t default_integer,
+	  double default_real,
+	  uint8_t deprecated,
+	  uint8_t key,
+	  megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>> attributes) {
+
+	FieldBuilder builder_(_mb);
+	builder_.add_default_real(default_real);
+	builder_.add_default_integer(default_integer);
+	builder_.add_attributes(attributes);
+	builder_.add_type(type);
+	builder_.add_name(name);
+	builder_.add_offset(offset);
+	builder_.add_id(id);
+	builder_.add_key(key);
+	builder_.add_deprecated(deprecated);
+	return builder_.Finish();
+}
+
+inline size_t CreateFieldSizeUpperBound(
+	  megrez::Offset<megrez::String>,
+	  megrez::Offset<Type>,
+	  uint16_t,
+	  uint16_t,
+	  int64_t,
+	  double,
+	  uint8_t,
+	  uint8_t,
+	  megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>>) {
+	return megrez::InfoSizeUpperBound(9, 59);
+}
+
+inline megrez::Offset<Field> CreateField(
+	  megrez::MegrezBuilder &_mb,
+	  megrez::StringRef name,
+	  megrez::Offset<Type> type,
+	  uint16_t id,
+	  uint16_t offset,
+	  int64_t default_integer,
+	  double default_real,
+	  uint8_t deprecated,
+	  uint8_t key,
+	  megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>> attributes) {
+	auto name__ = _mb.CreateString(name);
+	return CreateField(_mb, name__, type, id, offset, default_integer, default_real, deprecated, key, attributes);
+}
+
+inline size_t CreateFieldSizeUpperBound(
+	  megrez::StringRef name,
+	  megrez::Offset<Type>,
+	  uint16_t,
+	  uint16_t,
+	  int64_t,
+	  double,
+	  uint8_t,
+	  uint8_t,
+	  megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>>) {
+	return megrez::InfoSizeUpperBound(9, 59) +
+		(name.data() ? megrez::StringSizeUpperBound(name.size()) : 0);
+}
+
+struct Object : private megrez::Info {
+	const megrez::String *name() const { return GetPointer<const megrez::String *>(4); }
+	megrez::String *mutable_name() { return GetMutablePointer<megrez::String>(4); }
+	const megrez::Vector<megrez::Offset<Field>> *fields() const { return GetPointer<const megrez::Vector<megrez::Offset<Field>> *>(6); }
+	megrez::Vector<megrez::Offset<Field>> *mutable_fields() { return GetMutablePointer<megrez::Vector<megrez::Offset<Field>>>(6); }
+	uint8_t is_struct() const { return GetField<uint8_t>(8, 0); }
+	bool mutate_is_struct(uint8_t is_struct) { return SetField<uint8_t>(8, is_struct); }
+	int32_t minalign() const { return GetField<int32_t>(10, 0); }
+	bool mutate_minalign(int32_t minalign) { return SetField<int32_t>(10, minalign); }
+	int32_t bytesize() const { return GetField<int32_t>(12, 0); }
+	bool mutate_bytesize(int32_t bytesize) { return SetField<int32_t>(12, bytesize); }
+	const megrez::Vector<megrez::Offset<KeyValue>> *attributes() const { return GetPointer<const megrez::Vector<megrez::Offset<KeyValue>> *>(14); }
+	megrez::Vector<megrez::Offset<KeyValue>> *mutable_attributes() { return GetMutablePointer<megrez::Vector<megrez::Offset<KeyValue>>>(14); }
+	bool KeyCompareLessThan(const Object *o) const { return megrez::CompareStrings(name(), o->name()) < 0; }
+	int KeyCompareWithValue(megrez::StringRef val) const { return megrez::CompareStrings(name(), val); }
+	megrez::NativePtr<ObjectT> UnPack(megrez::NativeArena *arena = nullptr) const;
+	void UnPackTo(ObjectT *_o) const;
+	static megrez::Offset<Object> Pack(megrez::MegrezBuilder &_mb, const ObjectT &_o);
+	enum {
+		Field_name = 0,
+		Field_fields = 1,
+		Field_is_struct = 2,
+		Field_minalign = 3,
+		Field_bytesize = 4,
+		Field_attributes = 5,
+	};
+	template<int F> struct FieldTraits;
+	template<int F> typename FieldTraits<F>::type Get() const { return FieldTraits<F>::Get(this); }
+	template<typename V> void VisitFields(V &&v) const;
+	bool Verify(megrez::Verifier &verifier) const {
+		return VerifyInfoStart(verifier) &&
+		       VerifyOffset(verifier, 4) && verifier.VerifyString(name()) &&
+		       VerifyOffset(verifier, 6) && verifier.VerifyVector(fields()) && verifier.VerifyVectorOfInfos(fields()) &&
+		       VerifyField<uint8_t>(verifier, 8) &&
+		       VerifyField<int32_t>(verifier, 10) &&
+		       VerifyField<int32_t>(verifier, 12) &&
+		       VerifyOffset(verifier, 14) && verifier.VerifyVector(attributes()) && verifier.VerifyVectorOfInfos(attributes()) &&
+		       verifier.EndInfo();
+	}
+};
+
+template<> struct Object::FieldTraits<Object::Field_name> {
+	typedef const megrez::String * type;
+	static constexpr const char *name() { return "name"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 4; }
+	static type Get(const Object *o) { return o->name(); }
+};
+template<> struct Object::FieldTraits<Object::Field_fields> {
+	typedef const megrez::Vector<megrez::Offset<Field>> * type;
+	static constexpr const char *name() { return "fields"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 6; }
+	static type Get(const Object *o) { return o->fields(); }
+};
+template<> struct Object::FieldTraits<Object::Field_is_struct> {
+	typedef uint8_t type;
+	static constexpr const char *name() { return "is_struct"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 8; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const Object *o) { return o->is_struct(); }
+};
+template<> struct Object::FieldTraits<Object::Field_minalign> {
+	typedef int32_t type;
+	static constexpr const char *name() { return "minalign"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 10; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const Object *o) { return o->minalign(); }
+};
+template<> struct Object::FieldTraits<Object::Field_bytesize> {
+	typedef int32_t type;
+	static constexpr const char *name() { return "bytesize"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 12; }
+	static constexpr type default_value() { return 0; }
+	static type Get(const Object *o) { return o->bytesize(); }
+};
+template<> struct Object::FieldTraits<Object::Field_attributes> {
+	typedef const megrez::Vector<megrez::Offset<KeyValue>> * type;
+	static constexpr const char *name() { return "attributes"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 14; }
+	static type Get(const Object *o) { return o->attributes(); }
+};
+template<typename V> inline void Object::VisitFields(V &&v) const {
+	v(FieldTraits<Field_name>(), name());
+	v(FieldTraits<Field_fields>(), fields());
+	v(FieldTraits<Field_is_struct>(), is_struct());
+	v(FieldTraits<Field_minalign>(), minalign());
+	v(FieldTraits<Field_bytesize>(), bytesize());
+	v(FieldTraits<Field_attributes>(), attributes());
+}
+
+struct ObjectView : public megrez::InfoView<6> {
+	explicit ObjectView(const Object *info = nullptr) : megrez::InfoView<6>(info) {}
+	const megrez::String *name() const { return GetPointer<const megrez::String *>(0); }
+	const megrez::Vector<megrez::Offset<Field>> *fields() const { return GetPointer<const megrez::Vector<megrez::Offset<Field>> *>(1); }
+	uint8_t is_struct() const { return GetField<uint8_t>(2, 0); }
+	int32_t minalign() const { return GetField<int32_t>(3, 0); }
+	int32_t bytesize() const { return GetField<int32_t>(4, 0); }
+	const megrez::Vector<megrez::Offset<KeyValue>> *attributes() const { return GetPointer<const megrez::Vector<megrez::Offset<KeyValue>> *>(5); }
+};
+
+struct ObjectBuilder {
+	megrez::MegrezBuilder &mb_;
+	megrez::uofs_t start_;
+	void add_name(megrez::Offset<megrez::String> name) { mb_.AddOffset(4, name); }
+	void add_fields(megrez::Offset<megrez::Vector<megrez::Offset<Field>>> fields) { mb_.AddOffset(6, fields); }
+	void add_is_struct(uint8_t is_struct) { mb_.AddElement<uint8_t>(8, is_struct, 0); }
+	void add_minalign(int32_t minalign) { mb_.AddElement<int32_t>(10, minalign, 0); }
+	void add_bytesize(int32_t bytesize) { mb_.AddElement<int32_t>(12, bytesize, 0); }
+	void add_attributes(megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>> attributes) { mb_.AddOffset(14, attributes); }
+	ObjectBuilder(megrez::MegrezBuilder &_mb) : mb_(_mb) { start_ = mb_.StartInfo(); }
+	megrez::Offset<Object> Finish() { return megrez::Offset<Object>(mb_.EndInfo(start_, 6)); }
+};
+
+inline megrez::Offset<Object> CreateObject(
+	  megrez::MegrezBuilder &_mb,
+	  megrez::Offset<megrez::String> name,
+	  megrez::Offset<megrez::Vector<megrez::Offset<Field>>> fields,
+	  uint8_t is_struct,
+	  int32_t minalign,
+	  int32_t bytesize,
+	  megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>> attributes) {
+
+	ObjectBuilder builder_(_mb);
+	builder_.add_attributes(attributes);
+	builder_.add_bytesize(bytesize);
+	builder_.add_minalign(minalign);
+	builder_.add_fields(fields);
+	builder_.add_name(name);
+	builder_.add_is_struct(is_struct);
+	return builder_.Finish();
+}
+
+inline size_t CreateObjectSizeUpperBound(
+	  megrez::Offset<megrez::String>,
+	  megrez::Offset<megrez::Vector<megrez::Offset<Field>>>,
+	  uint8_t,
+	  int32_t,
+	  int32_t,
+	  megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>>) {
+	return megrez::InfoSizeUpperBound(6, 36);
+}
+
+inline megrez::Offset<Object> CreateObject(
+	  megrez::MegrezBuilder &_mb,
+	  megrez::StringRef name,
+	  megrez::Offset<megrez::Vector<megrez::Offset<Field>>> fields,
+	  uint8_t is_struct,
+	  int32_t minalign,
+	  int32_t bytesize,
+	  megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>> attributes) {
+	auto name__ = _mb.CreateString(name);
+	return CreateObject(_mb, name__, fields, is_struct, minalign, bytesize, attributes);
+}
+
+inline size_t CreateObjectSizeUpperBound(
+	  megrez::StringRef name,
+	  megrez::Offset<megrez::Vector<megrez::Offset<Field>>>,
+	  uint8_t,
+	  int32_t,
+	  int32_t,
+	  megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>>) {
+	return megrez::InfoSizeUpperBound(6, 36) +
+		(name.data() ? megrez::StringSizeUpperBound(name.size()) : 0);
+}
+
+struct Schema : private megrez::Info {
+	const megrez::Vector<megrez::Offset<Object>> *objects() const { return GetPointer<const megrez::Vector<megrez::Offset<Object>> *>(4); }
+	megrez::Vector<megrez::Offset<Object>> *mutable_objects() { return GetMutablePointer<megrez::Vector<megrez::Offset<Object>>>(4); }
+	const megrez::Vector<megrez::Offset<Enum>> *enums() const { return GetPointer<const megrez::Vector<megrez::Offset<Enum>> *>(6); }
+	megrez::Vector<megrez::Offset<Enum>> *mutable_enums() { return GetMutablePointer<megrez::Vector<megrez::Offset<Enum>>>(6); }
+	const megrez::String *name_space() const { return GetPointer<const megrez::String *>(8); }
+	megrez::String *mutable_name_space() { return GetMutablePointer<megrez::String>(8); }
+	int32_t main_object() const { return GetField<int32_t>(10, -1); }
+	bool mutate_main_object(int32_t main_object) { return SetField<int32_t>(10, main_object); }
+	megrez::NativePtr<SchemaT> UnPack(megrez::NativeArena *arena = nullptr) const;
+	void UnPackTo(SchemaT *_o) const;
+	static megrez::Offset<Schema> Pack(megrez::MegrezBuilder &_mb, const SchemaT &_o);
+	enum {
+		Field_objects = 0,
+		Field_enums = 1,
+		Field_name_space = 2,
+		Field_main_object = 3,
+	};
+	template<int F> struct FieldTraits;
+	template<int F> typename FieldTraits<F>::type Get() const { return FieldTraits<F>::Get(this); }
+	template<typename V> void VisitFields(V &&v) const;
+	bool Verify(megrez::Verifier &verifier) const {
+		return VerifyInfoStart(verifier) &&
+		       VerifyOffset(verifier, 4) && verifier.VerifyVector(objects()) && verifier.VerifyVectorOfInfos(objects()) &&
+		       VerifyOffset(verifier, 6) && verifier.VerifyVector(enums()) && verifier.VerifyVectorOfInfos(enums()) &&
+		       VerifyOffset(verifier, 8) && verifier.VerifyString(name_space()) &&
+		       VerifyField<int32_t>(verifier, 10) &&
+		       verifier.EndInfo();
+	}
+};
+
+template<> struct Schema::FieldTraits<Schema::Field_objects> {
+	typedef const megrez::Vector<megrez::Offset<Object>> * type;
+	static constexpr const char *name() { return "objects"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 4; }
+	static type Get(const Schema *o) { return o->objects(); }
+};
+template<> struct Schema::FieldTraits<Schema::Field_enums> {
+	typedef const megrez::Vector<megrez::Offset<Enum>> * type;
+	static constexpr const char *name() { return "enums"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 6; }
+	static type Get(const Schema *o) { return o->enums(); }
+};
+template<> struct Schema::FieldTraits<Schema::Field_name_space> {
+	typedef const megrez::String * type;
+	static constexpr const char *name() { return "name_space"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 8; }
+	static type Get(const Schema *o) { return o->name_space(); }
+};
+template<> struct Schema::FieldTraits<Schema::Field_main_object> {
+	typedef int32_t type;
+	static constexpr const char *name() { return "main_object"; }
+	static constexpr megrez::vofs_t vtable_offset() { return 10; }
+	static constexpr type default_value() { return -1; }
+	static type Get(const Schema *o) { return o->main_object(); }
+};
+template<typename V> inline void Schema::VisitFields(V &&v) const {
+	v(FieldTraits<Field_objects>(), objects());
+	v(FieldTraits<Field_enums>(), enums());
+	v(FieldTraits<Field_name_space>(), name_space());
+	v(FieldTraits<Field_main_object>(), main_object());
+}
+
+struct SchemaView : public megrez::InfoView<4> {
+	explicit SchemaView(const Schema *info = nullptr) : megrez::InfoView<4>(info) {}
+	const megrez::Vector<megrez::Offset<Object>> *objects() const { return GetPointer<const megrez::Vector<megrez::Offset<Object>> *>(0); }
+	const megrez::Vector<megrez::Offset<Enum>> *enums() const { return GetPointer<const megrez::Vector<megrez::Offset<Enum>> *>(1); }
+	const megrez::String *name_space() const { return GetPointer<const megrez::String *>(2); }
+	int32_t main_object() const { return GetField<int32_t>(3, -1); }
+};
+
+struct SchemaBuilder {
+	megrez::MegrezBuilder &mb_;
+	megrez::uofs_t start_;
+	void add_objects(megrez::Offset<megrez::Vector<megrez::Offset<Object>>> objects) { mb_.AddOffset(4, objects); }
+	void add_enums(megrez::Offset<megrez::Vector<megrez::Offset<Enum>>> enums) { mb_.AddOffset(6, enums); }
+	void add_name_space(megrez::Offset<megrez::String> name_space) { mb_.AddOffset(8, name_space); }
+	void add_main_object(int32_t main_object) { mb_.AddElement<int32_t>(10, main_object, -1); }
+	SchemaBuilder(megrez::MegrezBuilder &_mb) : mb_(_mb) { start_ = mb_.StartInfo(); }
+	megrez::Offset<Schema> Finish() { return megrez::Offset<Schema>(mb_.EndInfo(start_, 4)); }
+};
+
+inline megrez::Offset<Schema> CreateSchema(
+	  megrez::MegrezBuilder &_mb,
+	  megrez::Offset<megrez::Vector<megrez::Offset<Object>>> objects,
+	  megrez::Offset<megrez::Vector<megrez::Offset<Enum>>> enums,
+	  megrez::Offset<megrez::String> name_space,
+	  int32_t main_object) {
+
+	SchemaBuilder builder_(_mb);
+	builder_.add_main_object(main_object);
+	builder_.add_name_space(name_space);
+	builder_.add_enums(enums);
+	builder_.add_objects(objects);
+	return builder_.Finish();
+}
+
+inline size_t CreateSchemaSizeUpperBound(
+	  megrez::Offset<megrez::Vector<megrez::Offset<Object>>>,
+	  megrez::Offset<megrez::Vector<megrez::Offset<Enum>>>,
+	  megrez::Offset<megrez::String>,
+	  int32_t) {
+	return megrez::InfoSizeUpperBound(4, 28);
+}
+
+inline megrez::Offset<Schema> CreateSchema(
+	  megrez::MegrezBuilder &_mb,
+	  megrez::Offset<megrez::Vector<megrez::Offset<Object>>> objects,
+	  megrez::Offset<megrez::Vector<megrez::Offset<Enum>>> enums,
+	  megrez::StringRef name_space,
+	  int32_t main_object) {
+	auto name_space__ = _mb.CreateString(name_space);
+	return CreateSchema(_mb, objects, enums, name_space__, main_object);
+}
+
+inline size_t CreateSchemaSizeUpperBound(
+	  megrez::Offset<megrez::Vector<megrez::Offset<Object>>>,
+	  megrez::Offset<megrez::Vector<megrez::Offset<Enum>>>,
+	  megrez::StringRef name_space,
+	  int32_t) {
+	return megrez::InfoSizeUpperBound(4, 28) +
+		(name_space.data() ? megrez::StringSizeUpperBound(name_space.size()) : 0);
+}
+
+struct TypeT {
+	typedef Type InfoType;
+	megrez::NativeArena *arena_;
+	uint8_t base_type;
+	uint8_t element;
+	int32_t index;
+	uint8_t compact;
+	explicit TypeT(megrez::NativeArena *arena = nullptr)
+		: arena_(arena), base_type(0), element(0), index(-1), compact(0) {}
+	size_t SerializedSizeUpperBound() const;
+};
+
+struct KeyValueT {
+	typedef KeyValue InfoType;
+	megrez::NativeArena *arena_;
+	megrez::NativeString key;
+	megrez::NativeString value;
+	explicit KeyValueT(megrez::NativeArena *arena = nullptr)
+		: arena_(arena), key(arena), value(arena) {}
+	size_t SerializedSizeUpperBound() const;
+};
+
+struct EnumValT {
+	typedef EnumVal InfoType;
+	megrez::NativeArena *arena_;
+	megrez::NativeString name;
+	int64_t value;
+	int32_t object;
+	explicit EnumValT(megrez::NativeArena *arena = nullptr)
+		: arena_(arena), name(arena), value(0), object(-1) {}
+	size_t SerializedSizeUpperBound() const;
+};
+
+struct EnumT {
+	typedef Enum InfoType;
+	megrez::NativeArena *arena_;
+	megrez::NativeString name;
+	megrez::NativeVector<megrez::NativePtr<EnumValT>> values;
+	uint8_t is_union;
+	megrez::NativePtr<TypeT> underlying_type;
+	megrez::NativeVector<megrez::NativePtr<KeyValueT>> attributes;
+	explicit EnumT(megrez::NativeArena *arena = nullptr)
+		: arena_(arena), name(arena), values(arena), is_union(0), attributes(arena) {}
+	size_t SerializedSizeUpperBound() const;
+};
+
+struct FieldT {
+	typedef Field InfoType;
+	megrez::NativeArena *arena_;
+	megrez::NativeString name;
+	megrez::NativePtr<TypeT> type;
+	uint16_t id;
+	uint16_t offset;
+	int64_t default_integer;
+	double default_real;
+	uint8_t deprecated;
+	uint8_t key;
+	megrez::NativeVector<megrez::NativePtr<KeyValueT>> attributes;
+	explicit FieldT(megrez::NativeArena *arena = nullptr)
+		: arena_(arena), name(arena), id(0), offset(0), default_integer(0), default_real(0), deprecated(0), key(0), attributes(arena) {}
+	size_t SerializedSizeUpperBound() const;
+};
+
+struct ObjectT {
+	typedef Object InfoType;
+	megrez::NativeArena *arena_;
+	megrez::NativeString name;
+	megrez::NativeVector<megrez::NativePtr<FieldT>> fields;
+	uint8_t is_struct;
+	int32_t minalign;
+	int32_t bytesize;
+	megrez::NativeVector<megrez::NativePtr<KeyValueT>> attributes;
+	explicit ObjectT(megrez::NativeArena *arena = nullptr)
+		: arena_(arena), name(arena), fields(arena), is_struct(0), minalign(0), bytesize(0), attributes(arena) {}
+	size_t SerializedSizeUpperBound() const;
+};
+
+struct SchemaT {
+	typedef Schema InfoType;
+	megrez::NativeArena *arena_;
+	megrez::NativeVector<megrez::NativePtr<ObjectT>> objects;
+	megrez::NativeVector<megrez::NativePtr<EnumT>> enums;
+	megrez::NativeString name_space;
+	int32_t main_object;
+	explicit SchemaT(megrez::NativeArena *arena = nullptr)
+		: arena_(arena), objects(arena), enums(arena), name_space(arena), main_object(-1) {}
+	size_t SerializedSizeUpperBound() const;
+};
+
+inline megrez::NativePtr<TypeT> Type::UnPack(megrez::NativeArena *arena) const {
+	auto _o = megrez::MakeNative<TypeT>(arena, arena);
+	UnPackTo(_o.get());
+	return _o;
+}
+
+inline void Type::UnPackTo(TypeT *_o) const {
+	_o->base_type = base_type();
+	_o->element = element();
+	_o->index = index();
+	_o->compact = compact();
+}
+
+inline megrez::Offset<Type> Type::Pack(megrez::MegrezBuilder &_mb, const TypeT &_o) {
+	return CreateType(_mb, _o.base_type, _o.element, _o.index, _o.compact);
+}
+
+inline size_t TypeT::SerializedSizeUpperBound() const {
+	size_t _size = megrez::InfoSizeUpperBound(4, 10);
+	return _size;
+}
+
+inline megrez::NativePtr<KeyValueT> KeyValue::UnPack(megrez::NativeArena *arena) const {
+	auto _o = megrez::MakeNative<KeyValueT>(arena, arena);
+	UnPackTo(_o.get());
+	return _o;
+}
+
+inline void KeyValue::UnPackTo(KeyValueT *_o) const {
+	if (auto _e = key()) {
+		_o->key.assign(_e->c_str(), _e->Length());
+	} else {
+		_o->key.clear();
+	}
+	if (auto _e = value()) {
+		_o->value.assign(_e->c_str(), _e->Length());
+	} else {
+		_o->value.clear();
+	}
+}
+
+inline megrez::Offset<KeyValue> KeyValue::Pack(megrez::MegrezBuilder &_mb, const KeyValueT &_o) {
+	auto _key = _o.key.empty() ? megrez::Offset<megrez::String>() : _mb.CreateString(_o.key.data(), _o.key.size());
+	auto _value = _o.value.empty() ? megrez::Offset<megrez::String>() : _mb.CreateString(_o.value.data(), _o.value.size());
+	return CreateKeyValue(_mb, _key, _value);
+}
+
+inline size_t KeyValueT::SerializedSizeUpperBound() const {
+	size_t _size = megrez::InfoSizeUpperBound(2, 14);
+	if (!key.empty()) _size += megrez::StringSizeUpperBound(key.size());
+	if (!value.empty()) _size += megrez::StringSizeUpperBound(value.size());
+	return _size;
+}
+
+inline megrez::NativePtr<EnumValT> EnumVal::UnPack(megrez::NativeArena *arena) const {
+	auto _o = megrez::MakeNative<EnumValT>(arena, arena);
+	UnPackTo(_o.get());
+	return _o;
+}
+
+inline void EnumVal::UnPackTo(EnumValT *_o) const {
+	if (auto _e = name()) {
+		_o->name.assign(_e->c_str(), _e->Length());
+	} else {
+		_o->name.clear();
+	}
+	_o->value = value();
+	_o->object = object();
+}
+
+inline megrez::Offset<EnumVal> EnumVal::Pack(megrez::MegrezBuilder &_mb, const EnumValT &_o) {
+	auto _name = _o.name.empty() ? megrez::Offset<megrez::String>() : _mb.CreateString(_o.name.data(), _o.name.size());
+	return CreateEnumVal(_mb, _name, _o.value, _o.object);
+}
+
+inline size_t EnumValT::SerializedSizeUpperBound() const {
+	size_t _size = megrez::InfoSizeUpperBound(3, 29);
+	if (!name.empty()) _size += megrez::StringSizeUpperBound(name.size());
+	return _size;
+}
+
+inline megrez::NativePtr<EnumT> Enum::UnPack(megrez::NativeArena *arena) const {
+	auto _o = megrez::MakeNative<EnumT>(arena, arena);
+	UnPackTo(_o.get());
+	return _o;
+}
+
+inline void Enum::UnPackTo(EnumT *_o) const {
+	if (auto _e = name()) {
+		_o->name.assign(_e->c_str(), _e->Length());
+	} else {
+		_o->name.clear();
+	}
+	if (auto _e = values()) {
+		_o->values.clear();
+		for (auto _i : *_e) _o->values.push_back(_i->UnPack(_o->arena_));
+	} else {
+		_o->values.clear();
+	}
+	_o->is_union = is_union();
+	if (auto _e = underlying_type()) {
+		_o->underlying_type = _e->UnPack(_o->arena_);
+	} else {
+		_o->underlying_type.reset();
+	}
+	if (auto _e = attributes()) {
+		_o->attributes.clear();
+		for (auto _i : *_e) _o->attributes.push_back(_i->UnPack(_o->arena_));
+	} else {
+		_o->attributes.clear();
+	}
+}
+
+inline megrez::Offset<Enum> Enum::Pack(megrez::MegrezBuilder &_mb, const EnumT &_o) {
+	auto _name = _o.name.empty() ? megrez::Offset<megrez::String>() : _mb.CreateString(_o.name.data(), _o.name.size());
+	auto _values = _o.values.empty() ? megrez::Offset<megrez::Vector<megrez::Offset<EnumVal>>>() : [&]() {
+		std::vector<megrez::Offset<EnumVal>> _v;
+		_v.reserve(_o.values.size());
+		for (auto &_e : _o.values) if (_e) _v.push_back(EnumVal::Pack(_mb, *_e));
+		return _mb.CreateVector(_v);
+	}();
+	auto _underlying_type = _o.underlying_type ? Type::Pack(_mb, *_o.underlying_type) : megrez::Offset<Type>();
+	auto _attributes = _o.attributes.empty() ? megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>>() : [&]() {
+		std::vector<megrez::Offset<KeyValue>> _v;
+		_v.reserve(_o.attributes.size());
+		for (auto &_e : _o.attributes) if (_e) _v.push_back(KeyValue::Pack(_mb, *_e));
+		return _mb.CreateVectorOfSortedInfos(&_v);
+	}();
+	return CreateEnum(_mb, _name, _values, _o.is_union, _underlying_type, _attributes);
+}
+
+inline size_t EnumT::SerializedSizeUpperBound() const {
+	size_t _size = megrez::InfoSizeUpperBound(5, 29);
+	if (!name.empty()) _size += megrez::StringSizeUpperBound(name.size());
+	if (!values.empty()) _size += megrez::VectorSizeUpperBound(values.size(), 4, 4);
+	for (auto &_e : values) if (_e) _size += _e->SerializedSizeUpperBound();
+	if (underlying_type) _size += underlying_type->SerializedSizeUpperBound();
+	if (!attributes.empty()) _size += megrez::VectorSizeUpperBound(attributes.size(), 4, 4);
+	for (auto &_e : attributes) if (_e) _size += _e->SerializedSizeUpperBound();
+	return _size;
+}
+
+inline megrez::NativePtr<FieldT> Field::UnPack(megrez::NativeArena *arena) const {
+	auto _o = megrez::MakeNative<FieldT>(arena, arena);
+	UnPackTo(_o.get());
+	return _o;
+}
+
+inline void Field::UnPackTo(FieldT *_o) const {
+	if (auto _e = name()) {
+		_o->name.assign(_e->c_str(), _e->Length());
+	} else {
+		_o->name.clear();
+	}
+	if (auto _e = type()) {
+		_o->type = _e->UnPack(_o->arena_);
+	} else {
+		_o->type.reset();
+	}
+	_o->id = id();
+	_o->offset = offset();
+	_o->default_integer = default_integer();
+	_o->default_real = default_real();
+	_o->deprecated = deprecated();
+	_o->key = key();
+	if (auto _e = attributes()) {
+		_o->attributes.clear();
+		for (auto _i : *_e) _o->attributes.push_back(_i->UnPack(_o->arena_));
+	} else {
+		_o->attributes.clear();
+	}
+}
+
+inline megrez::Offset<Field> Field::Pack(megrez::MegrezBuilder &_mb, const FieldT &_o) {
+	auto _name = _o.name.empty() ? megrez::Offset<megrez::String>() : _mb.CreateString(_o.name.data(), _o.name.size());
+	auto _type = _o.type ? Type::Pack(_mb, *_o.type) : megrez::Offset<Type>();
+	auto _attributes = _o.attributes.empty() ? megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>>() : [&]() {
+		std::vector<megrez::Offset<KeyValue>> _v;
+		_v.reserve(_o.attributes.size());
+		for (auto &_e : _o.attributes) if (_e) _v.push_back(KeyValue::Pack(_mb, *_e));
+		return _mb.CreateVectorOfSortedInfos(&_v);
+	}();
+	return CreateField(_mb, _name, _type, _o.id, _o.offset, _o.default_integer, _o.default_real, _o.deprecated, _o.key, _attributes);
+}
+
+inline size_t FieldT::SerializedSizeUpperBound() const {
+	size_t _size = megrez::InfoSizeUpperBound(9, 59);
+	if (!name.empty()) _size += megrez::StringSizeUpperBound(name.size());
+	if (type) _size += type->SerializedSizeUpperBound();
+	if (!attributes.empty()) _size += megrez::VectorSizeUpperBound(attributes.size(), 4, 4);
+	for (auto &_e : attributes) if (_e) _size += _e->SerializedSizeUpperBound();
+	return _size;
+}
+
+inline megrez::NativePtr<ObjectT> Object::UnPack(megrez::NativeArena *arena) const {
+	auto _o = megrez::MakeNative<ObjectT>(arena, arena);
+	UnPackTo(_o.get());
+	return _o;
+}
+
+inline void Object::UnPackTo(ObjectT *_o) const {
+	if (auto _e = name()) {
+		_o->name.assign(_e->c_str(), _e->Length());
+	} else {
+		_o->name.clear();
+	}
+	if (auto _e = fields()) {
+		_o->fields.clear();
+		for (auto _i : *_e) _o->fields.push_back(_i->UnPack(_o->arena_));
+	} else {
+		_o->fields.clear();
+	}
+	_o->is_struct = is_struct();
+	_o->minalign = minalign();
+	_o->bytesize = bytesize();
+	if (auto _e = attributes()) {
+		_o->attributes.clear();
+		for (auto _i : *_e) _o->attributes.push_back(_i->UnPack(_o->arena_));
+	} else {
+		_o->attributes.clear();
+	}
+}
+
+inline megrez::Offset<Object> Object::Pack(megrez::MegrezBuilder &_mb, const ObjectT &_o) {
+	auto _name = _o.name.empty() ? megrez::Offset<megrez::String>() : _mb.CreateString(_o.name.data(), _o.name.size());
+	auto _fields = _o.fields.empty() ? megrez::Offset<megrez::Vector<megrez::Offset<Field>>>() : [&]() {
+		std::vector<megrez::Offset<Field>> _v;
+		_v.reserve(_o.fields.size());
+		for (auto &_e : _o.fields) if (_e) _v.push_back(Field::Pack(_mb, *_e));
+		return _mb.CreateVectorOfSortedInfos(&_v);
+	}();
+	auto _attributes = _o.attributes.empty() ? megrez::Offset<megrez::Vector<megrez::Offset<KeyValue>>>() : [&]() {
+		std::vector<megrez::Offset<KeyValue>> _v;
+		_v.reserve(_o.attributes.size());
+		for (auto &_e : _o.attributes) if (_e) _v.push_back(KeyValue::Pack(_mb, *_e));
+		return _mb.CreateVectorOfSortedInfos(&_v);
+	}();
+	return CreateObject(_mb, _name, _fields, _o.is_struct, _o.minalign, _o.bytesize, _attributes);
+}
+
+inline size_t ObjectT::SerializedSizeUpperBound() const {
+	size_t _size = megrez::InfoSizeUpperBound(6, 36);
+	if (!name.empty()) _size += megrez::StringSizeUpperBound(name.size());
+	if (!fields.empty()) _size += megrez::VectorSizeUpperBound(fields.size(), 4, 4);
+	for (auto &_e : fields) if (_e) _size += _e->SerializedSizeUpperBound();
+	if (!attributes.empty()) _size += megrez::VectorSizeUpperBound(attributes.size(), 4, 4);
+	for (auto &_e : attributes) if (_e) _size += _e->SerializedSizeUpperBound();
+	return _size;
+}
+
+inline megrez::NativePtr<SchemaT> Schema::UnPack(megrez::NativeArena *arena) const {
+	auto _o = megrez::MakeNative<SchemaT>(arena, arena);
+	UnPackTo(_o.get());
+	return _o;
+}
+
+inline void Schema::UnPackTo(SchemaT *_o) const {
+	if (auto _e = objects()) {
+		_o->objects.clear();
+		for (auto _i : *_e) _o->objects.push_back(_i->UnPack(_o->arena_));
+	} else {
+		_o->objects.clear();
+	}
+	if (auto _e = enums()) {
+		_o->enums.clear();
+		for (auto _i : *_e) _o->enums.push_back(_i->UnPack(_o->arena_));
+	} else {
+		_o->enums.clear();
+	}
+	if (auto _e = name_space()) {
+		_o->name_space.assign(_e->c_str(), _e->Length());
+	} else {
+		_o->name_space.clear();
+	}
+	_o->main_object = main_object();
+}
+
+inline megrez::Offset<Schema> Schema::Pack(megrez::MegrezBuilder &_mb, const SchemaT &_o) {
+	auto _objects = _o.objects.empty() ? megrez::Offset<megrez::Vector<megrez::Offset<Object>>>() : [&]() {
+		std::vector<megrez::Offset<Object>> _v;
+		_v.reserve(_o.objects.size());
+		for (auto &_e : _o.objects) if (_e) _v.push_back(Object::Pack(_mb, *_e));
+		return _mb.CreateVectorOfSortedInfos(&_v);
+	}();
+	auto _enums = _o.enums.empty() ? megrez::Offset<megrez::Vector<megrez::Offset<Enum>>>() : [&]() {
+		std::vector<megrez::Offset<Enum>> _v;
+		_v.reserve(_o.enums.size());
+		for (auto &_e : _o.enums) if (_e) _v.push_back(Enum::Pack(_mb, *_e));
+		return _mb.CreateVectorOfSortedInfos(&_v);
+	}();
+	auto _name_space = _o.name_space.empty() ? megrez::Offset<megrez::String>() : _mb.CreateString(_o.name_space.data(), _o.name_space.size());
+	return CreateSchema(_mb, _objects, _enums, _name_space, _o.main_object);
+}
+
+inline size_t SchemaT::SerializedSizeUpperBound() const {
+	size_t _size = megrez::InfoSizeUpperBound(4, 28);
+	if (!objects.empty()) _size += megrez::VectorSizeUpperBound(objects.size(), 4, 4);
+	for (auto &_e : objects) if (_e) _size += _e->SerializedSizeUpperBound();
+	if (!enums.empty()) _size += megrez::VectorSizeUpperBound(enums.size(), 4, 4);
+	for (auto &_e : enums) if (_e) _size += _e->SerializedSizeUpperBound();
+	if (!name_space.empty()) _size += megrez::StringSizeUpperBound(name_space.size());
+	return _size;
+}
+
+inline const Schema *GetSchema(const void *buf) { return megrez::GetRoot<Schema>(buf); }
+
+inline Schema *GetMutableSchema(void *buf) { return megrez::GetMutableRoot<Schema>(buf); }
+
+inline megrez::NativePtr<SchemaT> UnPackSchema(const void *buf, megrez::NativeArena *arena = nullptr) {
+	return GetSchema(buf)->UnPack(arena);
+}
+
+inline const Schema *GetSizePrefixedSchema(const void *buf) { return megrez::GetSizePrefixedRoot<Schema>(buf); }
+
+inline bool VerifySchemaBuffer(megrez::Verifier &verifier) { return verifier.VerifyBuffer<Schema>(); }
+
+inline bool VerifySizePrefixedSchemaBuffer(megrez::Verifier &verifier) { return verifier.VerifySizePrefixedBuffer<Schema>(); }
+
+}; // namespace megrez
+}; // namespace reflection
+
+#endif  // MEGREZ_GENERATED_REFLECTION_MEGREZ_REFLECTION_H_
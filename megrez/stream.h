@@ -0,0 +1,177 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#ifndef MEGREZ_STREAM_H_
+#define MEGREZ_STREAM_H_
+
+#include <cstring>
+#include <vector>
+#ifndef _WIN32
+	#include <errno.h>
+	#include <limits.h>
+	#include <sys/uio.h>
+#endif // _WIN32
+#include "megrez/basic.h"
+#include "megrez/builder.h"
+#include "megrez/util.h"
+
+// A stream is a run of size prefixed buffers (frames) made by
+// `MegrezBuilder::FinishSizePrefixed()`, stored back to back. A frame is
+// its uofs_t size prefix followed by that many bytes; pass the frame start
+// to `GetSizePrefixedRoot()` or `Verifier::VerifySizePrefixedBuffer()`.
+
+namespace megrez {
+
+// Walks the frames of a contiguous stream in place.
+class FrameReader {
+ private:
+	const uint8_t *cur_;
+	const uint8_t *end_;
+
+ public:
+	FrameReader(const void *buf, size_t len)
+		: cur_(reinterpret_cast<const uint8_t *>(buf)), end_(cur_ + len) {}
+
+	// Points `frame` at the next complete frame and `frame_size` at its
+	// length including the prefix. Returns false at the end of the stream
+	// or when only part of a frame is left, see `remaining()`.
+	bool Next(const uint8_t **frame, size_t *frame_size) {
+		auto avail = static_cast<size_t>(end_ - cur_);
+		if (avail < sizeof(uofs_t)) return false;
+		auto size = sizeof(uofs_t) + GetPrefixedSize(cur_);
+		if (size > avail) return false;
+		*frame = cur_;
+		*frame_size = size;
+		cur_ += size;
+		return true;
+	}
+
+	size_t remaining() const { return static_cast<size_t>(end_ - cur_); }
+};
+
+// Collects finished frames into one contiguous batch, so thousands of
+// small messages go out with a single write.
+class FrameWriter {
+ private:
+	std::vector<uint8_t> buf_;
+
+ public:
+	explicit FrameWriter(size_t reserve = 64 * 1024) { buf_.reserve(reserve); }
+
+	void Add(const void *frame, size_t frame_size) {
+		auto p = reinterpret_cast<const uint8_t *>(frame);
+		buf_.insert(buf_.end(), p, p + frame_size);
+	}
+
+	// `mb` must have been finished with `FinishSizePrefixed()`.
+	void Add(const MegrezBuilder &mb) {
+		std::vector<BufferSegment> segments;
+		mb.GetBufferSegments(&segments);
+		for (auto it = segments.begin(); it != segments.end(); ++it)
+			Add(it->data, it->size);
+	}
+
+	const uint8_t *data() const { return buf_.data(); }
+	size_t size() const { return buf_.size(); }
+	void Clear() { buf_.clear(); }
+};
+
+// Receive side buffer for a stream arriving in arbitrary chunks. Bytes are
+// written at the tail (straight from `recv()` via `PrepareWrite()`), whole
+// frames are handed out in place from the head. Only the trailing partial
+// frame is ever moved, when the tail runs out of room.
+class FrameBuffer {
+ private:
+	std::vector<uint8_t> buf_;
+	size_t head_;
+	size_t tail_;
+
+ public:
+	explicit FrameBuffer(size_t initial_size = 64 * 1024)
+		: buf_(initial_size), head_(0), tail_(0) {}
+
+	// Room for at least `len` more bytes at the tail. Invalidates frames
+	// handed out before.
+	uint8_t *PrepareWrite(size_t len) {
+		if (buf_.size() - tail_ < len) {
+			auto pending = tail_ - head_;
+			if (head_) memmove(buf_.data(), buf_.data() + head_, pending);
+			head_ = 0;
+			tail_ = pending;
+			if (buf_.size() - tail_ < len)
+				buf_.resize(std::max(buf_.size() * 2, tail_ + len));
+		}
+		return buf_.data() + tail_;
+	}
+
+	void CommitWrite(size_t len) {
+		assert(tail_ + len <= buf_.size());
+		tail_ += len;
+	}
+
+	void Append(const void *bytes, size_t len) {
+		memcpy(PrepareWrite(len), bytes, len);
+		CommitWrite(len);
+	}
+
+	// Same contract as `FrameReader::Next()`, the frame stays valid until
+	// the next `PrepareWrite()` or `Append()`.
+	bool Next(const uint8_t **frame, size_t *frame_size) {
+		FrameReader reader(buf_.data() + head_, tail_ - head_);
+		if (!reader.Next(frame, frame_size)) return false;
+		head_ += *frame_size;
+		if (head_ == tail_) head_ = tail_ = 0;
+		return true;
+	}
+
+	size_t pending() const { return tail_ - head_; }
+};
+
+#ifndef _WIN32
+// Writes a (segmented) buffer with `writev()`, without joining the
+// segments first. Partial writes are resumed, returns false on an error.
+inline bool WriteSegments(int fd, const std::vector<BufferSegment> &segments) {
+	std::vector<iovec> iov;
+	for (auto it = segments.begin(); it != segments.end(); ++it) {
+		iovec v = { const_cast<uint8_t *>(it->data), it->size };
+		iov.push_back(v);
+	}
+	size_t first = 0;
+	while (first < iov.size()) {
+		#ifdef IOV_MAX
+			auto count = std::min<size_t>(iov.size() - first, IOV_MAX);
+		#else
+			auto count = std::min<size_t>(iov.size() - first, 16);
+		#endif
+		auto written = writev(fd, &iov[first], static_cast<int>(count));
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		auto left = static_cast<size_t>(written);
+		while (first < iov.size() && left >= iov[first].iov_len) left -= iov[first++].iov_len;
+		if (left) {
+			iov[first].iov_base = static_cast<uint8_t *>(iov[first].iov_base) + left;
+			iov[first].iov_len -= left;
+		}
+	}
+	return true;
+}
+#endif // _WIN32
+
+} // namespace megrez
+
+#endif // MEGREZ_STREAM_H_
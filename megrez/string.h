@@ -18,6 +18,7 @@ limitations under the License.
 #define MEGREZ_STRING_H_
 
 #include <string.h>
+#include <string>
 #include "megrez/vector.h"
 
 namespace megrez {
@@ -26,6 +27,42 @@ struct String : public Vector<char> {
 	const char *c_str() const { return reinterpret_cast<const char *>(Data()); }
 };
 
+// A borrowed run of characters, so string setters take literals,
+// `std::string`s and pointer/length pairs without a temporary copy.
+// A null `data()` means the string is absent.
+class StringRef {
+ private:
+	const char *data_;
+	size_t size_;
+
+ public:
+	StringRef() : data_(nullptr), size_(0) {}
+	StringRef(const char *str) : data_(str), size_(str ? strlen(str) : 0) {}
+	StringRef(const char *str, size_t len) : data_(str), size_(len) {}
+	StringRef(const std::string &str) : data_(str.data()), size_(str.size()) {}
+
+	const char *data() const { return data_; }
+	size_t size() const { return size_; }
+};
+
+// Bytewise ordering used for `(key)` strings, a missing string sorts
+// like an empty one.
+inline int CompareStrings(const char *a, size_t a_len, const char *b, size_t b_len) {
+	auto c = std::min(a_len, b_len) ? memcmp(a, b, std::min(a_len, b_len)) : 0;
+	if (c) return c;
+	return a_len < b_len ? -1 : (a_len > b_len ? 1 : 0);
+}
+
+inline int CompareStrings(const String *a, const String *b) {
+	return CompareStrings(a ? a->c_str() : nullptr, a ? a->Length() : 0,
+	                      b ? b->c_str() : nullptr, b ? b->Length() : 0);
+}
+
+inline int CompareStrings(const String *a, const StringRef &b) {
+	return CompareStrings(a ? a->c_str() : nullptr, a ? a->Length() : 0,
+	                      b.data(), b.size());
+}
+
 } // namespace megrez
 
 #endif // MEGREZ_STRING_H_
\ No newline at end of file
@@ -21,13 +21,21 @@ limitations under the License.
 #include <iomanip>
 #include <string>
 #include <sstream>
+#include <type_traits>
 #include <cstdlib>
+#include <cstring>
 #include "megrez/basic.h"
 
 namespace megrez {
 
 template<typename T> 
 std::string NumToString(T t) {
+	// Integers skip the stream, the parser converts one per value.
+	if (std::is_integral<T>::value) {
+		return std::is_signed<T>::value
+			? std::to_string(static_cast<long long>(t))
+			: std::to_string(static_cast<unsigned long long>(t));
+	}
 	std::stringstream ss;
 	if (sizeof(T) > 1) ss << t;
 	else ss << static_cast<int>(t);  // 避免使用char类型作为字符数据
@@ -53,6 +61,23 @@ const T *GetRoot(const void *buf) {
 		EndianScalar(*reinterpret_cast<const uofs_t *>(buf)));
 }
 
+// For changing scalars of a finished buffer in place, see the generated
+// `mutate_` methods.
+template<typename T>
+T *GetMutableRoot(void *buf) {
+	return const_cast<T *>(GetRoot<T>(buf));
+}
+
+// For buffers made by `MegrezBuilder::FinishSizePrefixed()`.
+template<typename T> 
+const T *GetSizePrefixedRoot(const void *buf) {
+	return GetRoot<T>(reinterpret_cast<const uint8_t *>(buf) + sizeof(uofs_t));
+}
+
+inline uofs_t GetPrefixedSize(const void *buf) {
+	return ReadScalar<uofs_t>(buf);
+}
+
 
 inline int64_t StringToInt(const char *str) {
 	#ifdef _MSC_VER
@@ -62,11 +87,19 @@ inline int64_t StringToInt(const char *str) {
 	#endif
 }
 
+// Reads the whole file with one read of its size, large read-only buffers
+// are better served by `MappedFile` in `megrez/mmap.h`.
 inline bool LoadFile(const char *name, bool binary, std::string *buf) {
 	std::ifstream ifs(name, binary ? std::ifstream::binary : std::ifstream::in);
 	if (!ifs.is_open()) return false;
-	*buf = std::string(std::istreambuf_iterator<char>(ifs),
-					   std::istreambuf_iterator<char>());
+	ifs.seekg(0, std::ios::end);
+	auto size = static_cast<std::streamoff>(ifs.tellg());
+	if (size < 0) return false;
+	ifs.seekg(0, std::ios::beg);
+	buf->resize(static_cast<size_t>(size));
+	if (size) ifs.read(&(*buf)[0], size);
+	// Text mode may translate line endings and read less than the size.
+	buf->resize(static_cast<size_t>(ifs.gcount()));
 	return !ifs.bad();
 }
 
@@ -81,6 +114,20 @@ inline bool SaveFile(const char *name, const std::string &buf, bool binary) {
 	return SaveFile(name, buf.c_str(), buf.size(), binary);
 }
 
+// Leaves a file that already holds `buf` untouched, so its timestamp
+// doesn't make a build redo everything that depends on it.
+inline bool SaveFileIfChanged(const char *name, const char *buf, size_t len, bool binary) {
+	std::string old;
+	if (LoadFile(name, binary, &old) && old.size() == len &&
+	    (!len || !memcmp(old.data(), buf, len)))
+		return true;
+	return SaveFile(name, buf, len, binary);
+}
+
+inline bool SaveFileIfChanged(const char *name, const std::string &buf, bool binary) {
+	return SaveFileIfChanged(name, buf.c_str(), buf.size(), binary);
+}
+
 
 
 inline vofs_t FieldIndexToOffset(vofs_t field_id) {
@@ -19,11 +19,108 @@ limitations under the License.
 
 #include <algorithm>
 #include <assert.h>
+#include <cstddef>
 #include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <vector>
 #include "megrez/basic.h"
+#include "megrez/allocator.h"
+#include "megrez/detached_buffer.h"
 
 namespace megrez {
 
+// Read-only random access iterator over the elements of a `Vector`,
+// dereferencing gives the same values as `Vector::Get()`.
+template<typename T>
+class VectorIterator {
+ private:
+	typedef IndirectHelper<T> helper;
+	const uint8_t *p_;
+
+ public:
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef typename helper::return_type reference;
+	typedef typename std::remove_cv<
+		typename std::remove_reference<reference>::type>::type value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef const value_type *pointer;
+
+	VectorIterator() : p_(nullptr) {}
+	explicit VectorIterator(const uint8_t *p) : p_(p) {}
+
+	reference operator*() const { return helper::Read(p_, 0); }
+	reference operator[](difference_type n) const { return *(*this + n); }
+
+	VectorIterator &operator++() { p_ += helper::element_stride; return *this; }
+	VectorIterator &operator--() { p_ -= helper::element_stride; return *this; }
+	VectorIterator operator++(int) { auto it = *this; ++*this; return it; }
+	VectorIterator operator--(int) { auto it = *this; --*this; return it; }
+	VectorIterator &operator+=(difference_type n) {
+		p_ += n * static_cast<difference_type>(helper::element_stride);
+		return *this;
+	}
+	VectorIterator &operator-=(difference_type n) { return *this += -n; }
+	VectorIterator operator+(difference_type n) const { auto it = *this; return it += n; }
+	VectorIterator operator-(difference_type n) const { auto it = *this; return it -= n; }
+	friend VectorIterator operator+(difference_type n, const VectorIterator &it) {
+		return it + n;
+	}
+	difference_type operator-(const VectorIterator &other) const {
+		return (p_ - other.p_) / static_cast<difference_type>(helper::element_stride);
+	}
+
+	bool operator==(const VectorIterator &other) const { return p_ == other.p_; }
+	bool operator!=(const VectorIterator &other) const { return p_ != other.p_; }
+	bool operator<(const VectorIterator &other) const { return p_ < other.p_; }
+	bool operator>(const VectorIterator &other) const { return p_ > other.p_; }
+	bool operator<=(const VectorIterator &other) const { return p_ <= other.p_; }
+	bool operator>=(const VectorIterator &other) const { return p_ >= other.p_; }
+};
+
+// What `Vector<T>::data()` points at. Scalars are only usable in place when
+// the host byte order matches the wire, structs always are, offsets never.
+template<typename T>
+struct VectorData {
+	typedef T element_type;
+	static const bool contiguous = MEGREZ_LITTLEENDIAN || sizeof(T) == 1;
+};
+
+template<typename T>
+struct VectorData<Offset<T>> {
+	typedef Offset<T> element_type;
+	typedef T *mutable_type;
+	static const bool contiguous = false;
+	static mutable_type Mutable(const T *p) { return const_cast<T *>(p); }
+};
+
+template<typename T>
+struct VectorData<const T *> {
+	typedef T element_type;
+	typedef T *mutable_type;
+	static const bool contiguous = true;
+	static mutable_type Mutable(const T &r) { return const_cast<T *>(&r); }
+};
+
+// Non-owning view of contiguous elements, see `Vector::span()`.
+template<typename T>
+class Span {
+ private:
+	const T *data_;
+	size_t size_;
+
+ public:
+	Span() : data_(nullptr), size_(0) {}
+	Span(const T *data, size_t size) : data_(data), size_(size) {}
+
+	const T *data() const { return data_; }
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	const T &operator[](size_t i) const { return data_[i]; }
+	const T *begin() const { return data_; }
+	const T *end() const { return data_ + size_; }
+};
+
 template<typename T> 
 class Vector {
  protected:
@@ -41,41 +138,207 @@ class Vector {
 		return IndirectHelper<T>::Read(Data(), i);
 	}
 
+	// In place update of a scalar element. Offsets can't be rewritten in
+	// place, structs go through `GetMutable()`.
+	void Mutate(uofs_t i, T val) {
+		static_assert(std::is_scalar<T>::value, "Mutate() takes scalar elements only");
+		assert(i < Length());
+		WriteScalar(const_cast<uint8_t *>(Data()) + i * sizeof(T), val);
+	}
+
+	// In place access to a struct element, or the info an element refers to.
+	template<typename U = T>
+	typename VectorData<U>::mutable_type GetMutable(uofs_t i) {
+		return VectorData<U>::Mutable(Get(i));
+	}
+
 	const void *GetStructFromOffset(size_t o) const {
 		return reinterpret_cast<const void *>(Data() + o);
 	}
 
+	typedef VectorIterator<T> const_iterator;
+	typedef typename VectorData<T>::element_type element_type;
+
+	uofs_t size() const { return Length(); }
+	return_type operator[](uofs_t i) const { return Get(i); }
+	const_iterator begin() const { return const_iterator(Data()); }
+	const_iterator end() const {
+		return const_iterator(Data() + Length() * IndirectHelper<T>::element_stride);
+	}
+
+	// The elements in place, for tight loops the compiler can vectorize.
+	// Only available where the wire layout is the host layout.
+	const element_type *data() const {
+		static_assert(VectorData<T>::contiguous,
+		              "vector elements are not directly addressable");
+		return reinterpret_cast<const element_type *>(Data());
+	}
+	Span<element_type> span() const { return Span<element_type>(data(), Length()); }
+
+	// Binary search of a vector of infos with a `(key)` field, built with
+	// `CreateVectorOfSortedInfos()`. Returns nullptr when there's no match.
+	template<typename K>
+	return_type LookupByKey(K key) const {
+		uofs_t lo = 0, hi = Length();
+		while (lo < hi) {
+			auto mid = lo + (hi - lo) / 2;
+			auto element = Get(mid);
+			auto c = element->KeyCompareWithValue(key);
+			if (!c) return element;
+			if (c < 0) lo = mid + 1;
+			else hi = mid;
+		}
+		return nullptr;
+	}
 };
 
+// Hot path counters of a builder, see `MegrezBuilder::GetStats()`. Only
+// compiled in when MEGREZ_BUILDER_STATS is defined, which has to be the
+// same for every translation unit; otherwise the builder carries no trace
+// of them.
+#ifdef MEGREZ_BUILDER_STATS
+struct BuilderStats {
+	size_t regrowths;             // reallocations of a contiguous buffer
+	size_t bytes_copied;          // moved by those reallocations
+	size_t segments;              // blocks chained by a segmented buffer
+	size_t padding_bytes;         // alignment and struct padding
+	size_t vtables_written;
+	size_t vtables_deduplicated;  // infos that reused an earlier vtable
+	size_t strings_shared;        // `CreateSharedString()` calls that wrote nothing
+	size_t peak_size;             // largest size since the stats were reset
+};
+#define MEGREZ_STATS(statement) statement
+#else
+#define MEGREZ_STATS(statement)
+#endif
+
+// One contiguous piece of a segmented buffer, see
+// `vector_downward::segments()`.
+struct BufferSegment {
+	const uint8_t *data;
+	size_t size;
+};
+
+// Downward growing byte buffer. By default it is one contiguous block
+// that is reallocated on growth; with `set_segment_size()` it instead
+// chains new blocks in front of full ones, which never copies but leaves
+// the data in several pieces (objects never straddle them, each
+// `make_space()` is contiguous).
 class vector_downward {
  private:
+	// A full block of a segmented buffer, data is [cur, end).
+	struct Segment {
+		uint8_t *block;
+		uofs_t block_size;
+		uint8_t *cur;
+		uint8_t *end;
+		uofs_t base;  // size of the blocks older than this one
+	};
+	Allocator *allocator_;
+	uofs_t initial_size_;
 	uofs_t reserved_;
 	uint8_t *buf_;
 	uint8_t *cur_;
+	uint8_t *end_;       // end of the data in buf_, buf_ + reserved_ unless segmented
+	uofs_t base_;        // size of all full segments
+	uofs_t segment_size_;
+	std::vector<Segment> segments_;
+#ifdef MEGREZ_BUILDER_STATS
+	BuilderStats stats_;
+#endif
+
+	void free_segments() {
+		for (auto it = segments_.begin(); it != segments_.end(); ++it)
+			allocator_->deallocate(it->block, it->block_size);
+		segments_.clear();
+	}
+
+	// Seals the current block and continues in a new one with room for
+	// at least `len` bytes. Its end is offset so positions keep the
+	// alignment they have relative to the end of the whole buffer.
+	// Nothing changes if the allocation throws.
+	void new_segment(size_t len) {
+		auto block_size = std::max<size_t>(segment_size_, len + sizeof(max_scalar_t));
+		auto reserved = static_cast<uofs_t>(
+			block_size + PaddingBytes(block_size, sizeof(max_scalar_t)));
+		auto block = AllocateOrThrow(allocator_, reserved);
+		Segment full = { buf_, reserved_, cur_, end_, base_ };
+		segments_.push_back(full);
+		base_ = size();
+		reserved_ = reserved;
+		buf_ = block;
+		end_ = buf_ + reserved_ - (base_ & (sizeof(max_scalar_t) - 1));
+		cur_ = end_;
+		MEGREZ_STATS(stats_.segments++);
+	}
 
  public:
-	explicit vector_downward(uofs_t initial_size)
-		: reserved_(initial_size),
-			buf_(new uint8_t[reserved_]),
-			cur_(buf_ + reserved_) {
+	explicit vector_downward(uofs_t initial_size, Allocator *allocator = nullptr)
+		: allocator_(allocator ? allocator : &DefaultAllocator::instance()),
+			initial_size_(initial_size),
+			reserved_(initial_size),
+			buf_(AllocateOrThrow(allocator_, reserved_)),
+			cur_(buf_ + reserved_),
+			end_(cur_),
+			base_(0),
+			segment_size_(0) {
 		assert((initial_size & (sizeof(max_scalar_t) - 1)) == 0);
+		MEGREZ_STATS(reset_stats());
+	}
+	vector_downward(const vector_downward &) = delete;
+	vector_downward &operator=(const vector_downward &) = delete;
+	~vector_downward() {
+		free_segments();
+		allocator_->deallocate(buf_, reserved_);
+	}
+	void clear() {
+		MEGREZ_STATS(stats_.peak_size = stats().peak_size);
+		free_segments();
+		base_ = 0;
+		cur_ = end_ = buf_ + reserved_;
 	}
-	~vector_downward() { delete[] buf_; }
-	void clear() { cur_ = buf_ + reserved_; }
 	uofs_t growth_policy(uofs_t size) {
 		return (size / 2) & ~(sizeof(max_scalar_t) - 1);
 	}
 
+	// Switch to chaining blocks of `segment_size` bytes (0 goes back to a
+	// single contiguous block). Only while empty.
+	void set_segment_size(uofs_t segment_size) {
+		assert(!size());
+		segment_size_ = segment_size;
+	}
+	bool segmented() const { return !segments_.empty(); }
+
+	// Moves the contents into a block `len` bytes (rounded up to keep the
+	// end aligned) larger. Nothing changes if the allocation throws.
+	void reallocate(size_t len) {
+		auto old_size = size();
+		auto old_reserved = reserved_;
+		auto new_reserved = reserved_ +
+			static_cast<uofs_t>(len + PaddingBytes(len, sizeof(max_scalar_t)));
+		auto new_buf = AllocateOrThrow(allocator_, new_reserved);
+		reserved_ = new_reserved;
+		auto new_cur = new_buf + reserved_ - old_size;
+		memcpy(new_cur, cur_, old_size);
+		MEGREZ_STATS(stats_.regrowths++);
+		MEGREZ_STATS(stats_.bytes_copied += old_size);
+		cur_ = new_cur;
+		allocator_->deallocate(buf_, old_reserved);
+		buf_ = new_buf;
+		end_ = buf_ + reserved_;
+	}
+
+	// Grow at most once so the next `len` bytes fit without reallocating.
+	// Segmented buffers never reallocate, so there it does nothing.
+	void reserve(size_t len) {
+		auto avail = static_cast<size_t>(cur_ - buf_);
+		if (avail < len && !segment_size_) reallocate(len - avail);
+	}
+
 	uint8_t *make_space(uofs_t len) {
-		if (buf_ > cur_ - len) {
-			auto old_size = size();
-			reserved_ += std::max(len, growth_policy(reserved_));
-			auto new_buf = new uint8_t[reserved_];
-			auto new_cur = new_buf + reserved_ - old_size;
-			memcpy(new_cur, cur_, old_size);
-			cur_ = new_cur;
-			delete[] buf_;
-			buf_ = new_buf;
+		if (len > static_cast<size_t>(cur_ - buf_)) {
+			if (segment_size_) new_segment(len);
+			else reallocate(std::max(len, growth_policy(reserved_)));
 		}
 		cur_ -= len;
 		assert(size() < (1UL << (sizeof(sofs_t) * 8 - 1)) - 1);
@@ -83,22 +346,121 @@ class vector_downward {
 	}
 
 	uofs_t size() const {
-		return static_cast<uofs_t>(reserved_ - (cur_ - buf_));
+		return static_cast<uofs_t>(base_ + (end_ - cur_));
 	}
 
+	Allocator *allocator() const { return allocator_; }
+
+#ifdef MEGREZ_BUILDER_STATS
+	BuilderStats &mutable_stats() { return stats_; }
+	BuilderStats stats() const {
+		auto stats = stats_;
+		stats.peak_size = std::max<size_t>(stats.peak_size, size());
+		return stats;
+	}
+	void reset_stats() { memset(&stats_, 0, sizeof(stats_)); }
+#endif
+
+	// The most recently written bytes, the whole buffer unless segmented.
 	uint8_t *data() const { return cur_; }
-	uint8_t *data_at(uofs_t offset) { return buf_ + reserved_ - offset; }
+	uint8_t *data_at(uofs_t offset) {
+		if (offset > base_ || segments_.empty()) return end_ - (offset - base_);
+		for (auto it = segments_.rbegin(); it != segments_.rend(); ++it) {
+			if (offset > it->base) return it->end - (offset - it->base);
+		}
+		return segments_.front().end - offset;
+	}
+
+	// The pieces of the buffer from its start, ready for `writev()`.
+	void segments(std::vector<BufferSegment> *out) const {
+		out->clear();
+		BufferSegment current = { cur_, static_cast<size_t>(end_ - cur_) };
+		if (current.size || segments_.empty()) out->push_back(current);
+		for (auto it = segments_.rbegin(); it != segments_.rend(); ++it) {
+			BufferSegment full = { it->cur, static_cast<size_t>(it->end - it->cur) };
+			if (full.size) out->push_back(full);
+		}
+	}
+
+	// Constant sized copies below become single moves, anything else is
+	// one bulk copy.
 	void push(const uint8_t *bytes, size_t size) {
 		auto dest = make_space(size);
-		for (size_t i = 0; i < size; i++) dest[i] = bytes[i];
+		switch (size) {
+			case 0: break;
+			case 1: *dest = *bytes; break;
+			case 2: memcpy(dest, bytes, 2); break;
+			case 4: memcpy(dest, bytes, 4); break;
+			case 8: memcpy(dest, bytes, 8); break;
+			default: memcpy(dest, bytes, size); break;
+		}
 	}
 
+	// `t` must already be in little endian order.
+	template<typename T> 
+	void push_small(const T &t) {
+		auto dest = make_space(sizeof(T));
+		memcpy(dest, &t, sizeof(T));
+	}
+
+	// Alignment padding is shorter than `max_scalar_t`, so it is written
+	// inline, larger runs (vtables) go through memset.
 	void fill(size_t zero_pad_bytes) {
+		if (!zero_pad_bytes) return;
 		auto dest = make_space(zero_pad_bytes);
-		for (size_t i = 0; i < zero_pad_bytes; i++) dest[i] = 0;
+		if (zero_pad_bytes < sizeof(max_scalar_t)) {
+			for (size_t i = 0; i < zero_pad_bytes; i++) dest[i] = 0;
+		} else {
+			memset(dest, 0, zero_pad_bytes);
+		}
+	}
+
+	// Only within the most recent `make_space()`s of the current block.
+	void pop(size_t bytes_to_remove) {
+		assert(cur_ + bytes_to_remove <= end_);
+		cur_ += bytes_to_remove;
 	}
 
-	void pop(size_t bytes_to_remove) { cur_ += bytes_to_remove; }
+	// Copies a segmented buffer into one block, positions stay where they
+	// were and later growth chains new segments again. Nothing changes if
+	// the allocation throws.
+	void flatten() {
+		if (!segmented()) return;
+		auto old_size = size();
+		auto reserved = static_cast<uofs_t>(
+			old_size + PaddingBytes(old_size, sizeof(max_scalar_t)));
+		std::vector<BufferSegment> pieces;
+		segments(&pieces);
+		auto block = AllocateOrThrow(allocator_, reserved);
+		auto dest = block + reserved - old_size;
+		for (auto it = pieces.begin(); it != pieces.end(); ++it) {
+			memcpy(dest, it->data, it->size);
+			dest += it->size;
+		}
+		MEGREZ_STATS(stats_.bytes_copied += old_size);
+		free_segments();
+		allocator_->deallocate(buf_, reserved_);
+		reserved_ = reserved;
+		buf_ = block;
+		end_ = buf_ + reserved_;
+		cur_ = end_ - old_size;
+		base_ = 0;
+	}
+
+	// Hand the current block over to a `DetachedBuffer` and start again
+	// with a fresh block of the initial size. A segmented buffer is
+	// flattened first.
+	DetachedBuffer release() {
+		flatten();
+		MEGREZ_STATS(stats_.peak_size = stats().peak_size);
+		// The fresh block first, a throw leaves the buffer with the builder.
+		auto block = AllocateOrThrow(allocator_, initial_size_);
+		DetachedBuffer detached(allocator_, buf_, reserved_, cur_, size());
+		reserved_ = initial_size_;
+		buf_ = block;
+		cur_ = end_ = buf_ + reserved_;
+		return detached;
+	}
 };
 
 } // namespace megrez
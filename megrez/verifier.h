@@ -0,0 +1,213 @@
+/* =====================================================================
+Copyright 2017 The Megrez Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+========================================================================*/
+
+#ifndef MEGREZ_VERIFIER_H_
+#define MEGREZ_VERIFIER_H_
+
+#include "megrez/basic.h"
+#include "megrez/string.h"
+#include "megrez/vector.h"
+
+namespace megrez {
+
+// Size and alignment of one element as stored inline in a `Vector<T>`.
+template<typename T> 
+struct VectorElement {
+	static size_t Size() { return sizeof(T); }
+	static size_t Alignment() { return AlignOf<T>(); }
+};
+template<typename T> 
+struct VectorElement<Offset<T>> {
+	static size_t Size() { return sizeof(uofs_t); }
+	static size_t Alignment() { return sizeof(uofs_t); }
+};
+template<typename T> 
+struct VectorElement<const T *> {
+	static size_t Size() { return sizeof(T); }
+	static size_t Alignment() { return AlignOf<T>(); }
+};
+
+// Checks an untrusted buffer before any accessor follows an offset in it.
+// Every info, string and vector reachable from the root is bounds checked
+// once, the generated `Verify()` of each info drives the walk. `max_depth`
+// bounds the nesting, `max_infos` the total number of infos visited, so
+// a hostile buffer can't make verification run away.
+class Verifier {
+ private:
+	const uint8_t *buf_;
+	size_t size_;
+	size_t depth_;
+	size_t max_depth_;
+	size_t num_infos_;
+	size_t max_infos_;
+
+	size_t Position(const void *elem) const {
+		return static_cast<size_t>(reinterpret_cast<const uint8_t *>(elem) - buf_);
+	}
+
+ public:
+	Verifier(const uint8_t *buf, size_t size,
+	         size_t max_depth = 64, size_t max_infos = 1000000)
+		: buf_(buf), size_(size), depth_(0), max_depth_(max_depth),
+		  num_infos_(0), max_infos_(max_infos) {}
+
+	// `elem_len` bytes starting at `elem` lie inside the buffer.
+	bool Verify(const void *elem, size_t elem_len) const {
+		auto p = reinterpret_cast<const uint8_t *>(elem);
+		return p >= buf_ && elem_len <= size_ && Position(p) <= size_ - elem_len;
+	}
+
+	template<typename T> 
+	bool Verify(const void *elem) const { return Verify(elem, sizeof(T)); }
+
+	// Scalars are aligned to their size relative to the buffer start.
+	bool VerifyAlignment(const void *elem, size_t align) const {
+		return !(Position(elem) & (align - 1));
+	}
+
+	// An inline scalar or struct field.
+	template<typename T> 
+	bool VerifyField(const void *elem) const {
+		return Verify<T>(elem) && VerifyAlignment(elem, AlignOf<T>());
+	}
+
+	// The uofs_t at `p` is readable and points forward into the buffer.
+	bool VerifyOffset(const uint8_t *p) const {
+		if (!Verify<uofs_t>(p) || !VerifyAlignment(p, sizeof(uofs_t))) return false;
+		auto o = ReadScalar<uofs_t>(p);
+		return o && o < size_ - Position(p);
+	}
+
+	// The soffset, the vtable and the inline part of the info are readable.
+	bool VerifyInfoStart(const uint8_t *info) {
+		if (++depth_ > max_depth_ || ++num_infos_ > max_infos_) return false;
+		if (!Verify<sofs_t>(info) || !VerifyAlignment(info, sizeof(sofs_t)))
+			return false;
+		auto vinfo_pos = static_cast<int64_t>(Position(info)) -
+		                 ReadScalar<sofs_t>(info);
+		if (vinfo_pos < 0 || static_cast<uint64_t>(vinfo_pos) >= size_) return false;
+		auto vinfo = buf_ + vinfo_pos;
+		if (!Verify(vinfo, 2 * sizeof(vofs_t)) ||
+		    !VerifyAlignment(vinfo, sizeof(vofs_t)))
+			return false;
+		auto vtsize = ReadScalar<vofs_t>(vinfo);
+		return !(vtsize & 1) && vtsize >= 2 * sizeof(vofs_t) &&
+		       Verify(vinfo, vtsize) &&
+		       Verify(info, ReadScalar<vofs_t>(vinfo + sizeof(vofs_t)));
+	}
+
+	bool EndInfo() {
+		depth_--;
+		return true;
+	}
+
+	// Length prefix plus `elem_size` bytes per element are readable.
+	bool VerifyVectorOrString(const uint8_t *vec, size_t elem_size,
+	                          const uint8_t **end = nullptr) const {
+		if (!Verify<uofs_t>(vec) || !VerifyAlignment(vec, sizeof(uofs_t)))
+			return false;
+		auto len = ReadScalar<uofs_t>(vec);
+		auto avail = size_ - Position(vec) - sizeof(uofs_t);
+		if (len > avail / elem_size) return false;
+		if (end) *end = vec + sizeof(uofs_t) + len * elem_size;
+		return true;
+	}
+
+	bool VerifyString(const String *str) const {
+		if (!str) return true;
+		const uint8_t *end;
+		return VerifyVectorOrString(reinterpret_cast<const uint8_t *>(str), 1, &end) &&
+		       Verify(end, 1) && !*end;
+	}
+
+	template<typename T> 
+	bool VerifyVector(const Vector<T> *vec) const {
+		if (!vec) return true;
+		auto p = reinterpret_cast<const uint8_t *>(vec);
+		return VerifyVectorOrString(p, VectorElement<T>::Size()) &&
+		       VerifyAlignment(p + sizeof(uofs_t), VectorElement<T>::Alignment());
+	}
+
+	bool VerifyVectorOfStrings(const Vector<Offset<String>> *vec) const {
+		if (!vec) return true;
+		if (!VerifyVector(vec)) return false;
+		for (uofs_t i = 0; i < vec->Length(); i++) {
+			auto p = reinterpret_cast<const uint8_t *>(vec->GetStructFromOffset(
+			           i * sizeof(uofs_t)));
+			if (!VerifyOffset(p) || !VerifyString(vec->Get(i))) return false;
+		}
+		return true;
+	}
+
+	template<typename T> 
+	bool VerifyInfo(const T *info) { return !info || info->Verify(*this); }
+
+	template<typename T> 
+	bool VerifyVectorOfInfos(const Vector<Offset<T>> *vec) {
+		if (!vec) return true;
+		if (!VerifyVector(vec)) return false;
+		for (uofs_t i = 0; i < vec->Length(); i++) {
+			auto p = reinterpret_cast<const uint8_t *>(vec->GetStructFromOffset(
+			           i * sizeof(uofs_t)));
+			if (!VerifyOffset(p) || !vec->Get(i)->Verify(*this)) return false;
+		}
+		return true;
+	}
+
+	// The buffer starts with a valid root offset to a valid `T`.
+	template<typename T> 
+	bool VerifyBuffer() {
+		if (!VerifyOffset(buf_)) return false;
+		auto root = reinterpret_cast<const T *>(buf_ + ReadScalar<uofs_t>(buf_));
+		return root->Verify(*this);
+	}
+
+	// The bytes of a `(nested)` field hold a whole buffer with root `T`, it
+	// is checked within the depth and info budget left. Empty counts as
+	// absent.
+	template<typename T>
+	bool VerifyNestedBuffer(const Vector<uint8_t> *vec) {
+		if (!vec || !vec->Length()) return true;
+		if (!VerifyVector(vec) || depth_ >= max_depth_ || num_infos_ >= max_infos_)
+			return false;
+		Verifier nested(vec->data(), vec->Length(), max_depth_ - depth_,
+		                max_infos_ - num_infos_);
+		if (!nested.VerifyBuffer<T>()) return false;
+		num_infos_ += nested.num_infos_;
+		return true;
+	}
+
+	// The same for a size prefixed buffer, nothing may point past the size
+	// the prefix claims.
+	template<typename T> 
+	bool VerifySizePrefixedBuffer() {
+		if (!Verify<uofs_t>(buf_)) return false;
+		auto prefixed_size = ReadScalar<uofs_t>(buf_);
+		if (prefixed_size > size_ - sizeof(uofs_t)) return false;
+		auto full_size = size_;
+		size_ = prefixed_size + sizeof(uofs_t);
+		auto root_offset = buf_ + sizeof(uofs_t);
+		auto ok = VerifyOffset(root_offset) &&
+		          reinterpret_cast<const T *>(root_offset + ReadScalar<uofs_t>(
+		            root_offset))->Verify(*this);
+		size_ = full_size;
+		return ok;
+	}
+};
+
+} // namespace megrez
+
+#endif // MEGREZ_VERIFIER_H_
@@ -1,3 +1,3 @@
 ./MegrezC -c test.mgz
-g++ test.cc -o test -I ../
+g++ test.cc ../compiler/parser.cc ../compiler/gen_text.cc ../compiler/gen_schema.cc ../compiler/gen_cpp.cc -o test -I ../ -pthread
 read -p " "
\ No newline at end of file
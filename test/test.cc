@@ -15,8 +15,17 @@ limitations under the License.
 ========================================================================*/
 
 #include "./test.mgz.h"
+#include "compiler/idl.h"
+#include "megrez/compact.h"
+#include "megrez/parallel.h"
+#include "megrez/patch.h"
+#include "megrez/pipeline.h"
+#include "megrez/reflection.h"
 #include <iostream>
 #include <chrono> 
+#include <cstring>
+#include <stdexcept>
+#include <thread>
 
 using namespace Megrez::Test;
 using namespace megrez;
@@ -38,8 +47,438 @@ const Person* Serialize() {
 	return elder;
 }
 
+// Behavior checks, run by `MegrezTest --check` from this directory.
+static int failures = 0;
 
-int main() {
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+			failures++; \
+		} \
+	} while (0)
+
+static const char *entry_names[] = { "mu", "alpha", "zeta", "kappa", "beta" };
+static const size_t entry_count = sizeof(entry_names) / sizeof(entry_names[0]);
+
+// Entry `i` holds `i`, every one must be found by its key.
+void CheckEntries(const Directory *dir) {
+	CHECK(dir->entries() && dir->entries()->size() == entry_count);
+	if (!dir->entries()) return;
+	for (size_t i = 0; i < entry_count; i++) {
+		auto entry = dir->entries()->LookupByKey(entry_names[i]);
+		CHECK(entry && entry->value() == int(i));
+	}
+	CHECK(!dir->entries()->LookupByKey("omega"));
+}
+
+void CheckSortedInfosPack() {
+	DirectoryT dir;
+	for (size_t i = 0; i < entry_count; i++) {
+		auto entry = MakeNative<EntryT>(nullptr);
+		entry->name = entry_names[i];
+		entry->value = int(i);
+		dir.entries.push_back(move(entry));
+	}
+	MegrezBuilder mb;
+	mb.Finish(Directory::Pack(mb, dir));
+	CheckEntries(GetRoot<Directory>(mb.GetBufferPointer()));
+}
+
+// Null elements and union members are left out.
+void CheckPackNulls() {
+	DirectoryT dir;
+	dir.entries.push_back(NativePtr<EntryT>());
+	dir.entries.push_back(MakeNative<EntryT>(nullptr));
+	dir.entries.back()->name = "only";
+	dir.selected_type = Any_Entry;
+	MegrezBuilder mb;
+	mb.Finish(Directory::Pack(mb, dir));
+	auto root = GetRoot<Directory>(mb.GetBufferPointer());
+	CHECK(root->entries()->size() == 1 && root->entries()->LookupByKey("only"));
+	CHECK(root->selected_type() == Any_NONE && !root->selected());
+}
+
+// Parses `json` as a `main_type` against test.mgz.
+bool ParseJson(Parser *parser, const char *main_type, const char *json) {
+	string schema;
+	if (!LoadFile("test.mgz", false, &schema)) return false;
+	return parser->Parse(schema.c_str(), "test.mgz") &&
+	       parser->SetMainType(main_type) && parser->Parse(json);
+}
+
+bool ParseDirectory(Parser *parser, const char *json) {
+	return ParseJson(parser, "Directory", json);
+}
+
+void CheckSortedInfosParser() {
+	string json = "{ entries: [";
+	for (size_t i = 0; i < entry_count; i++)
+		json += string(i ? ", " : "") + "{ name: \"" + entry_names[i] + "\", value: " +
+		        to_string(i) + " }";
+	json += "] }";
+	Parser parser;
+	CHECK(ParseDirectory(&parser, json.c_str()));
+	if (!parser.builder_.GetSize()) return;
+	CheckEntries(GetRoot<Directory>(parser.builder_.GetBufferPointer()));
+}
+
+void CheckParseInteger() {
+	Parser overflow, negative, fits;
+	CHECK(!ParseDirectory(&overflow, "{ entries: [{ value: 99999999999999999999 }] }"));
+	CHECK(overflow.error_.find("does not fit") != string::npos);
+	CHECK(!ParseDirectory(&negative, "{ entries: [{ value: -9223372036854775809 }] }"));
+	CHECK(ParseDirectory(&fits, "{ entries: [{ value: -2147483648 }] }"));
+}
+
+// Union types print by name and parse back.
+void CheckUnionText() {
+	Parser parser;
+	CHECK(ParseDirectory(&parser, "{ selected_type: Entry, selected: { name: \"x\" } }"));
+	string text;
+	GenerateText(parser, parser.builder_.GetBufferPointer(), -1, &text);
+	CHECK(text.find("\"selected_type\":\"Entry\"") != string::npos);
+	Parser reparsed;
+	CHECK(ParseDirectory(&reparsed, text.c_str()));
+	auto dir = GetRoot<Directory>(reparsed.builder_.GetBufferPointer());
+	CHECK(dir->selected_type() == Any_Entry && dir->selected_as_Entry() &&
+	      !strcmp(dir->selected_as_Entry()->name()->c_str(), "x"));
+}
+
+vector<uint8_t> BuildPerson(int16_t age, const string &name, size_t years) {
+	vector<uint64_t> vec;
+	for (size_t i = 0; i < years; i++) vec.push_back(i);
+	MegrezBuilder mb;
+	auto addr = address(1, 2, 3);
+	mb.Finish(CreatePerson(mb, &addr, age, name, mb.CreateVector(vec), Color_Black));
+	return vector<uint8_t>(mb.GetBufferPointer(), mb.GetBufferPointer() + mb.GetSize());
+}
+
+bool VerifyPerson(const vector<uint8_t> &buf) {
+	Verifier verifier(buf.data(), buf.size());
+	return VerifyPersonBuffer(verifier);
+}
+
+void CheckVerifier() {
+	auto buf = BuildPerson(92, "Jiang", 10);
+	CHECK(VerifyPerson(buf));
+	// Every truncation cuts into something the root refers to.
+	for (size_t size = 0; size < buf.size(); size++)
+		CHECK(!VerifyPerson(vector<uint8_t>(buf.begin(), buf.begin() + size)));
+	auto root = buf;
+	WriteScalar<uofs_t>(root.data(), static_cast<uofs_t>(root.size()));
+	CHECK(!VerifyPerson(root));
+	// The string's length points past the end.
+	auto name = buf;
+	auto length = reinterpret_cast<const uint8_t *>(GetPerson(name.data())->name());
+	WriteScalar<uofs_t>(const_cast<uint8_t *>(length), 0x7fffffff);
+	CHECK(!VerifyPerson(name));
+	// So does the distance from the root to its vtable.
+	auto vtable = buf;
+	auto info = vtable.data() + ReadScalar<uofs_t>(vtable.data());
+	WriteScalar<sofs_t>(info, -0x7fffffff);
+	CHECK(!VerifyPerson(vtable));
+}
+
+// The binary schema of test.mgz, for the reflection based checks.
+bool LoadSchema(MegrezBuilder *schema) {
+	string source;
+	Parser parser;
+	if (!LoadFile("test.mgz", false, &source) || !parser.Parse(source.c_str(), "test.mgz"))
+		return false;
+	GenerateBinarySchema(parser, schema);
+	return true;
+}
+
+void CheckReflection() {
+	MegrezBuilder schema;
+	CHECK(LoadSchema(&schema));
+	SchemaTables tables(reflection::GetSchema(schema.GetBufferPointer()));
+	auto person = tables.Find("Person");
+	CHECK(person && tables.main() == person);
+	if (!person) return;
+	auto buf = BuildPerson(54, "Wang", 3);
+	Verifier verifier(buf.data(), buf.size());
+	CHECK(VerifyAnyBuffer(verifier, tables, *person, buf.data()));
+	auto &info = *GetRoot<Info>(buf.data());
+	CHECK(GetAnyFieldI(info, *person->Find("age")) == 54);
+	CHECK(GetAnyFieldI(info, *person->Find("GlassColor")) == Color_Black);
+	CHECK(!strcmp(GetAnyFieldS(info, *person->Find("name"))->c_str(), "Wang"));
+	CHECK(GetAnyFieldVector(info, *person->Find("LifeContinue"))->Length() == 3);
+	CHECK(!person->Find("height"));
+}
+
+// Applies the diff from `from` to `to` and checks the result reads as
+// `to`, returns whether it was made incrementally.
+bool CheckPatch(const vector<uint8_t> &from, const vector<uint8_t> &to, bool *in_place) {
+	MegrezBuilder schema;
+	LoadSchema(&schema);
+	SchemaTables tables(reflection::GetSchema(schema.GetBufferPointer()));
+	vector<uint8_t> patch;
+	auto incremental = DiffBuffers(tables, *tables.main(), from.data(), from.size(),
+	                               to.data(), to.size(), &patch);
+	auto buf = from;
+	*in_place = ApplyBufferPatch(buf.data(), buf.size(), patch.data(), patch.size());
+	if (!*in_place) CHECK(ApplyBufferPatch(&buf, patch.data(), patch.size()));
+	CHECK(VerifyPerson(buf));
+	auto a = GetPerson(buf.data()), b = GetPerson(to.data());
+	CHECK(a->age() == b->age() && !strcmp(a->name()->c_str(), b->name()->c_str()));
+	CHECK(a->LifeContinue()->Length() == b->LifeContinue()->Length());
+	for (uofs_t i = 0; i < a->LifeContinue()->Length(); i++)
+		CHECK(a->LifeContinue()->Get(i) == b->LifeContinue()->Get(i));
+	// A patch only applies to the buffer it was made for.
+	auto other = BuildPerson(1, "other base", 0);
+	CHECK(!ApplyBufferPatch(&other, patch.data(), patch.size()));
+	return incremental;
+}
+
+void CheckPatches() {
+	auto base = BuildPerson(30, "Jiang", 10);
+	bool in_place;
+	// A scalar changes where it is.
+	CHECK(CheckPatch(base, BuildPerson(31, "Jiang", 10), &in_place) && in_place);
+	// A longer string is appended and pointed to.
+	CHECK(CheckPatch(base, BuildPerson(30, "Jiang Zemin", 10), &in_place) && !in_place);
+	// Growing past twice the new size doesn't pay, the patch carries the
+	// new buffer.
+	CHECK(!CheckPatch(BuildPerson(30, string(1000, 'a'), 10), BuildPerson(31, "b", 3),
+	                  &in_place) && !in_place);
+}
+
+// JSON to binary to JSON prints the same text again.
+void CheckJsonRoundTrip() {
+	const char *json =
+		"{ Address: { block: 1.5, street: -2, number: 3 }, age: 30, name: \"Li \\\"Bai\\\"\\n\", "
+		"LifeContinue: [1, 2, 18446744073709551615], GlassColor: Red }";
+	Parser parser;
+	CHECK(ParseJson(&parser, "Person", json));
+	vector<uint8_t> buf(parser.builder_.GetBufferPointer(),
+	                    parser.builder_.GetBufferPointer() + parser.builder_.GetSize());
+	CHECK(VerifyPerson(buf));
+	auto person = GetPerson(buf.data());
+	CHECK(person->age() == 30 && person->GlassColor() == Color_Red);
+	CHECK(!strcmp(person->name()->c_str(), "Li \"Bai\"\n"));
+	CHECK(person->Address()->street() == -2);
+	CHECK(person->LifeContinue()->Get(2) == 18446744073709551615ull);
+	string text;
+	GenerateText(parser, buf.data(), 2, &text);
+	Parser reparsed;
+	CHECK(ParseJson(&reparsed, "Person", text.c_str()));
+	string again;
+	GenerateText(reparsed, reparsed.builder_.GetBufferPointer(), 2, &again);
+	CHECK(text == again);
+}
+
+void CheckCompactVectors() {
+	vector<uint64_t> ids = { 1000000, 1000001, 1000003, 7, 18446744073709551615ull };
+	MegrezBuilder mb;
+	mb.Finish(CreateDirectory(mb, Offset<Vector<Offset<Entry>>>(), Any_NONE,
+	                          Offset<void>(), CreateCompactVector(mb, ids),
+	                          Offset<Vector<uint8_t>>()));
+	auto dir = GetRoot<Directory>(mb.GetBufferPointer());
+	Verifier verifier(mb.GetBufferPointer(), mb.GetSize());
+	CHECK(verifier.VerifyBuffer<Directory>());
+	CHECK(dir->ids()->Count() == ids.size());
+	vector<uint64_t> decoded(dir->ids()->Count());
+	CHECK(dir->ids()->Decode(decoded.data()) && decoded == ids);
+	// Deltas that small take a byte each.
+	CHECK(dir->ids()->Length() < ids.size() * sizeof(uint64_t));
+	Parser parser;
+	CHECK(ParseDirectory(&parser, "{ ids: [3, 1, 4, 1, 5] }"));
+	auto parsed = GetRoot<Directory>(parser.builder_.GetBufferPointer());
+	vector<uint64_t> digits(parsed->ids()->Count());
+	CHECK(parsed->ids()->Decode(digits.data()) &&
+	      digits == vector<uint64_t>({ 3, 1, 4, 1, 5 }));
+}
+
+// A nested buffer UnPacked and Packed again stays aligned and verifies.
+void CheckNestedRoundTrip() {
+	auto person = BuildPerson(30, "Li", 4);
+	MegrezBuilder mb;
+	auto head = mb.CreateNestedBuffer(person.data(), person.size());
+	mb.Finish(CreateDirectory(mb, Offset<Vector<Offset<Entry>>>(), Any_NONE,
+	                          Offset<void>(), Offset<CompactVector<uint64_t>>(), head));
+	auto dir = GetRoot<Directory>(mb.GetBufferPointer())->UnPack();
+	CHECK(dir->head.size() == person.size());
+	for (size_t odd = 0; odd < sizeof(max_scalar_t); odd++) {
+		MegrezBuilder repacked;
+		repacked.CreateString(string(odd, 'x'));
+		FinishNative(repacked, *dir);
+		Verifier verifier(repacked.GetBufferPointer(), repacked.GetSize());
+		CHECK(verifier.VerifyBuffer<Directory>());
+		auto root = GetRoot<Directory>(repacked.GetBufferPointer());
+		CHECK(reinterpret_cast<uintptr_t>(root->head()->data()) % sizeof(max_scalar_t) == 0);
+		CHECK(root->head_nested_root() && root->head_nested_root()->age() == 30);
+		// Grown only once, the bound holds.
+		CHECK(repacked.GetSize() <= dir->SerializedSizeUpperBound() + RootSizeUpperBound() +
+		                            StringSizeUpperBound(odd));
+	}
+}
+
+// Builds a Person over several segments, part of it spliced in.
+Offset<Person> BuildSegmentedPerson(MegrezBuilder &mb, int16_t age) {
+	MegrezBuilder sub;
+	auto name = sub.CreateString(string(100, 'n'));
+	auto spliced = mb.Splice(sub, name);
+	vector<uint64_t> years(50, 7);
+	auto addr = address(1, 2, 3);
+	return CreatePerson(mb, &addr, age, spliced, mb.CreateVector(years), Color_Blue);
+}
+
+void CheckSegmentedRelease() {
+	MegrezBuilder mb(64);
+	mb.SetSegmentSize(64);
+	mb.Finish(BuildSegmentedPerson(mb, 40));
+	CHECK(mb.IsSegmented());
+	auto size = mb.GetSize();
+	auto detached = mb.Release();
+	CHECK(detached.size() == size && !mb.GetSize());
+	Verifier verifier(detached.data(), detached.size());
+	CHECK(VerifyPersonBuffer(verifier));
+	auto person = GetPerson(detached.data());
+	CHECK(person->age() == 40 && person->name()->Length() == 100 &&
+	      person->LifeContinue()->Get(49) == 7 && person->GlassColor() == Color_Blue);
+}
+
+// The entries and their strings end up in several segments, some spliced.
+void CheckSortedInfosSegmented() {
+	MegrezBuilder mb(64);
+	mb.SetSegmentSize(64);
+	vector<Offset<Entry>> entries;
+	for (size_t i = 0; i < entry_count; i++) {
+		MegrezBuilder sub;
+		auto name = mb.Splice(sub, sub.CreateString(entry_names[i]));
+		mb.CreateString(string(40, 'p'));
+		entries.push_back(CreateEntry(mb, name, int(i)));
+	}
+	CHECK(mb.IsSegmented());
+	mb.Finish(CreateDirectory(mb, mb.CreateVectorOfSortedInfos(&entries), Any_NONE,
+	                          Offset<void>(), Offset<CompactVector<uint64_t>>(),
+	                          Offset<Vector<uint8_t>>()));
+	auto detached = mb.Release();
+	CheckEntries(GetRoot<Directory>(detached.data()));
+}
+
+// Counts what goes through it, for checking who allocates.
+class CountingAllocator : public Allocator {
+ public:
+	size_t allocations = 0;
+	uint8_t *allocate(size_t size) override {
+		allocations++;
+		return DefaultAllocator::instance().allocate(size);
+	}
+	void deallocate(uint8_t *p, size_t size) override {
+		DefaultAllocator::instance().deallocate(p, size);
+	}
+};
+
+void CheckParallelCreateVector() {
+	auto entry = [](MegrezBuilder &mb, size_t i) {
+		return CreateEntry(mb, mb.CreateString(to_string(i)), int(i));
+	};
+	CountingAllocator allocator;
+	MegrezBuilder mb(1024, &allocator);
+	auto own = allocator.allocations;
+	auto entries = ParallelCreateVector<Entry>(mb, 1000, entry, 4, 16);
+	CHECK(allocator.allocations > own);
+	mb.Finish(CreateDirectory(mb, entries, Any_NONE, Offset<void>(),
+	                          Offset<CompactVector<uint64_t>>(), Offset<Vector<uint8_t>>()));
+	auto dir = GetRoot<Directory>(mb.GetBufferPointer());
+	CHECK(dir->entries()->size() == 1000);
+	for (uofs_t i = 0; i < dir->entries()->size(); i++)
+		CHECK(dir->entries()->Get(i)->value() == int(i));
+	// A worker's exception is the caller's.
+	MegrezBuilder failing;
+	bool caught = false;
+	try {
+		ParallelCreateVector<Entry>(failing, 1000, [&](MegrezBuilder &mb, size_t i) {
+			if (i == 500) throw runtime_error("element 500");
+			return entry(mb, i);
+		}, 4, 16);
+	} catch (const runtime_error &e) {
+		caught = !strcmp(e.what(), "element 500");
+	}
+	CHECK(caught);
+}
+
+// Frames arrive in order and complete, from a producer thread.
+void CheckPipeline() {
+	const int frames = 200;
+	FramePipeline pipeline(4, 256);
+	thread producer([&]() {
+		for (int i = 0; i < frames; i++) {
+			auto mb = pipeline.Acquire();
+			auto addr = address(0, 0, 0);
+			pipeline.Submit(mb, CreatePerson(*mb, &addr, int16_t(i), mb->CreateString("frame"),
+			                                 Offset<Vector<uint64_t>>(), Color_Red));
+		}
+		pipeline.Close();
+	});
+	FrameBatch batch;
+	int received = 0;
+	for (;;) {
+		auto closed = pipeline.closed();
+		if (!pipeline.NextBatch(&batch)) {
+			if (closed) break;
+			this_thread::yield();
+			continue;
+		}
+		for (auto &segment : batch.segments()) {
+			Verifier verifier(segment.data, segment.size);
+			CHECK(VerifySizePrefixedPersonBuffer(verifier));
+			CHECK(GetSizePrefixedPerson(segment.data)->age() == received);
+			received++;
+		}
+		batch.Complete();
+	}
+	producer.join();
+	CHECK(received == frames);
+}
+
+// A schema parsed again after being included, or included after being
+// parsed, generates what it does on its own.
+void CheckIncludeOrder() {
+	string test, family;
+	CHECK(LoadFile("test.mgz", false, &test) && LoadFile("family.mgz", false, &family));
+	Parser test_alone, family_alone, include_first, include_last;
+	CHECK(test_alone.Parse(test.c_str(), "test.mgz"));
+	CHECK(family_alone.Parse(family.c_str(), "family.mgz"));
+	CHECK(include_first.Parse(test.c_str(), "test.mgz"));
+	CHECK(GenerateCPP(include_first, "test") == GenerateCPP(test_alone, "test"));
+	CHECK(include_first.Parse(family.c_str(), "family.mgz"));
+	CHECK(GenerateCPP(include_first, "family") == GenerateCPP(family_alone, "family"));
+	CHECK(include_last.Parse(family.c_str(), "family.mgz"));
+	CHECK(GenerateCPP(include_last, "family") == GenerateCPP(family_alone, "family"));
+	CHECK(include_last.Parse(test.c_str(), "test.mgz"));
+	CHECK(GenerateCPP(include_last, "test") == GenerateCPP(test_alone, "test"));
+	Parser self;
+	CHECK(!self.Parse("include \"test.mgz\";", "test.mgz"));
+}
+
+int RunChecks() {
+	CheckSortedInfosPack();
+	CheckSortedInfosParser();
+	CheckPackNulls();
+	CheckParseInteger();
+	CheckUnionText();
+	CheckIncludeOrder();
+	CheckVerifier();
+	CheckReflection();
+	CheckPatches();
+	CheckJsonRoundTrip();
+	CheckCompactVectors();
+	CheckNestedRoundTrip();
+	CheckSegmentedRelease();
+	CheckSortedInfosSegmented();
+	CheckParallelCreateVector();
+	CheckPipeline();
+	cout << (failures ? "FAILED" : "OK") << endl;
+	return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && strcmp(argv[1], "--check") == 0)
+		return RunChecks();
 	const Person* elder;
 	auto start = system_clock::now();
 	for (int i=1; i<=10000; i++)